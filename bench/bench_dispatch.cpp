@@ -0,0 +1,165 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "diagnostic.hpp"
+#include "engine.hpp"
+#include "ringallocator.hpp"
+#include "subscriber.hpp"
+#include "textformat.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace dime;
+
+
+namespace
+{
+
+//! A subscriber which reads the code and all arguments of every diagnostic.
+class Reader : public Subscriber
+{
+public:
+    virtual
+    Action process(Diagnostic* diagnostic) override
+    {
+        m_sum += diagnostic->code()[0];
+        for (unsigned idx = 0; idx < diagnostic->numArguments(); ++idx)
+        {
+            auto value = diagnostic->arguments()[idx].toFloat();
+            m_sum += static_cast<std::uint64_t>(value.value());
+        }
+        return Action::DropDiagnostic;
+    }
+
+    std::uint64_t m_sum = 0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double nanosecondsPer(Clock::time_point start, std::size_t count)
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       Clock::now() - start).count();
+    return double(elapsed) / count;
+}
+
+} // anonymous namespace
+
+int main()
+{
+    constexpr std::size_t numDiagnostics = 1 << 16;
+    constexpr int numRounds = 32;
+
+    Descriptor<void(float)> desc1("BENCH-ONE", "One argument");
+    Descriptor<void(float, float)> desc2("BENCH-TWO", "Two arguments");
+    Descriptor<void(float, float, float)> desc3("BENCH-THREE", "Three arguments");
+
+    std::printf("sizeof(Diagnostic) = %u, sizeof(Argument) = %u\n",
+                unsigned(sizeof(Diagnostic)), unsigned(sizeof(Argument)));
+
+    Engine engine;
+    Reader reader;
+    engine.subscribe("BENCH*", &reader);
+
+    // Publish: allocation, time stamping, dispatching and deallocation.
+    auto start = Clock::now();
+    for (std::size_t count = 0; count < numDiagnostics; ++count)
+    {
+        engine.publish(desc1, 1.0f);
+        engine.publish(desc2, 1.0f, 2.0f);
+        engine.publish(desc3, 1.0f, 2.0f, 3.0f);
+    }
+    std::printf("publish:  %6.1f ns/diagnostic\n",
+                nanosecondsPer(start, 3 * numDiagnostics));
+
+    // The same with blocks from a ring allocator.
+    RingAllocator ring(1 << 20);
+    Engine ringEngine(ring);
+    ringEngine.subscribe("BENCH*", &reader);
+    start = Clock::now();
+    for (std::size_t count = 0; count < numDiagnostics; ++count)
+    {
+        ringEngine.publish(desc1, 1.0f);
+        ringEngine.publish(desc2, 1.0f, 2.0f);
+        ringEngine.publish(desc3, 1.0f, 2.0f, 3.0f);
+    }
+    std::printf("publish (ring): %6.1f ns/diagnostic\n",
+                nanosecondsPer(start, 3 * numDiagnostics));
+
+    // Dispatch: repeatedly route a working set of live diagnostics to the
+    // subscriber. This is dominated by the cache lines touched per diagnostic.
+    Allocator allocator;
+    std::vector<Diagnostic*> diagnostics;
+    for (std::size_t count = 0; count < numDiagnostics; ++count)
+    {
+        diagnostics.push_back(Diagnostic::create(allocator, desc1, 1.0f));
+        diagnostics.push_back(Diagnostic::create(allocator, desc2, 1.0f, 2.0f));
+    }
+
+    start = Clock::now();
+    for (int round = 0; round < numRounds; ++round)
+        for (auto diagnostic : diagnostics)
+            engine.dispatch(diagnostic);
+    std::printf("dispatch: %6.1f ns/diagnostic\n",
+                nanosecondsPer(start, numRounds * diagnostics.size()));
+
+    // The same working set in random order, as it is seen by subscribers
+    // which receive diagnostics from many producers.
+    std::mt19937 generator;
+    std::shuffle(diagnostics.begin(), diagnostics.end(), generator);
+    start = Clock::now();
+    for (int round = 0; round < numRounds; ++round)
+        for (auto diagnostic : diagnostics)
+            engine.dispatch(diagnostic);
+    std::printf("shuffled: %6.1f ns/diagnostic\n",
+                nanosecondsPer(start, numRounds * diagnostics.size()));
+
+    // Format: a line of text for a diagnostic with three arguments.
+    Descriptor<void(int, double, const char*)> textDesc("BENCH-TEXT", "Text");
+    Diagnostic* text = Diagnostic::create(allocator, textDesc, 42, 3.25,
+                                          static_cast<const char*>("sensor"));
+    TextFormatter formatter;
+    std::vector<char> line(TextFormatter::maxLineSize(*text));
+    std::size_t numCharacters = 0;
+    start = Clock::now();
+    for (std::size_t count = 0; count < numDiagnostics; ++count)
+        numCharacters += formatter.format(*text, line.data()) - line.data();
+    std::printf("format:   %6.1f ns/diagnostic\n",
+                nanosecondsPer(start, numDiagnostics));
+    allocator.deallocate(text);
+    reader.m_sum += numCharacters;
+
+    for (auto diagnostic : diagnostics)
+        allocator.deallocate(diagnostic);
+
+    return reader.m_sum != 0 ? 0 : 1;
+}
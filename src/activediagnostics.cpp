@@ -0,0 +1,197 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "activediagnostics.hpp"
+#include "patternmatching.hpp"
+#include "segmentindex.hpp"
+
+#include <chrono>
+
+using namespace dime;
+
+namespace
+{
+
+//! The mask of the ten symbols of a code word.
+constexpr std::uint64_t wordMask = (std::uint64_t(1) << 60) - 1;
+
+//! Returns the key of a \p code, in which the first symbol is the most
+//! significant one. Keys thus order codes by their characters and all
+//! codes with a common prefix form a range.
+std::pair<std::uint64_t, std::uint64_t> sortKey(const Code& code) noexcept
+{
+    std::uint64_t key[2] = {0, 0};
+    for (int word = 0; word < 2; ++word)
+        for (int idx = 0; idx < 10; ++idx)
+            key[word] = (key[word] << 6) | ((code[word] >> (idx * 6)) & 0x3F);
+    return std::make_pair(key[0], key[1]);
+}
+
+std::int64_t toNanoseconds(const Diagnostic::TimePoint& timeStamp) noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                timeStamp.time_since_epoch()).count();
+}
+
+Diagnostic::TimePoint toTimePoint(std::int64_t nanoseconds) noexcept
+{
+    return Diagnostic::TimePoint(std::chrono::duration_cast<Diagnostic::TimePoint::duration>(
+                                     std::chrono::nanoseconds(nanoseconds)));
+}
+
+} // anonymous namespace
+
+
+ActiveDiagnostics::ActiveDiagnostics(std::size_t capacity)
+    : m_codes(capacity),
+      m_entries(new Entry[capacity])
+{
+    for (std::size_t idx = 0; idx < capacity; ++idx)
+    {
+        m_entries[idx].active = false;
+        m_entries[idx].firstSeen = 0;
+        m_entries[idx].lastSeen = 0;
+        m_entries[idx].numOccurrences = 0;
+    }
+}
+
+ActiveDiagnostics::~ActiveDiagnostics()
+{
+}
+
+Subscriber::Action ActiveDiagnostics::process(Diagnostic* diagnostic)
+{
+    std::uint32_t id = m_codes.intern(diagnostic->code());
+    if (id == CodeInterner::invalidId)
+        return Action::DropDiagnostic;
+
+    Entry& entry = m_entries[id];
+    std::int64_t timeStamp = toNanoseconds(diagnostic->timeStamp());
+    std::uint64_t numOccurrences = std::uint64_t(diagnostic->samplingWeight())
+                                   * (diagnostic->numRepeats() != 0 ? diagnostic->numRepeats() : 1);
+
+    // Only the activation takes the lock. Further diagnostics update the
+    // counters of the active entry.
+    if (!entry.active.load(DIME_STD::memory_order_acquire))
+    {
+        DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+        if (!entry.active.load(DIME_STD::memory_order_relaxed))
+        {
+            entry.firstSeen.store(timeStamp, DIME_STD::memory_order_relaxed);
+            entry.lastSeen.store(timeStamp, DIME_STD::memory_order_relaxed);
+            entry.numOccurrences.store(numOccurrences, DIME_STD::memory_order_relaxed);
+            m_index.emplace(sortKey(diagnostic->code()), id);
+            entry.active.store(true, DIME_STD::memory_order_release);
+            return Action::DropDiagnostic;
+        }
+    }
+
+    entry.numOccurrences.fetch_add(numOccurrences, DIME_STD::memory_order_relaxed);
+    std::int64_t lastSeen = entry.lastSeen.load(DIME_STD::memory_order_relaxed);
+    while (lastSeen < timeStamp
+           && !entry.lastSeen.compare_exchange_weak(lastSeen, timeStamp,
+                                                    DIME_STD::memory_order_relaxed))
+    {
+    }
+    return Action::DropDiagnostic;
+}
+
+bool ActiveDiagnostics::clear(const Code& code)
+{
+    std::uint32_t id = m_codes.find(code);
+    if (id == CodeInterner::invalidId)
+        return false;
+
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    if (!m_entries[id].active.load(DIME_STD::memory_order_relaxed))
+        return false;
+    m_entries[id].active.store(false, DIME_STD::memory_order_release);
+    m_index.erase(sortKey(code));
+    return true;
+}
+
+bool ActiveDiagnostics::isActive(const Code& code) const noexcept
+{
+    std::uint32_t id = m_codes.find(code);
+    return id != CodeInterner::invalidId
+           && m_entries[id].active.load(DIME_STD::memory_order_acquire);
+}
+
+optional<ActiveDiagnostic> ActiveDiagnostics::find(const Code& code) const noexcept
+{
+    std::uint32_t id = m_codes.find(code);
+    if (id == CodeInterner::invalidId
+        || !m_entries[id].active.load(DIME_STD::memory_order_acquire))
+    {
+        return optional<ActiveDiagnostic>();
+    }
+    return optional<ActiveDiagnostic>(snapshot(id));
+}
+
+std::vector<ActiveDiagnostic> ActiveDiagnostics::list(const char* pattern) const
+{
+    // The active codes, which start with the literal prefix of the
+    // pattern, form a range of the index. The remainder of the pattern is
+    // checked for every code in the range.
+    Code prefix;
+    unsigned length = literalPrefix(pattern, prefix);
+    Code mask = codePrefix(Code{wordMask, wordMask}, length);
+    Code last{prefix[0] | (wordMask & ~mask[0]), prefix[1] | (wordMask & ~mask[1])};
+    auto matcher = dime_detail::compilePattern(pattern);
+
+    std::vector<ActiveDiagnostic> result;
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    auto end = m_index.upper_bound(sortKey(last));
+    for (auto iter = m_index.lower_bound(sortKey(prefix)); iter != end; ++iter)
+    {
+        ActiveDiagnostic state = snapshot(iter->second);
+        if (matcher->matches(state.code))
+            result.push_back(state);
+    }
+    return result;
+}
+
+std::size_t ActiveDiagnostics::size() const
+{
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    return m_index.size();
+}
+
+ActiveDiagnostic ActiveDiagnostics::snapshot(std::uint32_t id) const noexcept
+{
+    // The identifier of an active entry has been assigned, so its code is
+    // known.
+    const Entry& entry = m_entries[id];
+    Code code{0, 0};
+    m_codes.code(id, code);
+    return ActiveDiagnostic{
+        code,
+        toTimePoint(entry.firstSeen.load(DIME_STD::memory_order_relaxed)),
+        toTimePoint(entry.lastSeen.load(DIME_STD::memory_order_relaxed)),
+        entry.numOccurrences.load(DIME_STD::memory_order_relaxed)};
+}
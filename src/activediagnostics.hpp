@@ -0,0 +1,154 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_ACTIVEDIAGNOSTICS_HPP
+#define DIME_ACTIVEDIAGNOSTICS_HPP
+
+#include "config.hpp"
+#include "argument.hpp"
+#include "code.hpp"
+#include "codeinterner.hpp"
+#include "diagnostic.hpp"
+#include "subscriber.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#ifdef DIME_USE_WEOS
+#include <weos/atomic.hpp>
+#include <weos/memory.hpp>
+#include <weos/mutex.hpp>
+#else
+#include <atomic>
+#include <memory>
+#include <mutex>
+#endif // DIME_USE_WEOS
+
+
+namespace dime
+{
+
+//! \brief The state of an active condition.
+struct ActiveDiagnostic
+{
+    Code code;
+    //! The time stamp of the diagnostic which has activated the condition.
+    Diagnostic::TimePoint firstSeen;
+    //! The time stamp of the latest diagnostic.
+    Diagnostic::TimePoint lastSeen;
+    //! The number of diagnostics since the activation. Merged repeats and
+    //! sampling weights are taken into account.
+    std::uint64_t numOccurrences;
+};
+
+//! \brief A table of the currently active conditions.
+//!
+//! Many codes stand for conditions, which become active and inactive, e.g.
+//! a sensor which is out of range. When the table is subscribed to an
+//! Engine, every diagnostic activates the condition of its code. The
+//! condition stays active until clear() is called.
+//!
+//! The codes are mapped to entries with a CodeInterner, so that a lookup
+//! takes constant time and a diagnostic of an active condition only
+//! updates atomic counters. Activating and clearing a condition takes a
+//! lock to maintain an index of the active codes, which is ordered by the
+//! characters of the code. A query with a pattern visits only the active
+//! codes, which start with the literal prefix of the pattern.
+class ActiveDiagnostics : public Subscriber
+{
+public:
+    //! \brief Creates a table for up to \p capacity distinct codes.
+    //!
+    //! Diagnostics with further codes are ignored.
+    explicit
+    ActiveDiagnostics(std::size_t capacity = 1024);
+
+    virtual
+    ~ActiveDiagnostics();
+
+    ActiveDiagnostics(const ActiveDiagnostics&) = delete;
+    ActiveDiagnostics& operator=(const ActiveDiagnostics&) = delete;
+
+    //! \brief Activates the condition of a \p diagnostic.
+    virtual
+    Action process(Diagnostic* diagnostic) override;
+
+    //! \brief Clears the condition of the \p code.
+    //!
+    //! Returns \p true, if the condition has been active.
+    bool clear(const Code& code);
+
+    //! \brief Checks if the condition of the \p code is active.
+    bool isActive(const Code& code) const noexcept;
+
+    //! \brief Returns the state of the condition of the \p code.
+    //!
+    //! Returns an empty optional, if the condition is not active. If the
+    //! condition changes concurrently, the fields may stem from different
+    //! diagnostics.
+    optional<ActiveDiagnostic> find(const Code& code) const noexcept;
+
+    //! \brief Lists the active conditions whose codes match the \p pattern.
+    //!
+    //! The conditions are ordered by their codes.
+    std::vector<ActiveDiagnostic> list(const char* pattern) const;
+
+    //! \brief Returns the number of active conditions.
+    std::size_t size() const;
+
+private:
+    struct Entry
+    {
+        DIME_STD::atomic<bool> active;
+        DIME_STD::atomic<std::int64_t> firstSeen;
+        DIME_STD::atomic<std::int64_t> lastSeen;
+        DIME_STD::atomic<std::uint64_t> numOccurrences;
+    };
+
+    //! A key which orders codes by their characters.
+    using SortKey = std::pair<std::uint64_t, std::uint64_t>;
+
+    //! Protects the index and the activation of entries.
+    mutable DIME_STD::mutex m_mutex;
+    //! Maps the codes to the entries.
+    CodeInterner m_codes;
+    //! The entry of every interned code.
+    DIME_STD::unique_ptr<Entry[]> m_entries;
+    //! The identifiers of the active codes.
+    std::map<SortKey, std::uint32_t> m_index;
+
+    //! Returns the state of the entry with the \p id.
+    ActiveDiagnostic snapshot(std::uint32_t id) const noexcept;
+};
+
+} // namespace dime
+
+#endif // DIME_ACTIVEDIAGNOSTICS_HPP
@@ -29,23 +29,46 @@
 #ifndef DIME_ALLOCATOR_HPP
 #define DIME_ALLOCATOR_HPP
 
+#include "config.hpp"
+
 #include <cstddef>
+#include <cstdint>
 
 
 namespace dime
 {
 
+//! \brief The default allocator for diagnostics.
+//!
+//! The allocator returns blocks which are aligned to a cache line. The
+//! pointer returned by the global operator new is stored in front of the
+//! aligned block.
+//!
+//! Other allocation strategies are implemented by overriding allocate()
+//! and deallocate(). An allocator throws \p std::bad_alloc, if it cannot
+//! satisfy a request.
 class Allocator
 {
 public:
+    virtual
+    ~Allocator()
+    {
+    }
+
+    virtual
     void* allocate(std::size_t size)
     {
-        return ::operator new(size);
+        char* raw = static_cast<char*>(::operator new(size + DIME_CACHE_LINE_SIZE));
+        char* aligned = raw + DIME_CACHE_LINE_SIZE
+                        - reinterpret_cast<std::uintptr_t>(raw) % DIME_CACHE_LINE_SIZE;
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return aligned;
     }
 
+    virtual
     void deallocate(void* p) noexcept
     {
-        ::operator delete(p);
+        ::operator delete(static_cast<void**>(p)[-1]);
     }
 };
 
@@ -0,0 +1,171 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "arena.hpp"
+
+#include <cstdint>
+
+#if defined(DIME_USE_WEOS) || !defined(__unix__)
+#include <new>
+#define DIME_ARENA_USE_HEAP
+#else
+#include <cerrno>
+#include <system_error>
+
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace dime;
+
+namespace
+{
+
+//! The size of a huge page.
+constexpr std::size_t hugePageSize = std::size_t(2) << 20;
+
+std::size_t roundUp(std::size_t value, std::size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+//! Writes to every page in [memory, memory + size).
+void touchPages(void* memory, std::size_t size, std::size_t pageSize)
+{
+    volatile char* iter = static_cast<char*>(memory);
+    for (std::size_t offset = 0; offset < size; offset += pageSize)
+        iter[offset] = 0;
+}
+
+} // anonymous namespace
+
+#ifdef DIME_ARENA_USE_HEAP
+
+// Without virtual memory, the arena falls back to the heap. Huge pages and
+// locking are not available.
+MemoryArena::MemoryArena(std::size_t size, const ArenaOptions& options)
+    : m_memory(nullptr),
+      m_size(roundUp(size, DIME_CACHE_LINE_SIZE)),
+      m_mapping(nullptr),
+      m_mappingSize(m_size + DIME_CACHE_LINE_SIZE),
+      m_hugePages(ArenaOptions::HugePages::None),
+      m_locked(false)
+{
+    m_mapping = ::operator new(m_mappingSize);
+    m_memory = static_cast<char*>(m_mapping) + DIME_CACHE_LINE_SIZE
+               - reinterpret_cast<std::uintptr_t>(m_mapping) % DIME_CACHE_LINE_SIZE;
+    if (options.prefault)
+        touchPages(m_memory, m_size, DIME_CACHE_LINE_SIZE);
+}
+
+MemoryArena::~MemoryArena()
+{
+    ::operator delete(m_mapping);
+}
+
+#else
+
+MemoryArena::MemoryArena(std::size_t size, const ArenaOptions& options)
+    : m_memory(nullptr),
+      m_size(0),
+      m_mapping(MAP_FAILED),
+      m_mappingSize(0),
+      m_hugePages(options.hugePages),
+      m_locked(false)
+{
+    std::size_t pageSize = std::size_t(::sysconf(_SC_PAGESIZE));
+
+#ifdef MAP_HUGETLB
+    if (m_hugePages == ArenaOptions::HugePages::Explicit)
+    {
+        m_size = roundUp(size, hugePageSize);
+        m_mappingSize = m_size;
+        m_mapping = ::mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (m_mapping != MAP_FAILED)
+        {
+            m_memory = m_mapping;
+            pageSize = hugePageSize;
+        }
+        else
+        {
+            m_hugePages = ArenaOptions::HugePages::Transparent;
+        }
+    }
+#else
+    if (m_hugePages == ArenaOptions::HugePages::Explicit)
+        m_hugePages = ArenaOptions::HugePages::Transparent;
+#endif // MAP_HUGETLB
+
+    if (m_mapping == MAP_FAILED)
+    {
+        // Transparent huge pages can only be used for the parts of a
+        // mapping which are aligned to a huge page. Thus, the mapping is
+        // enlarged and the memory is aligned within it.
+        bool transparent = m_hugePages == ArenaOptions::HugePages::Transparent;
+        m_size = roundUp(size, transparent ? hugePageSize : pageSize);
+        m_mappingSize = m_size + (transparent ? hugePageSize : 0);
+        m_mapping = ::mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m_mapping == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "mmap");
+
+        m_memory = reinterpret_cast<void*>(
+                       roundUp(reinterpret_cast<std::uintptr_t>(m_mapping),
+                               transparent ? hugePageSize : pageSize));
+#ifdef MADV_HUGEPAGE
+        if (transparent)
+            ::madvise(m_memory, m_size, MADV_HUGEPAGE);
+#else
+        m_hugePages = ArenaOptions::HugePages::None;
+#endif // MADV_HUGEPAGE
+    }
+
+    if (options.prefault)
+        touchPages(m_memory, m_size, pageSize);
+
+    if (options.lock)
+    {
+        if (::mlock(m_memory, m_size) != 0)
+        {
+            int error = errno;
+            ::munmap(m_mapping, m_mappingSize);
+            throw std::system_error(error, std::generic_category(), "mlock");
+        }
+        m_locked = true;
+    }
+}
+
+MemoryArena::~MemoryArena()
+{
+    if (m_locked)
+        ::munlock(m_memory, m_size);
+    ::munmap(m_mapping, m_mappingSize);
+}
+
+#endif // DIME_ARENA_USE_HEAP
@@ -0,0 +1,125 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_ARENA_HPP
+#define DIME_ARENA_HPP
+
+#include "config.hpp"
+
+#include <cstddef>
+
+
+namespace dime
+{
+
+//! \brief Options for a memory arena.
+struct ArenaOptions
+{
+    enum class HugePages
+    {
+        //! Use pages of the default size.
+        None,
+        //! Advise the kernel to back the arena with transparent huge pages.
+        Transparent,
+        //! Map the arena with explicit 2 MiB huge pages. Falls back to
+        //! transparent huge pages if none are reserved in the system.
+        Explicit
+    };
+
+    //! The kind of pages which back the arena.
+    HugePages hugePages = HugePages::None;
+    //! If set, every page is touched when the arena is created.
+    bool prefault = true;
+    //! If set, the arena is locked into physical memory.
+    bool lock = false;
+};
+
+//! \brief A fixed-size block of memory.
+//!
+//! The arena maps its memory once when it is created. Optionally, it
+//! uses huge pages to reduce TLB misses, touches every page in advance
+//! and locks them into memory. Page faults are then paid at start-up
+//! instead of when the first diagnostics are published. The memory is
+//! aligned to a cache line.
+class MemoryArena
+{
+public:
+    //! \brief Creates an arena of \p size bytes.
+    //!
+    //! The size is rounded up to a multiple of the page size. Throws
+    //! \p std::system_error if the memory cannot be mapped or locked.
+    explicit
+    MemoryArena(std::size_t size, const ArenaOptions& options = ArenaOptions());
+
+    ~MemoryArena();
+
+    MemoryArena(const MemoryArena&) = delete;
+    MemoryArena& operator=(const MemoryArena&) = delete;
+
+    //! \brief Returns a pointer to the memory.
+    void* data() const noexcept
+    {
+        return m_memory;
+    }
+
+    //! \brief Returns the size of the memory in bytes.
+    std::size_t size() const noexcept
+    {
+        return m_size;
+    }
+
+    //! \brief Returns the kind of pages which back the arena.
+    ArenaOptions::HugePages hugePages() const noexcept
+    {
+        return m_hugePages;
+    }
+
+    //! \brief Checks if the arena is locked into memory.
+    bool locked() const noexcept
+    {
+        return m_locked;
+    }
+
+private:
+    //! The start of the usable memory.
+    void* m_memory;
+    //! The size of the usable memory.
+    std::size_t m_size;
+    //! The start of the mapping.
+    void* m_mapping;
+    //! The size of the mapping.
+    std::size_t m_mappingSize;
+    //! The kind of pages which back the arena.
+    ArenaOptions::HugePages m_hugePages;
+    //! Set if the arena is locked into memory.
+    bool m_locked;
+};
+
+} // namespace dime
+
+#endif // DIME_ARENA_HPP
@@ -29,6 +29,9 @@
 #ifndef DIME_ARGUMENT_HPP
 #define DIME_ARGUMENT_HPP
 
+#include <cfloat>
+#include <cstddef>
+#include <cstring>
 #include <type_traits>
 
 
@@ -58,6 +61,11 @@ public:
             new (&m_value) T(other.value());
     }
 
+    explicit operator bool() const
+    {
+        return m_valid;
+    }
+
     T& value()
     {
         return *reinterpret_cast<T*>(&m_value);
@@ -74,8 +82,28 @@ private:
 };
 
 
+namespace dime_detail
+{
+
+constexpr
+std::size_t maxSize(std::size_t a, std::size_t b)
+{
+    return a > b ? a : b;
+}
+
+//! The number of bytes which are needed to store a long double. The x87
+//! extended precision format has only 80 significant bits, the remaining
+//! padding bytes are not stored.
+constexpr std::size_t longDoubleSize = LDBL_MANT_DIG == 64 ? 10 : sizeof(long double);
+
+//! The number of bytes which are needed to store the value of an argument.
+constexpr std::size_t argumentPayloadSize
+        = maxSize(maxSize(sizeof(double), sizeof(const char*)), longDoubleSize);
+
+} // namespace dime_detail
+
 //! \brief An enumeration of argument types.
-enum class ArgumentKind
+enum class ArgumentKind : unsigned char
 {
     SignedInteger,
     UnsignedInteger,
@@ -92,67 +120,114 @@ class Argument
 {
 public:
     Argument(int value)
-        : m_integer(value),
-          m_kind(ArgumentKind::SignedInteger)
+        : m_kind(ArgumentKind::SignedInteger)
     {
+        store(value);
     }
 
     Argument(unsigned value)
-        : m_unsigned(value),
-          m_kind(ArgumentKind::UnsignedInteger)
+        : m_kind(ArgumentKind::UnsignedInteger)
     {
+        store(value);
     }
 
     Argument(float value)
-        : m_float(value),
-          m_kind(ArgumentKind::Float)
+        : m_kind(ArgumentKind::Float)
     {
+        store(value);
     }
 
     Argument(double value)
-        : m_double(value),
-          m_kind(ArgumentKind::Double)
+        : m_kind(ArgumentKind::Double)
     {
+        store(value);
     }
 
     Argument(long double value)
-        : m_longDouble(value),
-          m_kind(ArgumentKind::LongDouble)
+        : m_kind(ArgumentKind::LongDouble)
     {
+        std::memcpy(m_data, &value, dime_detail::longDoubleSize);
     }
 
     Argument(const char* value)
-        : m_string(value),
-          m_kind(ArgumentKind::String)
+        : m_kind(ArgumentKind::String)
+    {
+        store(value);
+    }
+
+    //! \brief Returns the kind of the argument.
+    ArgumentKind kind() const noexcept
     {
+        return m_kind;
     }
 
     optional<int> toInteger() const
     {
         return m_kind == ArgumentKind::SignedInteger
-               ? optional<int>(m_integer)
+               ? optional<int>(load<int>())
                : optional<int>();
     }
 
+    optional<unsigned> toUnsigned() const
+    {
+        return m_kind == ArgumentKind::UnsignedInteger
+               ? optional<unsigned>(load<unsigned>())
+               : optional<unsigned>();
+    }
+
     optional<float> toFloat() const
     {
         return m_kind == ArgumentKind::Float
-               ? optional<float>(m_float)
+               ? optional<float>(load<float>())
                : optional<float>();
     }
 
-private:
-    union
+    optional<double> toDouble() const
     {
-        int m_integer;
-        unsigned m_unsigned;
-        float m_float;
-        double m_double;
-        long double m_longDouble;
-        const char* m_string;
-    };
+        return m_kind == ArgumentKind::Double
+               ? optional<double>(load<double>())
+               : optional<double>();
+    }
+
+    optional<long double> toLongDouble() const
+    {
+        if (m_kind != ArgumentKind::LongDouble)
+            return optional<long double>();
+        long double value = 0;
+        std::memcpy(&value, m_data, dime_detail::longDoubleSize);
+        return optional<long double>(value);
+    }
+
+    optional<const char*> toString() const
+    {
+        return m_kind == ArgumentKind::String
+               ? optional<const char*>(load<const char*>())
+               : optional<const char*>();
+    }
+
+private:
+    //! The value of the argument. The bytes are not overlaid with a long
+    //! double because its alignment would double the size of an argument.
+    //! This way, an argument takes 16 bytes on x86.
+    alignas(double) unsigned char m_data[dime_detail::argumentPayloadSize];
 
     ArgumentKind m_kind;
+
+
+    template <typename T>
+    void store(T value) noexcept
+    {
+        static_assert(sizeof(T) <= sizeof(m_data), "Argument is too large");
+        std::memcpy(m_data, &value, sizeof(T));
+    }
+
+    template <typename T>
+    T load() const noexcept
+    {
+        T value;
+        std::memcpy(&value, m_data, sizeof(T));
+        return value;
+    }
 };
 
 } // namespace dime
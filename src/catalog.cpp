@@ -0,0 +1,201 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catalog.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using namespace dime;
+
+// The linker defines these symbols for the section "dime_catalog". They are
+// weak, so that a binary without catalog records links, too.
+#if defined(__GNUC__) && defined(__ELF__)
+extern "C"
+{
+extern const char __start_dime_catalog[] __attribute__((weak));
+extern const char __stop_dime_catalog[] __attribute__((weak));
+}
+#endif
+
+
+namespace
+{
+
+bool codeLess(const CatalogEntry& a, const CatalogEntry& b) noexcept
+{
+    return a.code[1] != b.code[1] ? a.code[1] < b.code[1] : a.code[0] < b.code[0];
+}
+
+//! Returns the length of the null-terminated string at \p begin or -1 if
+//! there is no terminator before \p end.
+std::ptrdiff_t terminatedLength(const char* begin, const char* end) noexcept
+{
+    const void* terminator = std::memchr(begin, 0, std::size_t(end - begin));
+    return terminator ? static_cast<const char*>(terminator) - begin : -1;
+}
+
+} // anonymous namespace
+
+
+Catalog::Catalog() = default;
+
+Catalog::~Catalog() = default;
+
+bool Catalog::load(const void* data, std::size_t size)
+{
+    std::unique_ptr<char[]> buffer(new char[size]);
+    if (size)
+        std::memcpy(buffer.get(), data, size);
+
+    std::vector<CatalogEntry> entries;
+    const char* iter = buffer.get();
+    const char* end = iter + size;
+    while (iter != end)
+    {
+        if (*iter == 0)
+        {
+            ++iter;
+            continue;
+        }
+        if (static_cast<unsigned char>(*iter++) != catalogRecordMarker)
+            return false;
+
+        CatalogEntry entry;
+        for (;; ++iter)
+        {
+            if (iter == end)
+                return false;
+            unsigned char kind = static_cast<unsigned char>(*iter);
+            if (kind == catalogKindsEnd)
+                break;
+            if (kind > static_cast<unsigned char>(ArgumentKind::String))
+                return false;
+            entry.kinds.push_back(static_cast<ArgumentKind>(kind));
+        }
+        ++iter;
+
+        std::ptrdiff_t codeLength = terminatedLength(iter, end);
+        if (codeLength < 0 || !parseCode(iter, std::size_t(codeLength), entry.code))
+            return false;
+        iter += codeLength + 1;
+
+        std::ptrdiff_t textLength = terminatedLength(iter, end);
+        if (textLength < 0)
+            return false;
+        entry.text = iter;
+        iter += textLength + 1;
+        try
+        {
+            entry.explanation = dime_detail::parseExplanation(
+                                    entry.text, entry.kinds.data(), entry.kinds.size());
+        }
+        catch (InvalidExplanationFormat&)
+        {
+            return false;
+        }
+        entries.push_back(std::move(entry));
+    }
+
+    // Keep the first entry of every code.
+    m_entries.insert(m_entries.end(),
+                     std::make_move_iterator(entries.begin()),
+                     std::make_move_iterator(entries.end()));
+    std::stable_sort(m_entries.begin(), m_entries.end(), codeLess);
+    m_entries.erase(std::unique(m_entries.begin(), m_entries.end(),
+                                [](const CatalogEntry& a, const CatalogEntry& b) {
+                                    return !codeLess(a, b) && !codeLess(b, a);
+                                }),
+                    m_entries.end());
+    m_buffers.push_back(std::move(buffer));
+    return true;
+}
+
+bool Catalog::loadBinary()
+{
+#if defined(__GNUC__) && defined(__ELF__)
+    if (__start_dime_catalog && __stop_dime_catalog)
+        return load(__start_dime_catalog,
+                    std::size_t(__stop_dime_catalog - __start_dime_catalog));
+#endif
+    return true;
+}
+
+bool Catalog::loadFile(const char* path)
+{
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file)
+        return false;
+
+    std::vector<char> data;
+    char chunk[4096];
+    std::size_t numRead;
+    while ((numRead = std::fread(chunk, 1, sizeof(chunk), file)) != 0)
+        data.insert(data.end(), chunk, chunk + numRead);
+    bool success = !std::ferror(file);
+    std::fclose(file);
+    return success && load(data.data(), data.size());
+}
+
+bool Catalog::writeFile(const char* path) const
+{
+    std::FILE* file = std::fopen(path, "wb");
+    if (!file)
+        return false;
+
+    std::vector<char> record;
+    bool success = true;
+    for (const CatalogEntry& entry : m_entries)
+    {
+        record.clear();
+        record.push_back(char(catalogRecordMarker));
+        for (ArgumentKind kind : entry.kinds)
+            record.push_back(char(kind));
+        record.push_back(char(catalogKindsEnd));
+        char code[20];
+        record.insert(record.end(), code, code + entry.code.toChars(code));
+        record.push_back(0);
+        record.insert(record.end(), entry.text, entry.text + std::strlen(entry.text) + 1);
+        success &= std::fwrite(record.data(), 1, record.size(), file) == record.size();
+    }
+    success &= std::fclose(file) == 0;
+    return success;
+}
+
+const CatalogEntry* Catalog::find(const Code& code) const noexcept
+{
+    auto iter = std::lower_bound(m_entries.begin(), m_entries.end(), code,
+                                 [](const CatalogEntry& entry, const Code& code) {
+                                     return entry.code[1] != code[1] ? entry.code[1] < code[1]
+                                                                     : entry.code[0] < code[0];
+                                 });
+    if (iter == m_entries.end() || iter->code != code)
+        return nullptr;
+    return &*iter;
+}
@@ -0,0 +1,208 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_CATALOG_HPP
+#define DIME_CATALOG_HPP
+
+#include "code.hpp"
+#include "descriptor.hpp"
+#include "explanation.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+
+namespace dime
+{
+
+// A catalog maps codes to the explanations and argument kinds of their
+// descriptors. Descriptors which are defined with DIME_DESCRIPTOR() place a
+// catalog record in the section "dime_catalog" of the binary and keep no
+// explanation themselves. The process only handles codes and raw arguments.
+// The explanations are rendered later by an offline tool or a collector,
+// which loads the catalog.
+//
+// The build extracts the catalog from the linked binary with
+//
+//     objcopy -O binary --only-section=dime_catalog app app.catalog
+//
+// A record consists of the bytes
+//
+//     marker  u8      catalogRecordMarker
+//     kinds   u8[]    the ArgumentKind of every argument
+//     end     u8      catalogKindsEnd
+//     code    char[]  null-terminated
+//     text    char[]  the explanation, null-terminated
+//
+// Zero bytes between records are padding.
+
+//! The first byte of a catalog record.
+constexpr unsigned char catalogRecordMarker = 0xD1;
+//! Terminates the argument kinds of a catalog record.
+constexpr unsigned char catalogKindsEnd = 0xFF;
+
+namespace dime_detail
+{
+
+//! \brief A catalog record as it is placed in the binary.
+//!
+//! Only bytes are used, so that records need no alignment.
+template <std::size_t TNumArguments, std::size_t TCodeSize, std::size_t TTextSize>
+struct CatalogRecord
+{
+    unsigned char marker;
+    unsigned char kinds[TNumArguments + 1];
+    char code[TCodeSize];
+    char text[TTextSize];
+};
+
+template <typename TSignature>
+struct CatalogRecordMaker;
+
+template <typename... TArguments>
+struct CatalogRecordMaker<void(TArguments...)>
+{
+    //! \brief Creates the catalog record of a descriptor.
+    //!
+    //! The code and the explanation are checked like in the constructor of
+    //! a Descriptor.
+    template <std::size_t TCodeSize, std::size_t TTextSize>
+    static constexpr
+    CatalogRecord<sizeof...(TArguments), TCodeSize, TTextSize>
+    make(const char (&code)[TCodeSize], const char (&text)[TTextSize])
+    {
+        makeCode(code, 0);
+        parseExplanation<TArguments...>(text);
+
+        const ArgumentKind kinds[] = {ArgumentKindOf<std::decay_t<TArguments>>::value...,
+                                      ArgumentKind::String};
+        CatalogRecord<sizeof...(TArguments), TCodeSize, TTextSize> record{};
+        record.marker = catalogRecordMarker;
+        for (std::size_t idx = 0; idx < sizeof...(TArguments); ++idx)
+            record.kinds[idx] = static_cast<unsigned char>(kinds[idx]);
+        record.kinds[sizeof...(TArguments)] = catalogKindsEnd;
+        for (std::size_t idx = 0; idx < TCodeSize; ++idx)
+            record.code[idx] = code[idx];
+        for (std::size_t idx = 0; idx < TTextSize; ++idx)
+            record.text[idx] = text[idx];
+        return record;
+    }
+};
+
+} // namespace dime_detail
+
+//! \def DIME_DESCRIPTOR(name, signature, code, explanation)
+//! \brief Defines a descriptor whose explanation is kept in the catalog.
+//!
+//! Defines the \p constexpr Descriptor<signature> \p name at namespace scope.
+//! The \p code and the \p explanation must be string literals. Both are
+//! checked at compile-time. The explanation is placed in the catalog
+//! section and not in the descriptor. Compilers without support for ELF
+//! sections keep the explanation in the descriptor.
+//!
+//!     DIME_DESCRIPTOR(pumpRange, void(int, int), "PUMP_RANGE", "speed {0} above {1}");
+#if defined(__GNUC__) && defined(__ELF__)
+#define DIME_DESCRIPTOR(name, signature, code, explanation)                    \
+    __attribute__((section("dime_catalog"), used))                            \
+    constexpr auto name##DimeCatalogRecord                                    \
+            = ::dime::dime_detail::CatalogRecordMaker<signature>::make(       \
+                  code, explanation);                                         \
+    constexpr ::dime::Descriptor<signature> name(code, nullptr)
+#else
+#define DIME_DESCRIPTOR(name, signature, code, explanation)                    \
+    constexpr ::dime::Descriptor<signature> name(code, explanation)
+#endif
+
+//! \brief An entry of a catalog.
+struct CatalogEntry
+{
+    Code code;
+    //! The kinds of the arguments.
+    std::vector<ArgumentKind> kinds;
+    //! The explanation. Null-terminated.
+    const char* text;
+    //! The explanation split into segments.
+    Explanation explanation;
+};
+
+//! \brief A catalog of explanations.
+//!
+//! The catalog is loaded from the records of a binary or from a file. If
+//! several records have the same code, the first one is used.
+class Catalog
+{
+public:
+    Catalog();
+    ~Catalog();
+
+    Catalog(const Catalog&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+
+    //! \brief Loads catalog records.
+    //!
+    //! Adds the records in the \p size bytes at \p data. Returns \p false
+    //! and adds no record, if the data is malformed.
+    bool load(const void* data, std::size_t size);
+
+    //! \brief Loads the catalog records of the running binary.
+    //!
+    //! Returns \p false, if the data is malformed. A binary without
+    //! records yields an empty catalog.
+    bool loadBinary();
+
+    //! \brief Loads catalog records from the file at \p path.
+    bool loadFile(const char* path);
+
+    //! \brief Writes all entries to the file at \p path.
+    //!
+    //! The file can be loaded with loadFile(). This allows a process to
+    //! emit its own catalog.
+    bool writeFile(const char* path) const;
+
+    //! \brief Returns the entry of a \p code or a null-pointer if there is
+    //! none.
+    const CatalogEntry* find(const Code& code) const noexcept;
+
+    //! \brief Returns the number of entries.
+    std::size_t size() const noexcept
+    {
+        return m_entries.size();
+    }
+
+private:
+    //! The loaded data. The entries point into it.
+    std::vector<std::unique_ptr<char[]>> m_buffers;
+    //! The entries sorted by their code.
+    std::vector<CatalogEntry> m_entries;
+};
+
+} // namespace dime
+
+#endif // DIME_CATALOG_HPP
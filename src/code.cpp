@@ -0,0 +1,213 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "code.hpp"
+#include "config.hpp"
+
+#include <cstring>
+
+#if DIME_USE_SSSE3
+#include <tmmintrin.h>
+#endif // DIME_USE_SSSE3
+
+
+using namespace dime;
+using namespace dime::dime_detail;
+
+namespace
+{
+
+//! The mask of the 60 bits which hold the symbols in a word of a code.
+constexpr std::uint64_t wordMask = (std::uint64_t(1) << 60) - 1;
+
+#if DIME_USE_SSSE3
+
+// The 20 symbols of a code are handled as a stream of 120 bits, in which
+// every 3 bytes hold 4 symbols like in Base64. The symbols are unpacked to
+// and packed from one byte per symbol in the 32-bit lanes of a register.
+
+//! Unpacks the symbols from lanes holding the bytes [b0, b1, b1, b2].
+inline
+__m128i unpackSymbols(__m128i lanes) noexcept
+{
+    __m128i s0 = _mm_and_si128(lanes, _mm_set1_epi32(0x0000003F));
+    __m128i s1 = _mm_mullo_epi16(_mm_and_si128(lanes, _mm_set1_epi32(0x00000FC0)),
+                                 _mm_set1_epi32(0x00000004));
+    __m128i s2 = _mm_mulhi_epu16(_mm_and_si128(lanes, _mm_set1_epi32(0x03F00000)),
+                                 _mm_set1_epi32(0x10000000));
+    __m128i s3 = _mm_mulhi_epu16(_mm_and_si128(lanes, _mm_set1_epi32(int(0xFC000000u))),
+                                 _mm_set1_epi32(0x40000000));
+    return _mm_or_si128(_mm_or_si128(s0, s1), _mm_or_si128(s2, s3));
+}
+
+//! Packs 4 symbols per 32-bit lane into 3 bytes. The result holds 12 bytes.
+inline
+__m128i packSymbols(__m128i symbols) noexcept
+{
+    __m128i pairs = _mm_maddubs_epi16(symbols, _mm_set1_epi16(0x4001));
+    __m128i lanes = _mm_madd_epi16(pairs, _mm_set1_epi32(0x10000001));
+    return _mm_shuffle_epi8(lanes, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+                                                 -1, -1, -1, -1));
+}
+
+//! Maps symbols to their characters (see decompressionTable).
+inline
+__m128i symbolsToAscii(__m128i symbols) noexcept
+{
+    __m128i offset = _mm_set1_epi8(47);
+    offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(symbols, _mm_set1_epi8(10)),
+                                                _mm_set1_epi8(7)));
+    offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(symbols, _mm_set1_epi8(36)),
+                                                _mm_set1_epi8(4)));
+    offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(symbols, _mm_set1_epi8(37)),
+                                                _mm_set1_epi8(1)));
+    offset = _mm_sub_epi8(offset, _mm_and_si128(_mm_cmpeq_epi8(symbols, _mm_setzero_si128()),
+                                                _mm_set1_epi8(2)));
+    return _mm_add_epi8(symbols, offset);
+}
+
+//! Returns a mask of the characters in [\p first, \p first + \p count).
+inline
+__m128i inRange(__m128i chars, char first, char count) noexcept
+{
+    __m128i biased = _mm_add_epi8(chars, _mm_set1_epi8(char(128 - first)));
+    return _mm_cmplt_epi8(biased, _mm_set1_epi8(char(-128 + count)));
+}
+
+//! Maps characters to their symbols (see compressionTable). Sets \p valid
+//! to a mask of the characters which are allowed in a code.
+inline
+__m128i asciiToSymbols(__m128i chars, __m128i& valid) noexcept
+{
+    __m128i dash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('-'));
+    __m128i digit = inRange(chars, '0', 10);
+    __m128i upper = inRange(chars, 'A', 26);
+    __m128i underscore = _mm_cmpeq_epi8(chars, _mm_set1_epi8('_'));
+    __m128i lower = inRange(chars, 'a', 26);
+
+    valid = _mm_or_si128(_mm_or_si128(dash, digit),
+                         _mm_or_si128(_mm_or_si128(upper, underscore), lower));
+    __m128i offset = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(dash, _mm_set1_epi8('-')),
+                         _mm_and_si128(digit, _mm_set1_epi8('0' - 1))),
+            _mm_or_si128(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8('A' - 11)),
+                                      _mm_and_si128(underscore, _mm_set1_epi8('_' - 37))),
+                         _mm_and_si128(lower, _mm_set1_epi8('a' - 38))));
+    return _mm_sub_epi8(chars, offset);
+}
+
+#endif // DIME_USE_SSSE3
+
+} // anonymous namespace
+
+#if DIME_USE_SSSE3
+
+std::size_t Code::toChars(char* dest) const noexcept
+{
+    __m128i stream = _mm_set_epi64x(std::int64_t(data[1] >> 4),
+                                    std::int64_t((data[0] & wordMask) | (data[1] << 60)));
+    __m128i low = unpackSymbols(_mm_shuffle_epi8(
+            stream, _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11)));
+    __m128i high = unpackSymbols(_mm_shuffle_epi8(
+            stream, _mm_setr_epi8(12, 13, 13, 14, -1, -1, -1, -1,
+                                  -1, -1, -1, -1, -1, -1, -1, -1)));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), symbolsToAscii(low));
+    int tail = _mm_cvtsi128_si32(symbolsToAscii(high));
+    std::memcpy(dest + 16, &tail, 4);
+
+    unsigned used = unsigned(~_mm_movemask_epi8(_mm_cmpeq_epi8(low, _mm_setzero_si128())))
+                    & 0xFFFFu;
+    used |= (unsigned(~_mm_movemask_epi8(_mm_cmpeq_epi8(high, _mm_setzero_si128()))) & 0xFu)
+            << 16;
+    return used ? std::size_t(32 - __builtin_clz(used)) : 0;
+}
+
+bool dime::parseCode(const char* text, std::size_t length, Code& code) noexcept
+{
+    if (length > 20)
+        return false;
+
+    // Fill the characters after the text with the padding symbol.
+    char buffer[32];
+    std::memset(buffer, '-', sizeof(buffer));
+    if (length)
+        std::memcpy(buffer, text, length);
+
+    __m128i validLow, validHigh;
+    __m128i low = asciiToSymbols(_mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer)),
+                                 validLow);
+    __m128i high = asciiToSymbols(_mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 16)),
+                                  validHigh);
+    if (_mm_movemask_epi8(_mm_and_si128(validLow, validHigh)) != 0xFFFF)
+        return false;
+
+    __m128i stream = _mm_or_si128(packSymbols(low), _mm_slli_si128(packSymbols(high), 12));
+    std::uint64_t words[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(words), stream);
+    code.data[0] = words[0] & wordMask;
+    code.data[1] = ((words[0] >> 60) | (words[1] << 4)) & wordMask;
+    return true;
+}
+
+#else
+
+std::size_t Code::toChars(char* dest) const noexcept
+{
+    std::size_t length = 0;
+    for (int n = 0; n < 2; ++n)
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            unsigned symbol = (data[n] >> (i * 6)) & 0x3f;
+            dest[n * 10 + i] = decompressionTable[symbol];
+            if (symbol)
+                length = std::size_t(n * 10 + i + 1);
+        }
+    }
+    return length;
+}
+
+bool dime::parseCode(const char* text, std::size_t length, Code& code) noexcept
+{
+    if (length > 20)
+        return false;
+
+    Code result{0, 0};
+    for (std::size_t idx = 0; idx < length; ++idx)
+    {
+        unsigned char c = static_cast<unsigned char>(text[idx]);
+        if (c >= 0x80 || compressionTable[c] == 99)
+            return false;
+        result.data[idx / 10] |= compressionTable[c] << ((idx % 10) * 6);
+    }
+    code = result;
+    return true;
+}
+
+#endif // DIME_USE_SSSE3
@@ -29,6 +29,7 @@
 #ifndef DIME_CODE_HPP
 #define DIME_CODE_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
@@ -70,6 +71,22 @@ struct Code
         return data[idx];
     }
 
+    //! \brief Checks if the code is short.
+    //!
+    //! A code with at most 10 characters fits into the first word. The
+    //! second word of a short code is zero.
+    constexpr
+    bool isShort() const noexcept
+    {
+        return data[1] == 0;
+    }
+
+    //! \brief Writes the characters of the code.
+    //!
+    //! Writes all 20 characters including the padding to \p dest and returns
+    //! the number of characters without the trailing padding.
+    std::size_t toChars(char* dest) const noexcept;
+
     // TODO: remove
     std::string toString() const
     {
@@ -83,6 +100,22 @@ struct Code
     std::uint64_t data[2];
 };
 
+//! \brief Compares two codes.
+//!
+//! The first words are compared first, so that short codes, which differ
+//! only in the first word, take a single comparison.
+constexpr
+bool operator==(const Code& x, const Code& y) noexcept
+{
+    return x.data[0] == y.data[0] && x.data[1] == y.data[1];
+}
+
+constexpr
+bool operator!=(const Code& x, const Code& y) noexcept
+{
+    return !(x == y);
+}
+
 struct IdentifierTooLongOrWrongChar {}; // TODO: split
 
 namespace dime_detail
@@ -118,6 +151,14 @@ Code makeCode(const char* code)
     return dime_detail::makeCode(code, 0);
 }
 
+//! \brief Parses a diagnosis code at run-time.
+//!
+//! Converts the \p length characters at \p text to the \p code. In contrast
+//! to makeCode(), the text need not be null-terminated and errors are not
+//! reported with an exception. Returns \p false, if the text is longer than
+//! 20 characters or contains a character which is not allowed in a code.
+bool parseCode(const char* text, std::size_t length, Code& code) noexcept;
+
 } // namespace dime
 
 #endif // DIME_CODE_HPP
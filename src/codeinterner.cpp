@@ -0,0 +1,193 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "codeinterner.hpp"
+#include "registry.hpp"
+
+#include <new>
+
+using namespace dime;
+
+namespace
+{
+
+//! The bit which marks a written word of a slot. A word of a code has 60
+//! bits, so the bit is never set in the code itself.
+constexpr std::uint64_t usedWord = std::uint64_t(1) << 63;
+
+} // anonymous namespace
+
+constexpr std::uint32_t CodeInterner::invalidId;
+
+CodeInterner::CodeInterner(std::size_t capacity)
+    : m_capacity(capacity),
+      m_slotMask(0),
+      m_slots(nullptr),
+      m_idSlots(nullptr),
+      m_numReserved(0),
+      m_size(0)
+{
+    if (capacity > (std::size_t(1) << 30))
+        throw std::bad_alloc();
+
+    m_slotMask = dime_detail::nextPowerOfTwo(2 * (capacity != 0 ? capacity : 1)) - 1;
+    m_slots.reset(new Slot[m_slotMask + 1]);
+    m_idSlots.reset(new DIME_STD::atomic<Slot*>[capacity]);
+    for (std::size_t idx = 0; idx <= m_slotMask; ++idx)
+    {
+        m_slots[idx].words[0] = 0;
+        m_slots[idx].words[1] = 0;
+        m_slots[idx].id = invalidId;
+    }
+    for (std::size_t idx = 0; idx < capacity; ++idx)
+        m_idSlots[idx] = nullptr;
+}
+
+std::uint32_t CodeInterner::intern(const Code& code) noexcept
+{
+    const std::uint64_t first = code[0] | usedWord;
+    const std::uint64_t second = code[1] | usedWord;
+    bool reserved = false;
+    for (std::size_t idx = dime_detail::hashCode(code); ; ++idx)
+    {
+        Slot& slot = m_slots[idx & m_slotMask];
+        std::uint64_t word = slot.words[0].load(DIME_STD::memory_order_acquire);
+        if (word == 0)
+        {
+            // Reserve room for a new code before claiming the slot. Every
+            // claimed slot uses up a reservation. As at most half of the
+            // slots are ever claimed, the probing ends.
+            if (!reserved)
+            {
+                if (m_numReserved.fetch_add(1, DIME_STD::memory_order_relaxed) >= m_capacity)
+                {
+                    m_numReserved.fetch_sub(1, DIME_STD::memory_order_relaxed);
+                    return invalidId;
+                }
+                reserved = true;
+            }
+
+            if (slot.words[0].compare_exchange_strong(word, first,
+                                                      DIME_STD::memory_order_acq_rel,
+                                                      DIME_STD::memory_order_acquire))
+            {
+                word = first;
+                reserved = false;
+            }
+        }
+        if (word != first)
+            continue;
+
+        // The second word is written by the first thread which gets here,
+        // which need not be the thread which has written the first word.
+        word = slot.words[1].load(DIME_STD::memory_order_acquire);
+        if (word == 0
+            && slot.words[1].compare_exchange_strong(word, second,
+                                                     DIME_STD::memory_order_acq_rel,
+                                                     DIME_STD::memory_order_acquire))
+        {
+            word = second;
+        }
+        if (word != second)
+            continue;
+
+        if (reserved)
+            m_numReserved.fetch_sub(1, DIME_STD::memory_order_relaxed);
+        return assignId(slot);
+    }
+}
+
+std::uint32_t CodeInterner::find(const Code& code) const noexcept
+{
+    const std::uint64_t first = code[0] | usedWord;
+    const std::uint64_t second = code[1] | usedWord;
+    for (std::size_t idx = dime_detail::hashCode(code); ; ++idx)
+    {
+        const Slot& slot = m_slots[idx & m_slotMask];
+        std::uint64_t word = slot.words[0].load(DIME_STD::memory_order_acquire);
+        if (word == 0)
+            return invalidId;
+        if (word != first)
+            continue;
+
+        // An insertion, which has not written the second word or not
+        // assigned the identifier yet, has not happened yet. The code
+        // cannot be stored in a later slot in this case.
+        word = slot.words[1].load(DIME_STD::memory_order_acquire);
+        if (word == 0)
+            return invalidId;
+        if (word == second)
+            return slot.id.load(DIME_STD::memory_order_acquire);
+    }
+}
+
+bool CodeInterner::code(std::uint32_t id, Code& code) const noexcept
+{
+    const Slot* slot = id < m_capacity
+                       ? m_idSlots[id].load(DIME_STD::memory_order_acquire)
+                       : nullptr;
+    if (!slot)
+        return false;
+    code = Code{slot->words[0].load(DIME_STD::memory_order_relaxed) & ~usedWord,
+                slot->words[1].load(DIME_STD::memory_order_relaxed) & ~usedWord};
+    return true;
+}
+
+std::uint32_t CodeInterner::assignId(Slot& slot) noexcept
+{
+    // The identifiers are handed out in order. Every thread, which needs an
+    // identifier for a slot, helps to complete the assignment of the next
+    // identifier, which may be for another slot, before it tries again.
+    // The identifier of a slot is set before the size is incremented past
+    // it, so a slot never gets two identifiers.
+    while (true)
+    {
+        std::uint32_t next = m_size.load(DIME_STD::memory_order_acquire);
+        std::uint32_t id = slot.id.load(DIME_STD::memory_order_acquire);
+        if (id != invalidId)
+            return id;
+        // Cannot happen as there is an identifier for every reservation.
+        if (next >= m_capacity)
+            return invalidId;
+
+        Slot* owner = nullptr;
+        if (m_idSlots[next].compare_exchange_strong(owner, &slot,
+                                                    DIME_STD::memory_order_acq_rel,
+                                                    DIME_STD::memory_order_acquire))
+        {
+            owner = &slot;
+        }
+        id = invalidId;
+        owner->id.compare_exchange_strong(id, next,
+                                          DIME_STD::memory_order_acq_rel,
+                                          DIME_STD::memory_order_acquire);
+        m_size.compare_exchange_strong(next, next + 1,
+                                       DIME_STD::memory_order_acq_rel,
+                                       DIME_STD::memory_order_relaxed);
+    }
+}
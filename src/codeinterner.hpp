@@ -0,0 +1,143 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_CODEINTERNER_HPP
+#define DIME_CODEINTERNER_HPP
+
+#include "config.hpp"
+#include "code.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef DIME_USE_WEOS
+#include <weos/atomic.hpp>
+#include <weos/memory.hpp>
+#else
+#include <atomic>
+#include <memory>
+#endif // DIME_USE_WEOS
+
+
+namespace dime
+{
+
+//! \brief Maps codes to dense identifiers.
+//!
+//! The interner assigns the identifiers 0, 1, 2, ... to codes in the order
+//! in which they are seen first. Thus, tables which are keyed by codes can
+//! be flat arrays indexed by the identifier. With a capacity of at most
+//! 65536 codes, an identifier fits into 16 bits.
+//!
+//! The codes are kept in an open-addressing hash table with a fixed number
+//! of slots. Interning and lookups are thread-safe and lock-free. A slot is
+//! claimed by writing the words of the code with atomic operations and the
+//! identifier is assigned afterwards. A thread, which interns a code whose
+//! insertion is in progress in another thread, completes the insertion
+//! instead of waiting for the other thread. A lookup treats an insertion in
+//! progress as not having happened yet.
+class CodeInterner
+{
+public:
+    //! The identifier which is returned, if a code is not known.
+    static constexpr std::uint32_t invalidId = ~std::uint32_t(0);
+
+    //! \brief Creates an interner for up to \p capacity codes.
+    //!
+    //! Throws \p std::bad_alloc, if the capacity exceeds 2^30 codes.
+    explicit
+    CodeInterner(std::size_t capacity);
+
+    CodeInterner(const CodeInterner&) = delete;
+    CodeInterner& operator=(const CodeInterner&) = delete;
+
+    //! \brief Interns a code.
+    //!
+    //! Returns the identifier of the \p code. If the code is new, it is
+    //! assigned the next free identifier. Returns \p invalidId, if the code
+    //! is new but the interner is full.
+    std::uint32_t intern(const Code& code) noexcept;
+
+    //! \brief Looks up a code.
+    //!
+    //! Returns the identifier of the \p code or \p invalidId, if the code has
+    //! not been interned.
+    std::uint32_t find(const Code& code) const noexcept;
+
+    //! \brief Returns the code of an identifier.
+    //!
+    //! Stores the code with the \p id in \p code and returns \p true. Returns
+    //! \p false, if the \p id is not smaller than size() and no other thread
+    //! is assigning it.
+    bool code(std::uint32_t id, Code& code) const noexcept;
+
+    //! \brief Returns the number of assigned identifiers.
+    std::size_t size() const noexcept
+    {
+        return m_size.load(DIME_STD::memory_order_acquire);
+    }
+
+    //! \brief Returns the maximum number of codes.
+    std::size_t capacity() const noexcept
+    {
+        return m_capacity;
+    }
+
+private:
+    struct Slot
+    {
+        //! The words of the code with the bit \p usedWord of the
+        //! implementation set or zero, if the word has not been written.
+        DIME_STD::atomic<std::uint64_t> words[2];
+        //! The identifier of the code or \p invalidId, if it has not been
+        //! assigned.
+        DIME_STD::atomic<std::uint32_t> id;
+    };
+
+    //! The maximum number of codes.
+    std::size_t m_capacity;
+    //! The number of slots minus one. The number of slots is a power of two
+    //! and at least twice the capacity.
+    std::size_t m_slotMask;
+    //! The hash table.
+    DIME_STD::unique_ptr<Slot[]> m_slots;
+    //! The slot of every identifier.
+    DIME_STD::unique_ptr<DIME_STD::atomic<Slot*>[]> m_idSlots;
+    //! The number of slots which have been reserved for new codes.
+    DIME_STD::atomic<std::uint32_t> m_numReserved;
+    //! The number of assigned identifiers.
+    DIME_STD::atomic<std::uint32_t> m_size;
+
+    //! Assigns the next identifier to the \p slot, unless it has one, and
+    //! returns the identifier of the slot.
+    std::uint32_t assignId(Slot& slot) noexcept;
+};
+
+} // namespace dime
+
+#endif // DIME_CODEINTERNER_HPP
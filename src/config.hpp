@@ -39,4 +39,38 @@
 
 #endif // DIME_USE_WEOS
 
+//! The size of a cache line in bytes. Diagnostics are placed in blocks which
+//! are aligned to and padded to a multiple of this size.
+#ifndef DIME_CACHE_LINE_SIZE
+#define DIME_CACHE_LINE_SIZE   64
+#endif // DIME_CACHE_LINE_SIZE
+
+//! The number of bits of a DiagnosticHandle which select a slot in a
+//! DiagnosticPool. The remaining bits hold the generation of the slot.
+#ifndef DIME_HANDLE_INDEX_BITS
+#define DIME_HANDLE_INDEX_BITS   22
+#endif // DIME_HANDLE_INDEX_BITS
+
+//! The maximum number of segments (literal text and arguments) of the
+//! explanation of a descriptor.
+#ifndef DIME_MAX_EXPLANATION_SEGMENTS
+#define DIME_MAX_EXPLANATION_SEGMENTS   16
+#endif // DIME_MAX_EXPLANATION_SEGMENTS
+
+//! The number of slots of the table in which an Engine tracks recent
+//! diagnostics to coalesce their repeats. Must be a power of two.
+#ifndef DIME_COALESCING_SLOTS
+#define DIME_COALESCING_SLOTS   64
+#endif // DIME_COALESCING_SLOTS
+
+//! If non-zero, codes are converted from and to text with SSSE3
+//! instructions. By default, they are used if the compiler targets SSSE3.
+#ifndef DIME_USE_SSSE3
+#ifdef __SSSE3__
+#define DIME_USE_SSSE3   1
+#else
+#define DIME_USE_SSSE3   0
+#endif // __SSSE3__
+#endif // DIME_USE_SSSE3
+
 #endif // DIME_CONFIG_HPP
@@ -30,25 +30,74 @@
 #define DIME_DESCRIPTOR_HPP
 
 #include "code.hpp"
+#include "explanation.hpp"
+
+#include <cstdint>
 
 
 namespace dime
 {
 
+//! \brief The severity of a diagnostic.
+//!
+//! The levels are ordered from the least to the most severe one. An Engine
+//! drops diagnostics whose severity is below its threshold.
+enum class Severity : std::uint8_t
+{
+    Trace,
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Critical
+};
+
 template <typename TSignature>
 class Descriptor;
 
+//! \brief Describes a diagnostic and its arguments.
+//!
+//! The \p explanation may contain placeholders for the arguments (see
+//! Explanation). It is checked against \p TArguments and split into
+//! segments. If the descriptor is \p constexpr, an invalid code or
+//! explanation is a compilation error. Otherwise, IdentifierTooLongOrWrongChar
+//! or InvalidExplanationFormat is thrown. The \p severity defaults to
+//! Severity::Info.
 template <typename... TArguments>
 class Descriptor<void(TArguments...)>
 {
 public:
     constexpr
-    Descriptor(const char* code, const char* /*explanation*/)
-        : m_code(makeCode(code))
+    Descriptor(const char* code, const char* explanation,
+               Severity severity = Severity::Info)
+        : m_code(makeCode(code)),
+          m_explanation(dime_detail::parseExplanation<TArguments...>(explanation)),
+          m_severity(severity)
+    {
+    }
+
+    //! \brief Returns the severity.
+    constexpr
+    Severity severity() const noexcept
+    {
+        return m_severity;
+    }
+
+    //! \brief Checks if the code of the descriptor is short.
+    //!
+    //! A short code has at most 10 characters and is stored, compared and
+    //! hashed as a single word (see Code::isShort()). As the check is
+    //! \p constexpr, it can be used to assert the length of a code at
+    //! compile-time.
+    constexpr
+    bool hasShortCode() const noexcept
     {
+        return m_code.isShort();
     }
 
     Code m_code;
+    Explanation m_explanation;
+    Severity m_severity;
 };
 
 } // namespace dime
@@ -29,6 +29,7 @@
 #ifndef DIME_DIAGNOSTIC_HPP
 #define DIME_DIAGNOSTIC_HPP
 
+#include "config.hpp"
 #include "allocator.hpp"
 #include "argument.hpp"
 #include "code.hpp"
@@ -39,6 +40,12 @@
 #include <tuple>
 #include <utility>
 
+#ifdef DIME_USE_WEOS
+#include <weos/atomic.hpp>
+#else
+#include <atomic>
+#endif // DIME_USE_WEOS
+
 
 namespace dime
 {
@@ -48,11 +55,12 @@ using UniqueId = std::uint32_t;
 namespace dime_detail
 {
 
+//! Returns the next unique ID. The IDs wrap around after 2^32 diagnostics.
 inline
 UniqueId createUniqueId()
 {
-    // TODO
-    return UniqueId();
+    static DIME_STD::atomic<UniqueId> nextId(0);
+    return nextId.fetch_add(1, DIME_STD::memory_order_relaxed);
 }
 
 } // namespace dime_detail
@@ -67,11 +75,20 @@ constexpr non_droppable_t non_droppable = non_droppable_t();
 //! - a unique ID,
 //! - a time stamp,
 //! - a variable number of arguments.
+//!
+//! The diagnostic and its arguments are placed in a single block, which is
+//! aligned to and padded to a multiple of a cache line. On 64-bit platforms,
+//! the header takes 48 bytes, such that a diagnostic with a single small
+//! argument fits into one 64 byte cache line and every further line holds
+//! four arguments.
 class alignas(Argument) Diagnostic
 {
 public:
     using TimePoint = std::chrono::high_resolution_clock::time_point;
 
+    //! The maximum sampling weight.
+    static constexpr std::uint32_t maxSamplingWeight = (std::uint32_t(1) << 23) - 1;
+
 
     Diagnostic(const Diagnostic&) = delete;
     const Diagnostic& operator=(const Diagnostic&) = delete;
@@ -98,7 +115,32 @@ public:
     }
 
     //! \brief Returns the unique ID.
-    UniqueId uniqueId() const noexcept;
+    UniqueId uniqueId() const noexcept
+    {
+        return m_uniqueId;
+    }
+
+    //! \brief Returns the number of merged repeats.
+    //!
+    //! If the Engine coalesces repeats of a diagnostic, it publishes a
+    //! summary after the first instance. The summary has the unique ID of
+    //! the first instance, the time stamp of the last repeat and the number
+    //! of repeats which have been merged into it. Otherwise, the number of
+    //! repeats is zero.
+    std::uint32_t numRepeats() const noexcept
+    {
+        return m_numRepeats;
+    }
+
+    //! \brief Returns the sampling weight.
+    //!
+    //! If the Engine samples the diagnostics of a code, a published
+    //! diagnostic stands for this number of diagnostics on average. The
+    //! weight of a diagnostic which has not been sampled is one.
+    std::uint32_t samplingWeight() const noexcept
+    {
+        return m_samplingWeight;
+    }
 
     //! \brief Returns the number of arguments.
     //!
@@ -117,10 +159,39 @@ public:
         return reinterpret_cast<Argument*>(this + 1);
     }
 
+    //! \brief Returns the \p index-th argument.
+    const Argument* arguments() const noexcept
+    {
+        return reinterpret_cast<const Argument*>(this + 1);
+    }
+
 //    Argument& argument(unsigned idx) noexcept
 //    {
 //    }
 
+    //! \brief Adds a reference to the diagnostic.
+    void acquire() noexcept
+    {
+        m_referenceCount.fetch_add(1, DIME_STD::memory_order_relaxed);
+    }
+
+    //! \brief Removes a reference from the diagnostic.
+    //!
+    //! Returns \p true, if the last reference has been removed. The caller is
+    //! responsible to destroy the diagnostic in this case.
+    bool release() noexcept
+    {
+        return m_referenceCount.fetch_sub(1, DIME_STD::memory_order_acq_rel) == 1;
+    }
+
+    //! \brief Returns the size of the block for a diagnostic.
+    //!
+    //! Returns the size of the memory block, which holds a diagnostic with
+    //! \p numArguments arguments. The size is a multiple of the cache line
+    //! size.
+    static constexpr
+    std::size_t blockSize(std::size_t numArguments) noexcept;
+
     template <typename... TArguments>
     static
     Diagnostic* create(Allocator& allocator,
@@ -139,15 +210,20 @@ private:
     Code m_code;
     //! The time point when the diagnostic was created.
     TimePoint m_timeStamp;
+    //! The next diagnostic in an intrusive list.
+    Diagnostic* m_next;
     //! The unique id.
     UniqueId m_uniqueId;
+    //! The number of references to this diagnostic.
+    DIME_STD::atomic<std::uint32_t> m_referenceCount;
+    //! The number of repeats which have been merged into this diagnostic.
+    std::uint32_t m_numRepeats;
     //! The number of arguments which are stored alongside this diagnostic.
-    unsigned m_numArguments : 31;
+    unsigned m_numArguments : 8;
     //! If set, the diagnostic can be dropped.
     unsigned m_droppable : 1;
-
-    /*std::atomic_int m_referenceCount;
-    Diagnostic* m_next;*/
+    //! The number of diagnostics for which this one stands.
+    unsigned m_samplingWeight : 23;
 
 
     template <typename... TArguments>
@@ -176,17 +252,40 @@ private:
     {
         return reinterpret_cast<Argument*>(this + 1);
     }
+
+    friend class DiagnosticList;
+    friend class Engine;
+    friend class DiagnosticStack;
+    friend class DiagnosticQueue;
 };
 
+constexpr
+std::size_t Diagnostic::blockSize(std::size_t numArguments) noexcept
+{
+    return (sizeof(Diagnostic) + numArguments * sizeof(Argument)
+            + DIME_CACHE_LINE_SIZE - 1) / DIME_CACHE_LINE_SIZE * DIME_CACHE_LINE_SIZE;
+}
+
+//! The number of arguments which fit into the cache line of the header.
+constexpr std::size_t inlineArguments
+        = sizeof(Diagnostic) < DIME_CACHE_LINE_SIZE
+          ? (DIME_CACHE_LINE_SIZE - sizeof(Diagnostic)) / sizeof(Argument)
+          : 0;
+
 template <typename... TArguments>
 Diagnostic::Diagnostic(const Descriptor<void(TArguments...)>& desc,
                        TArguments&&... arguments)
     : m_code(desc.m_code),
       m_timeStamp(std::chrono::high_resolution_clock::now()),
+      m_next(nullptr),
       m_uniqueId(dime_detail::createUniqueId()),
+      m_referenceCount(1),
+      m_numRepeats(0),
       m_numArguments(sizeof...(arguments)),
-      m_droppable(true)
+      m_droppable(true),
+      m_samplingWeight(1)
 {
+    static_assert(sizeof...(TArguments) <= 255, "Too many arguments");
     initArguments(std::forward_as_tuple(std::forward<TArguments>(arguments)...),
                   std::make_index_sequence<sizeof...(arguments)>());
 }
@@ -196,10 +295,7 @@ Diagnostic* Diagnostic::create(Allocator& allocator,
                                const Descriptor<void(TArguments...)>& descriptor,
                                TArguments&&... arguments)
 {
-    auto size = sizeof(Diagnostic);
-    size += sizeof...(TArguments) * sizeof(Argument);
-
-    void* mem = allocator.allocate(size);
+    void* mem = allocator.allocate(blockSize(sizeof...(TArguments)));
     return new (mem) Diagnostic(descriptor, std::forward<TArguments>(arguments)...);
 }
 
@@ -209,10 +305,7 @@ Diagnostic* Diagnostic::create(non_droppable_t,
                                const Descriptor<void(TArguments...)>& descriptor,
                                TArguments&&... arguments)
 {
-    auto size = sizeof(Diagnostic);
-    size += sizeof...(TArguments) * sizeof(Argument);
-
-    void* mem = allocator.allocate(size);
+    void* mem = allocator.allocate(blockSize(sizeof...(TArguments)));
     auto diag = new (mem) Diagnostic(descriptor, std::forward<TArguments>(arguments)...);
     diag->m_droppable = false;
     return diag;
@@ -0,0 +1,305 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_DIAGNOSTICLIST_HPP
+#define DIME_DIAGNOSTICLIST_HPP
+
+#include "config.hpp"
+#include "diagnostic.hpp"
+
+#ifdef DIME_USE_WEOS
+#include <weos/atomic.hpp>
+#else
+#include <atomic>
+#endif // DIME_USE_WEOS
+
+
+namespace dime
+{
+
+//! \brief An intrusive FIFO list of diagnostics.
+//!
+//! The list links the diagnostics through their \p m_next member, so no
+//! memory is allocated when a diagnostic is added. A diagnostic can be
+//! in at most one list at a time. The list is not thread-safe.
+class DiagnosticList
+{
+public:
+    DiagnosticList() noexcept
+        : m_head(nullptr),
+          m_tail(nullptr)
+    {
+    }
+
+    DiagnosticList(const DiagnosticList&) = delete;
+    DiagnosticList& operator=(const DiagnosticList&) = delete;
+
+    DiagnosticList(DiagnosticList&& other) noexcept
+        : m_head(other.m_head),
+          m_tail(other.m_tail)
+    {
+        other.m_head = other.m_tail = nullptr;
+    }
+
+    DiagnosticList& operator=(DiagnosticList&& other) noexcept
+    {
+        m_head = other.m_head;
+        m_tail = other.m_tail;
+        other.m_head = other.m_tail = nullptr;
+        return *this;
+    }
+
+    //! \brief Checks if the list is empty.
+    bool empty() const noexcept
+    {
+        return m_head == nullptr;
+    }
+
+    //! \brief Returns the first diagnostic or a null pointer.
+    Diagnostic* front() const noexcept
+    {
+        return m_head;
+    }
+
+    //! \brief Returns the diagnostic which follows \p diagnostic.
+    static
+    Diagnostic* next(const Diagnostic* diagnostic) noexcept
+    {
+        return diagnostic->m_next;
+    }
+
+    //! \brief Appends a \p diagnostic to the end of the list.
+    void pushBack(Diagnostic* diagnostic) noexcept
+    {
+        diagnostic->m_next = nullptr;
+        if (m_tail)
+            m_tail->m_next = diagnostic;
+        else
+            m_head = diagnostic;
+        m_tail = diagnostic;
+    }
+
+    //! \brief Removes the first diagnostic.
+    //!
+    //! Removes the first diagnostic from the list and returns it. Returns
+    //! a null pointer, if the list is empty.
+    Diagnostic* popFront() noexcept
+    {
+        Diagnostic* diagnostic = m_head;
+        if (diagnostic)
+        {
+            m_head = diagnostic->m_next;
+            if (!m_head)
+                m_tail = nullptr;
+            diagnostic->m_next = nullptr;
+        }
+        return diagnostic;
+    }
+
+    //! \brief Moves all diagnostics from \p other to the end of this list.
+    void splice(DiagnosticList&& other) noexcept
+    {
+        if (other.empty())
+            return;
+        if (m_tail)
+            m_tail->m_next = other.m_head;
+        else
+            m_head = other.m_head;
+        m_tail = other.m_tail;
+        other.m_head = other.m_tail = nullptr;
+    }
+
+private:
+    Diagnostic* m_head;
+    Diagnostic* m_tail;
+
+    friend class DiagnosticStack;
+    friend class DiagnosticQueue;
+};
+
+//! \brief An intrusive lock-free LIFO stack of diagnostics.
+//!
+//! Any number of threads may push diagnostics. Removing diagnostics, i.e.
+//! popping a single one or taking all of them at once, is restricted to
+//! one consumer thread. As no other thread can remove and push back the
+//! top of the stack while pop() reads its successor, this rules out the
+//! ABA problem without tagging the head.
+class DiagnosticStack
+{
+public:
+    DiagnosticStack() noexcept
+        : m_head(nullptr)
+    {
+    }
+
+    DiagnosticStack(const DiagnosticStack&) = delete;
+    DiagnosticStack& operator=(const DiagnosticStack&) = delete;
+
+    //! \brief Checks if the stack is empty.
+    bool empty() const noexcept
+    {
+        return m_head.load(DIME_STD::memory_order_relaxed) == nullptr;
+    }
+
+    //! \brief Pushes a \p diagnostic onto the stack.
+    void push(Diagnostic* diagnostic) noexcept
+    {
+        pushChain(diagnostic, diagnostic);
+    }
+
+    //! \brief Pushes all diagnostics of a \p list onto the stack.
+    //!
+    //! The whole list is pushed with a single atomic operation. The front
+    //! of the list becomes the top of the stack.
+    void push(DiagnosticList&& list) noexcept
+    {
+        if (list.empty())
+            return;
+        pushChain(list.m_head, list.m_tail);
+        list.m_head = list.m_tail = nullptr;
+    }
+
+    //! \brief Pops a diagnostic from the stack.
+    //!
+    //! Returns the diagnostic which has been pushed last or a null pointer,
+    //! if the stack is empty. Only the consumer thread may call this
+    //! function.
+    Diagnostic* pop() noexcept
+    {
+        Diagnostic* head = m_head.load(DIME_STD::memory_order_acquire);
+        while (head && !m_head.compare_exchange_weak(head, head->m_next,
+                                                     DIME_STD::memory_order_acquire,
+                                                     DIME_STD::memory_order_acquire))
+        {
+        }
+        if (head)
+            head->m_next = nullptr;
+        return head;
+    }
+
+    //! \brief Takes all diagnostics from the stack.
+    //!
+    //! Returns the diagnostics in LIFO order, i.e. the diagnostic which has
+    //! been pushed last is the front of the returned list. Only the
+    //! consumer thread may call this function.
+    DiagnosticList takeAll() noexcept
+    {
+        DiagnosticList list;
+        list.m_head = m_head.exchange(nullptr, DIME_STD::memory_order_acquire);
+        for (list.m_tail = list.m_head; list.m_tail && list.m_tail->m_next; )
+            list.m_tail = list.m_tail->m_next;
+        return list;
+    }
+
+private:
+    DIME_STD::atomic<Diagnostic*> m_head;
+
+
+    void pushChain(Diagnostic* first, Diagnostic* last) noexcept
+    {
+        Diagnostic* head = m_head.load(DIME_STD::memory_order_relaxed);
+        do
+        {
+            last->m_next = head;
+        } while (!m_head.compare_exchange_weak(head, first,
+                                               DIME_STD::memory_order_release,
+                                               DIME_STD::memory_order_relaxed));
+    }
+
+    friend class DiagnosticQueue;
+};
+
+//! \brief An intrusive multi-producer single-consumer FIFO queue.
+//!
+//! Producers push diagnostics onto a lock-free stack. The consumer takes
+//! the whole stack at once whenever its private list runs empty and
+//! reverses it into FIFO order. Thus, pushing never allocates memory and
+//! the consumer touches the shared head only once per batch.
+class DiagnosticQueue
+{
+public:
+    DiagnosticQueue() = default;
+
+    DiagnosticQueue(const DiagnosticQueue&) = delete;
+    DiagnosticQueue& operator=(const DiagnosticQueue&) = delete;
+
+    //! \brief Enqueues a \p diagnostic.
+    //!
+    //! This function may be called from any thread.
+    void push(Diagnostic* diagnostic) noexcept
+    {
+        m_incoming.push(diagnostic);
+    }
+
+    //! \brief Dequeues a diagnostic.
+    //!
+    //! Returns the oldest diagnostic or a null pointer, if the queue is
+    //! empty. Only the consumer thread may call this function.
+    Diagnostic* pop() noexcept
+    {
+        if (m_outgoing.empty())
+            refill();
+        return m_outgoing.popFront();
+    }
+
+    //! \brief Dequeues all diagnostics.
+    //!
+    //! Returns all diagnostics in FIFO order. Only the consumer thread may
+    //! call this function.
+    DiagnosticList takeAll() noexcept
+    {
+        refill();
+        return DIME_STD::move(m_outgoing);
+    }
+
+private:
+    //! The diagnostics pushed by the producers in LIFO order.
+    DiagnosticStack m_incoming;
+    //! The diagnostics owned by the consumer in FIFO order.
+    DiagnosticList m_outgoing;
+
+
+    void refill() noexcept
+    {
+        Diagnostic* iter = m_incoming.m_head.exchange(nullptr, DIME_STD::memory_order_acquire);
+        DiagnosticList batch;
+        batch.m_tail = iter;
+        while (iter)
+        {
+            Diagnostic* next = iter->m_next;
+            iter->m_next = batch.m_head;
+            batch.m_head = iter;
+            iter = next;
+        }
+        m_outgoing.splice(DIME_STD::move(batch));
+    }
+};
+
+} // namespace dime
+
+#endif // DIME_DIAGNOSTICLIST_HPP
@@ -0,0 +1,131 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "diagnosticpool.hpp"
+
+#include <new>
+
+using namespace dime;
+
+namespace
+{
+
+//! Marks the end of the free list.
+constexpr std::uint32_t endOfList = ~std::uint32_t(0);
+
+} // anonymous namespace
+
+
+DiagnosticPool::DiagnosticPool(std::size_t numSlots, std::size_t slotSize)
+    : m_memory(nullptr),
+      m_slotSize((slotSize + DIME_CACHE_LINE_SIZE - 1)
+                 / DIME_CACHE_LINE_SIZE * DIME_CACHE_LINE_SIZE),
+      m_numSlots(numSlots),
+      m_slots(new Slot[numSlots]),
+      m_freeList(numSlots != 0 ? 0 : endOfList)
+{
+    if (numSlots > DiagnosticHandle::indexMask + std::size_t(1))
+        throw std::bad_alloc();
+
+    m_memory = static_cast<char*>(Allocator::allocate(m_numSlots * m_slotSize));
+    for (std::size_t idx = 0; idx < m_numSlots; ++idx)
+    {
+        m_slots[idx].generation = 1;
+        m_slots[idx].next = idx + 1 < m_numSlots ? std::uint32_t(idx + 1)
+                                                 : endOfList;
+    }
+}
+
+DiagnosticPool::~DiagnosticPool()
+{
+    Allocator::deallocate(m_memory);
+}
+
+void* DiagnosticPool::allocate(std::size_t size)
+{
+    if (size > m_slotSize)
+        throw std::bad_alloc();
+
+    std::uint64_t head = m_freeList.load(DIME_STD::memory_order_acquire);
+    while (true)
+    {
+        std::uint32_t index = std::uint32_t(head);
+        if (index == endOfList)
+            throw std::bad_alloc();
+
+        std::uint64_t tag = (head >> 32) + 1;
+        std::uint32_t next = m_slots[index].next.load(DIME_STD::memory_order_relaxed);
+        if (m_freeList.compare_exchange_weak(head, (tag << 32) | next,
+                                             DIME_STD::memory_order_acquire,
+                                             DIME_STD::memory_order_acquire))
+        {
+            return m_memory + index * m_slotSize;
+        }
+    }
+}
+
+void DiagnosticPool::deallocate(void* p) noexcept
+{
+    std::uint32_t index = indexOf(p);
+
+    // Invalidate all outstanding handles. The generation zero is skipped
+    // such that the null handle never refers to a slot.
+    Slot& slot = m_slots[index];
+    std::uint32_t generation = (slot.generation.load(DIME_STD::memory_order_relaxed) + 1)
+                               & DiagnosticHandle::generationMask;
+    slot.generation.store(generation != 0 ? generation : 1,
+                          DIME_STD::memory_order_release);
+
+    std::uint64_t head = m_freeList.load(DIME_STD::memory_order_relaxed);
+    do
+    {
+        slot.next.store(std::uint32_t(head), DIME_STD::memory_order_relaxed);
+    } while (!m_freeList.compare_exchange_weak(
+                 head, (head & ~std::uint64_t(0xFFFFFFFF)) | index,
+                 DIME_STD::memory_order_release,
+                 DIME_STD::memory_order_relaxed));
+}
+
+DiagnosticHandle DiagnosticPool::handle(const Diagnostic* diagnostic) const noexcept
+{
+    std::uint32_t index = indexOf(diagnostic);
+    return DiagnosticHandle(
+                index, m_slots[index].generation.load(DIME_STD::memory_order_acquire));
+}
+
+Diagnostic* DiagnosticPool::resolve(DiagnosticHandle handle) const noexcept
+{
+    std::uint32_t index = handle.index();
+    if (!handle || index >= m_numSlots
+        || m_slots[index].generation.load(DIME_STD::memory_order_acquire)
+           != handle.generation())
+    {
+        return nullptr;
+    }
+    return reinterpret_cast<Diagnostic*>(m_memory + index * m_slotSize);
+}
@@ -0,0 +1,219 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_DIAGNOSTICPOOL_HPP
+#define DIME_DIAGNOSTICPOOL_HPP
+
+#include "config.hpp"
+#include "allocator.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef DIME_USE_WEOS
+#include <weos/atomic.hpp>
+#include <weos/memory.hpp>
+#else
+#include <atomic>
+#include <memory>
+#endif // DIME_USE_WEOS
+
+
+namespace dime
+{
+class Diagnostic;
+
+//! \brief A 32-bit reference to a diagnostic in a DiagnosticPool.
+//!
+//! A handle consists of the index of a slot in the pool and the generation
+//! of the slot. The generation changes whenever a diagnostic is returned
+//! to the pool, which allows to detect stale handles. The handle with the
+//! value zero is never valid.
+class DiagnosticHandle
+{
+public:
+    static constexpr unsigned indexBits = DIME_HANDLE_INDEX_BITS;
+    static constexpr std::uint32_t indexMask = (std::uint32_t(1) << indexBits) - 1;
+    static constexpr std::uint32_t generationMask = ~std::uint32_t(0) >> indexBits;
+
+    static_assert(indexBits > 0 && indexBits < 32, "Invalid number of index bits");
+
+    //! \brief Creates a null handle.
+    constexpr
+    DiagnosticHandle() noexcept
+        : m_value(0)
+    {
+    }
+
+    //! \brief Creates a handle from its raw \p value.
+    constexpr explicit
+    DiagnosticHandle(std::uint32_t value) noexcept
+        : m_value(value)
+    {
+    }
+
+    //! \brief Creates a handle from a slot \p index and a \p generation.
+    constexpr
+    DiagnosticHandle(std::uint32_t index, std::uint32_t generation) noexcept
+        : m_value((generation << indexBits) | (index & indexMask))
+    {
+    }
+
+    //! \brief Returns the raw value of the handle.
+    constexpr
+    std::uint32_t value() const noexcept
+    {
+        return m_value;
+    }
+
+    //! \brief Returns the index of the slot.
+    constexpr
+    std::uint32_t index() const noexcept
+    {
+        return m_value & indexMask;
+    }
+
+    //! \brief Returns the generation of the slot.
+    constexpr
+    std::uint32_t generation() const noexcept
+    {
+        return m_value >> indexBits;
+    }
+
+    //! \brief Checks if the handle is not null.
+    constexpr explicit
+    operator bool() const noexcept
+    {
+        return m_value != 0;
+    }
+
+    constexpr
+    bool operator==(DiagnosticHandle other) const noexcept
+    {
+        return m_value == other.m_value;
+    }
+
+    constexpr
+    bool operator!=(DiagnosticHandle other) const noexcept
+    {
+        return m_value != other.m_value;
+    }
+
+private:
+    std::uint32_t m_value;
+};
+
+//! \brief An indexed pool of diagnostics.
+//!
+//! The pool manages a fixed number of equally sized slots in a contiguous
+//! memory block. Every slot is aligned to a cache line. Diagnostics which
+//! are created in the pool can be referred to by a 32-bit DiagnosticHandle
+//! instead of a pointer. Allocation and deallocation are lock-free.
+class DiagnosticPool : public Allocator
+{
+public:
+    //! \brief Creates a pool.
+    //!
+    //! Creates a pool with \p numSlots slots of \p slotSize bytes. The slot
+    //! size is rounded up to a multiple of the cache line size.
+    explicit
+    DiagnosticPool(std::size_t numSlots,
+                   std::size_t slotSize = DIME_CACHE_LINE_SIZE);
+
+    virtual
+    ~DiagnosticPool();
+
+    DiagnosticPool(const DiagnosticPool&) = delete;
+    DiagnosticPool& operator=(const DiagnosticPool&) = delete;
+
+    //! \brief Allocates a slot.
+    //!
+    //! Throws \p std::bad_alloc, if \p size exceeds the slot size or if
+    //! all slots are in use.
+    virtual
+    void* allocate(std::size_t size) override;
+
+    //! \brief Returns a slot to the pool.
+    //!
+    //! All handles which refer to the slot become stale.
+    virtual
+    void deallocate(void* p) noexcept override;
+
+    //! \brief Returns the handle of a \p diagnostic in this pool.
+    DiagnosticHandle handle(const Diagnostic* diagnostic) const noexcept;
+
+    //! \brief Resolves a handle.
+    //!
+    //! Returns the diagnostic to which \p handle refers or a null pointer,
+    //! if the handle is stale.
+    Diagnostic* resolve(DiagnosticHandle handle) const noexcept;
+
+    //! \brief Returns the number of slots.
+    std::size_t numSlots() const noexcept
+    {
+        return m_numSlots;
+    }
+
+    //! \brief Returns the size of a slot in bytes.
+    std::size_t slotSize() const noexcept
+    {
+        return m_slotSize;
+    }
+
+private:
+    struct Slot
+    {
+        //! The generation of the slot. It is never zero.
+        DIME_STD::atomic<std::uint32_t> generation;
+        //! The index of the next free slot.
+        DIME_STD::atomic<std::uint32_t> next;
+    };
+
+    //! The memory of all slots.
+    char* m_memory;
+    //! The size of a single slot.
+    std::size_t m_slotSize;
+    //! The number of slots.
+    std::size_t m_numSlots;
+    //! The generation and free-list link of every slot.
+    DIME_STD::unique_ptr<Slot[]> m_slots;
+    //! The head of the free list. The lower 32 bits are the index of the
+    //! first free slot, the upper 32 bits are a tag which is incremented
+    //! with every pop to avoid the ABA problem.
+    DIME_STD::atomic<std::uint64_t> m_freeList;
+
+
+    std::uint32_t indexOf(const void* p) const noexcept
+    {
+        return std::uint32_t((static_cast<const char*>(p) - m_memory) / m_slotSize);
+    }
+};
+
+} // namespace dime
+
+#endif // DIME_DIAGNOSTICPOOL_HPP
@@ -27,16 +27,234 @@
 *******************************************************************************/
 
 #include "engine.hpp"
+#include "registry.hpp"
 #include "subscriber.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
 using namespace dime;
 
+namespace
+{
+
+//! Returns the mask of the first \p length symbols of a code.
+Code prefixMask(std::size_t length) noexcept
+{
+    auto wordMask = [](std::size_t numSymbols) {
+        return numSymbols >= 10 ? (std::uint64_t(1) << 60) - 1
+                                : (std::uint64_t(1) << (numSymbols * 6)) - 1;
+    };
+    return Code{wordMask(length), wordMask(length > 10 ? length - 10 : 0)};
+}
+
+//! Returns the current time of the rate limits in ns.
+std::int64_t now() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//! Returns the time stamp of a \p diagnostic in ns.
+std::int64_t timeStampOf(const Diagnostic& diagnostic) noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                diagnostic.timeStamp().time_since_epoch()).count();
+}
+
+//! Hashes \p size bytes at \p data into the \p hash.
+std::uint64_t hashBytes(std::uint64_t hash, const void* data, std::size_t size) noexcept
+{
+    const unsigned char* iter = static_cast<const unsigned char*>(data);
+    for (; size >= 8; size -= 8, iter += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, iter, 8);
+        hash = dime_detail::mixBits(hash ^ word);
+    }
+    std::uint64_t word = size;
+    for (std::size_t idx = 0; idx < size; ++idx)
+        word |= std::uint64_t(iter[idx]) << (8 * idx + 8);
+    return dime_detail::mixBits(hash ^ word);
+}
+
+//! Hashes the code and the arguments of a \p diagnostic. The result is
+//! never zero.
+std::uint64_t hashDiagnostic(const Diagnostic& diagnostic) noexcept
+{
+    std::uint64_t hash = dime_detail::hashCode(diagnostic.code());
+    for (unsigned idx = 0; idx < diagnostic.numArguments(); ++idx)
+    {
+        const Argument& argument = diagnostic.arguments()[idx];
+        hash = dime_detail::mixBits(hash + unsigned(argument.kind()) + 1);
+        switch (argument.kind())
+        {
+        case ArgumentKind::SignedInteger:
+        {
+            int value = argument.toInteger().value();
+            hash = hashBytes(hash, &value, sizeof(value));
+            break;
+        }
+        case ArgumentKind::UnsignedInteger:
+        {
+            unsigned value = argument.toUnsigned().value();
+            hash = hashBytes(hash, &value, sizeof(value));
+            break;
+        }
+        case ArgumentKind::Float:
+        {
+            float value = argument.toFloat().value();
+            hash = hashBytes(hash, &value, sizeof(value));
+            break;
+        }
+        case ArgumentKind::Double:
+        {
+            double value = argument.toDouble().value();
+            hash = hashBytes(hash, &value, sizeof(value));
+            break;
+        }
+        case ArgumentKind::LongDouble:
+        {
+            long double value = argument.toLongDouble().value();
+            hash = hashBytes(hash, &value, dime_detail::longDoubleSize);
+            break;
+        }
+        case ArgumentKind::String:
+        {
+            const char* value = argument.toString().value();
+            hash = hashBytes(hash, value, std::strlen(value));
+            break;
+        }
+        }
+    }
+    return hash != 0 ? hash : 1;
+}
+
+//! The sampling state of a thread for a single rule.
+struct SamplingWindow
+{
+    //! The rule which owns the window. An index may be reused by another
+    //! rule after an engine has been destroyed.
+    const void* rule;
+    //! The start of the current window in ns.
+    std::int64_t start;
+    //! The number of diagnostics in the current window.
+    std::uint32_t current;
+    //! The number of diagnostics in the previous window.
+    std::uint32_t previous;
+};
+
+//! The sampling state of a thread.
+struct SamplingState
+{
+    //! The state of the xorshift generator. It is seeded on first use.
+    std::uint64_t random = 0;
+    //! The windows of the rules with a rate.
+    std::vector<SamplingWindow> windows;
+
+    //! Returns a random number in [0, 2^32).
+    std::uint32_t next() noexcept
+    {
+        if (random == 0)
+            random = dime_detail::mixBits(std::uint64_t(reinterpret_cast<std::uintptr_t>(this))
+                                          ^ std::uint64_t(now())) | 1;
+        random ^= random >> 12;
+        random ^= random << 25;
+        random ^= random >> 27;
+        return std::uint32_t((random * 0x2545F4914F6CDD1Dull) >> 32);
+    }
+};
+
+thread_local SamplingState samplingState;
+
+//! The indexes of the sampling rules in the thread-local state. They are
+//! shared by all engines, as the state is. The indexes of a destroyed
+//! engine are reused, so that the state of a thread is bounded by the
+//! number of sampled patterns of the existing engines.
+struct SamplingIndexes
+{
+    DIME_STD::mutex mutex;
+    std::size_t size = 0;
+    std::vector<std::size_t> unused;
+
+    std::size_t acquire()
+    {
+        DIME_STD::lock_guard<DIME_STD::mutex> lock(mutex);
+        if (unused.empty())
+            return size++;
+        std::size_t index = unused.back();
+        unused.pop_back();
+        return index;
+    }
+
+    void release(std::size_t index)
+    {
+        DIME_STD::lock_guard<DIME_STD::mutex> lock(mutex);
+        unused.push_back(index);
+    }
+};
+
+//! Returns the sampling indexes. They are never destroyed, because an
+//! engine with static storage duration may outlive them otherwise.
+SamplingIndexes& samplingIndexes()
+{
+    static SamplingIndexes* indexes = new SamplingIndexes;
+    return *indexes;
+}
+
+} // anonymous namespace
+
+
+Engine::Engine(Allocator& allocator)
+    : m_allocator(&allocator)
+{
+}
+
+Engine::Engine(std::size_t memorySize, const ArenaOptions& options)
+    : m_arena(new MemoryArena(memorySize, options)),
+      m_arenaAllocator(new RingAllocator(m_arena->data(), m_arena->size()))
+{
+    m_allocator = m_arenaAllocator.get();
+}
+
+Engine::~Engine()
+{
+    for (RepeatSlot& slot : m_repeats)
+        if (slot.summary)
+            release(slot.summary);
+    for (const SamplingRule& rule : m_samplingRules)
+        samplingIndexes().release(rule.index);
+}
+
+void* Engine::allocate(std::size_t size)
+{
+    return m_allocator ? m_allocator->allocate(size) : Allocator::allocate(size);
+}
+
+void Engine::deallocate(void* p) noexcept
+{
+    if (m_allocator)
+        m_allocator->deallocate(p);
+    else
+        Allocator::deallocate(p);
+}
 
 void Engine::dispatch(Diagnostic* diagnostic)
 {
     for (auto& subs : m_list)
         if (subs.matcher->matches(diagnostic->code()))
-            subs.subscriber->process(diagnostic);
+            if (subs.subscriber->process(diagnostic) == Subscriber::Action::KeepDiagnostic)
+                diagnostic->acquire();
+}
+
+void Engine::release(Diagnostic* diagnostic) noexcept
+{
+    if (diagnostic->release())
+    {
+        diagnostic->~Diagnostic();
+        deallocate(diagnostic);
+    }
 }
 
 void Engine::subscribe(const char* filterPattern, Subscriber* subscriber)
@@ -50,3 +268,406 @@ void Engine::setFallbackConsumer(Subscriber* consumer) noexcept
 {
     m_fallbackConsumer = consumer;
 }
+
+void Engine::setThreshold(Severity threshold)
+{
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    m_threshold.store(std::uint8_t(threshold), DIME_STD::memory_order_relaxed);
+    updateMinThreshold();
+}
+
+void Engine::setThreshold(const char* prefix, Severity threshold)
+{
+    Code code;
+    std::size_t length = std::strlen(prefix);
+    if (!parseCode(prefix, length, code))
+        throw IdentifierTooLongOrWrongChar();
+
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    auto iter = std::find_if(m_thresholds.begin(), m_thresholds.end(),
+                             [&](const ThresholdOverride& entry) {
+                                 return entry.length <= length;
+                             });
+    if (iter != m_thresholds.end() && iter->length == length && iter->prefix == code)
+        iter->threshold = threshold;
+    else
+        m_thresholds.insert(iter, ThresholdOverride{code, prefixMask(length),
+                                                    unsigned(length), threshold});
+    updateMinThreshold();
+}
+
+void Engine::clearPrefixThresholds()
+{
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    m_thresholds.clear();
+    updateMinThreshold();
+}
+
+bool Engine::passesPrefixThresholds(const Code& code, Severity severity) const noexcept
+{
+    for (const ThresholdOverride& entry : m_thresholds)
+        if ((code[0] & entry.mask[0]) == entry.prefix[0]
+            && (code[1] & entry.mask[1]) == entry.prefix[1])
+            return severity >= entry.threshold;
+    return std::uint8_t(severity) >= m_threshold.load(DIME_STD::memory_order_relaxed);
+}
+
+void Engine::updateMinThreshold() noexcept
+{
+    std::uint8_t threshold = m_threshold.load(DIME_STD::memory_order_relaxed);
+    for (const ThresholdOverride& entry : m_thresholds)
+        threshold = std::min(threshold, std::uint8_t(entry.threshold));
+    m_minThreshold.store(threshold, DIME_STD::memory_order_relaxed);
+    m_hasPrefixThresholds.store(!m_thresholds.empty(), DIME_STD::memory_order_relaxed);
+}
+
+bool Engine::passesThresholds(const Code& code, Severity severity)
+{
+    if (!m_hasPrefixThresholds.load(DIME_STD::memory_order_relaxed))
+        return std::uint8_t(severity) >= m_threshold.load(DIME_STD::memory_order_relaxed);
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    return passesPrefixThresholds(code, severity);
+}
+
+Engine::RateLimitRule::RateLimitRule(const char* pattern)
+    : pattern(pattern),
+      interval(0),
+      tolerance(0),
+      reportInterval(0),
+      buckets(nullptr),
+      nextReport(0),
+      numPending(0)
+{
+    // The matcher refers to the pattern, so it is compiled from the copy.
+    matcher = dime_detail::compilePattern(this->pattern.c_str());
+}
+
+void Engine::RateLimitRule::set(const RateLimit& limit, std::int64_t now)
+{
+    std::int64_t newInterval = limit.rate != 0 ? 1000000000 / std::int64_t(limit.rate) : 0;
+    interval.store(newInterval, DIME_STD::memory_order_relaxed);
+    tolerance.store(newInterval * (limit.burst != 0 ? std::int64_t(limit.burst) - 1 : 0),
+                    DIME_STD::memory_order_relaxed);
+    reportInterval.store(limit.reportInterval.count(), DIME_STD::memory_order_relaxed);
+    nextReport.store(now + limit.reportInterval.count(), DIME_STD::memory_order_relaxed);
+
+    // The buckets of a layout are kept, because other threads may still
+    // use them. A layout which has been set before is reused.
+    std::size_t maxCodes = limit.perCode ? limit.maxCodes : 0;
+    auto layout = std::find_if(layouts.begin(), layouts.end(),
+                               [&](const RateLimitBuckets& entry) {
+                                   return bool(entry.codes) == limit.perCode
+                                          && (!entry.codes
+                                              || entry.codes->capacity() == maxCodes);
+                               });
+    if (layout == layouts.end())
+    {
+        layouts.emplace_back();
+        layout = std::prev(layouts.end());
+        if (limit.perCode)
+            layout->codes.reset(new CodeInterner(maxCodes));
+        layout->fullAt.reset(new DIME_STD::atomic<std::int64_t>[maxCodes + 1]);
+    }
+    for (std::size_t idx = 0; idx <= maxCodes; ++idx)
+        layout->fullAt[idx].store(0, DIME_STD::memory_order_relaxed);
+    buckets.store(&*layout, DIME_STD::memory_order_release);
+}
+
+bool Engine::RateLimitRule::admit(const Code& code, std::int64_t now) noexcept
+{
+    std::int64_t interval = this->interval.load(DIME_STD::memory_order_relaxed);
+    std::int64_t tolerance = this->tolerance.load(DIME_STD::memory_order_relaxed);
+    if (interval == 0)
+        return false;
+
+    // The shared bucket is the last one.
+    RateLimitBuckets* layout = buckets.load(DIME_STD::memory_order_acquire);
+    std::size_t index = 0;
+    if (layout->codes)
+        index = std::min<std::size_t>(layout->codes->intern(code), layout->codes->capacity());
+    DIME_STD::atomic<std::int64_t>& bucket = layout->fullAt[index];
+
+    // The bucket is full at the time fullAt. Every token moves this time
+    // by one interval into the future. A token is available as long as
+    // fullAt does not run ahead of the current time by more than the
+    // burst allows.
+    std::int64_t full = bucket.load(DIME_STD::memory_order_relaxed);
+    while (true)
+    {
+        std::int64_t start = std::max(full, now);
+        if (start - now > tolerance)
+            return false;
+        if (bucket.compare_exchange_weak(full, start + interval,
+                                         DIME_STD::memory_order_relaxed,
+                                         DIME_STD::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+}
+
+void Engine::setRateLimit(const char* pattern, const RateLimit& limit)
+{
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+
+    // A rule is created once per pattern and updated in place afterwards.
+    // Thus, retuning a limit does not take more memory.
+    auto rule = std::find_if(m_rateLimitRules.begin(), m_rateLimitRules.end(),
+                             [&](const RateLimitRule& entry) {
+                                 return entry.pattern == pattern;
+                             });
+    if (rule == m_rateLimitRules.end())
+    {
+        m_rateLimitRules.emplace_back(pattern);
+        rule = std::prev(m_rateLimitRules.end());
+    }
+    rule->set(limit, now());
+
+    auto active = m_rateLimits.load(DIME_STD::memory_order_relaxed);
+    std::vector<RateLimitRule*> rules;
+    if (active)
+        rules = *active;
+    if (std::find(rules.begin(), rules.end(), &*rule) != rules.end())
+        return;
+    rules.push_back(&*rule);
+    setRateLimitRules(std::move(rules));
+}
+
+void Engine::clearRateLimits()
+{
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    setRateLimitRules(std::vector<RateLimitRule*>());
+}
+
+bool Engine::admit(const Code& code)
+{
+    auto rules = m_rateLimits.load(DIME_STD::memory_order_acquire);
+    if (!rules)
+        return true;
+
+    for (RateLimitRule* rule : *rules)
+    {
+        if (!rule->matcher->matches(code))
+            continue;
+
+        std::int64_t time = now();
+        bool admitted = rule->admit(code, time);
+        if (!admitted)
+        {
+            rule->numPending.fetch_add(1, DIME_STD::memory_order_relaxed);
+            m_numSuppressed.fetch_add(1, DIME_STD::memory_order_relaxed);
+        }
+
+        reportSuppressed(*rule, time);
+        return admitted;
+    }
+    return true;
+}
+
+void Engine::flushSuppressed()
+{
+    auto rules = m_rateLimits.load(DIME_STD::memory_order_acquire);
+    if (!rules)
+        return;
+
+    std::int64_t time = now();
+    for (RateLimitRule* rule : *rules)
+        reportSuppressed(*rule, time);
+}
+
+void Engine::reportSuppressed(RateLimitRule& rule, std::int64_t time)
+{
+    // Only the thread which moves the time of the next report publishes
+    // the report.
+    std::int64_t report = rule.nextReport.load(DIME_STD::memory_order_relaxed);
+    if (time >= report
+        && rule.numPending.load(DIME_STD::memory_order_relaxed) != 0
+        && rule.nextReport.compare_exchange_strong(
+                report, time + rule.reportInterval.load(DIME_STD::memory_order_relaxed),
+                DIME_STD::memory_order_relaxed))
+    {
+        std::uint64_t count = rule.numPending.exchange(0, DIME_STD::memory_order_relaxed);
+        publish(non_droppable, suppressedDiagnostics, unsigned(count),
+                static_cast<const char*>(rule.pattern.c_str()));
+    }
+}
+
+void Engine::setRateLimitRules(std::vector<RateLimitRule*> rules)
+{
+    if (rules.empty())
+    {
+        m_rateLimits.store(nullptr, DIME_STD::memory_order_release);
+        return;
+    }
+    // Sets which have been published before are reused.
+    auto set = std::find(m_rateLimitSets.begin(), m_rateLimitSets.end(), rules);
+    if (set == m_rateLimitSets.end())
+    {
+        m_rateLimitSets.push_back(std::move(rules));
+        set = std::prev(m_rateLimitSets.end());
+    }
+    m_rateLimits.store(&*set, DIME_STD::memory_order_release);
+}
+
+void Engine::setCoalescingWindow(std::chrono::nanoseconds window)
+{
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    m_coalescingWindow = window.count();
+}
+
+void Engine::flushRepeats()
+{
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    for (RepeatSlot& slot : m_repeats)
+    {
+        flushRepeats(slot);
+        slot.hash = 0;
+    }
+}
+
+bool Engine::coalesce(Diagnostic* diagnostic)
+{
+    std::uint64_t hash = hashDiagnostic(*diagnostic);
+    std::int64_t timeStamp = timeStampOf(*diagnostic);
+    RepeatSlot& slot = m_repeats[hash & (DIME_COALESCING_SLOTS - 1)];
+    if (slot.hash == hash && slot.code == diagnostic->code() && timeStamp < slot.windowEnd)
+    {
+        // The first repeat becomes the summary, which is not dispatched
+        // yet and can thus be modified. Further repeats only update it.
+        if (!slot.summary)
+        {
+            slot.summary = diagnostic;
+            diagnostic->m_uniqueId = slot.firstId;
+            diagnostic->m_numRepeats = 1;
+        }
+        else
+        {
+            ++slot.summary->m_numRepeats;
+            slot.summary->m_timeStamp = diagnostic->timeStamp();
+            release(diagnostic);
+        }
+        return true;
+    }
+
+    flushRepeats(slot);
+    slot.hash = hash;
+    slot.code = diagnostic->code();
+    slot.firstId = diagnostic->uniqueId();
+    slot.windowEnd = timeStamp + m_coalescingWindow;
+    return false;
+}
+
+void Engine::flushRepeats(RepeatSlot& slot)
+{
+    if (slot.summary)
+    {
+        Diagnostic* summary = slot.summary;
+        slot.summary = nullptr;
+        dispatch(summary);
+        release(summary);
+    }
+}
+
+Engine::SamplingRule::SamplingRule(const char* pattern, std::size_t index)
+    : pattern(pattern),
+      oneIn(1),
+      ratePerSecond(0),
+      index(index)
+{
+    // The matcher refers to the pattern, so it is compiled from the copy.
+    matcher = dime_detail::compilePattern(this->pattern.c_str());
+}
+
+void Engine::SamplingRule::set(const Sampling& sampling) noexcept
+{
+    oneIn.store(sampling.oneIn, DIME_STD::memory_order_relaxed);
+    ratePerSecond.store(sampling.ratePerSecond, DIME_STD::memory_order_relaxed);
+}
+
+bool Engine::SamplingRule::sample(std::uint32_t& weight) const noexcept
+{
+    // The number of diagnostics per published one.
+    std::uint64_t period = oneIn.load(DIME_STD::memory_order_relaxed);
+    if (period == 0)
+        period = 1;
+    std::uint64_t rate = ratePerSecond.load(DIME_STD::memory_order_relaxed);
+    if (rate != 0)
+    {
+        if (samplingState.windows.size() <= index)
+            samplingState.windows.resize(index + 1, SamplingWindow{nullptr, 0, 0, 0});
+        SamplingWindow& window = samplingState.windows[index];
+        if (window.rule != this)
+            window = SamplingWindow{this, 0, 0, 0};
+        std::int64_t time = now();
+        if (time - window.start >= 1000000000)
+        {
+            window.previous = time - window.start < 2000000000 ? window.current : 0;
+            window.current = 0;
+            window.start = time;
+        }
+        ++window.current;
+        std::uint64_t threadRate = std::max(window.previous, window.current);
+        period = (threadRate + rate / 2) / rate;
+        if (period == 0)
+            period = 1;
+    }
+
+    if (period > 1 && (std::uint64_t(samplingState.next()) * period >> 32) != 0)
+        return false;
+    weight = period < Diagnostic::maxSamplingWeight ? std::uint32_t(period)
+                                                    : Diagnostic::maxSamplingWeight;
+    return true;
+}
+
+void Engine::setSampling(const char* pattern, const Sampling& sampling)
+{
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+
+    // A rule is created once per pattern and updated in place afterwards.
+    // Thus, retuning the sampling does not take more memory.
+    auto rule = std::find_if(m_samplingRules.begin(), m_samplingRules.end(),
+                             [&](const SamplingRule& entry) {
+                                 return entry.pattern == pattern;
+                             });
+    if (rule == m_samplingRules.end())
+    {
+        m_samplingRules.emplace_back(pattern, samplingIndexes().acquire());
+        rule = std::prev(m_samplingRules.end());
+    }
+    rule->set(sampling);
+
+    auto active = m_sampling.load(DIME_STD::memory_order_relaxed);
+    std::vector<const SamplingRule*> rules;
+    if (active)
+        rules = *active;
+    if (std::find(rules.begin(), rules.end(), &*rule) != rules.end())
+        return;
+    rules.push_back(&*rule);
+
+    // Sets which have been published before are reused.
+    auto set = std::find(m_samplingSets.begin(), m_samplingSets.end(), rules);
+    if (set == m_samplingSets.end())
+    {
+        m_samplingSets.push_back(std::move(rules));
+        set = std::prev(m_samplingSets.end());
+    }
+    m_sampling.store(&*set, DIME_STD::memory_order_release);
+}
+
+void Engine::clearSampling()
+{
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    m_sampling.store(nullptr, DIME_STD::memory_order_release);
+}
+
+bool Engine::sample(const Code& code, std::uint32_t& weight) const noexcept
+{
+    auto rules = m_sampling.load(DIME_STD::memory_order_acquire);
+    if (!rules)
+        return true;
+
+    for (const SamplingRule* rule : *rules)
+        if (rule->matcher->matches(code))
+            return rule->sample(weight);
+    return true;
+}
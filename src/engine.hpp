@@ -31,15 +31,24 @@
 
 #include "config.hpp"
 #include "allocator.hpp"
+#include "arena.hpp"
+#include "codeinterner.hpp"
 #include "diagnostic.hpp"
 #include "patternmatching.hpp"
+#include "ringallocator.hpp"
 
+#include <chrono>
+#include <cstdint>
 #include <list>
+#include <string>
+#include <vector>
 
 #ifdef DIME_USE_WEOS
+#include <weos/atomic.hpp>
 #include <weos/memory.hpp>
 #include <weos/mutex.hpp>
 #else
+#include <atomic>
 #include <memory>
 #include <mutex>
 #endif // DIME_USE_WEOS
@@ -49,6 +58,43 @@ namespace dime
 {
 class Subscriber;
 
+//! \brief The parameters of a token bucket.
+struct RateLimit
+{
+    //! The number of diagnostics per second. If zero, all droppable
+    //! diagnostics are suppressed.
+    unsigned rate = 1000;
+    //! The number of diagnostics which may be published at once.
+    unsigned burst = 100;
+    //! The minimum time between two reports of suppressed diagnostics.
+    std::chrono::nanoseconds reportInterval = std::chrono::seconds(1);
+    //! If set, every code which matches the pattern has a bucket of its
+    //! own. Otherwise, all matching codes share one bucket.
+    bool perCode = false;
+    //! The maximum number of codes with their own bucket. Further codes
+    //! share one bucket.
+    unsigned maxCodes = 256;
+};
+
+//! \brief The parameters of sampling.
+struct Sampling
+{
+    //! Publishes one in \p oneIn diagnostics at random.
+    unsigned oneIn = 1;
+    //! If non-zero, every publishing thread publishes about
+    //! \p ratePerSecond diagnostics per second and \p oneIn is ignored.
+    //! The sampling probability follows the rate of the thread in the
+    //! previous second.
+    unsigned ratePerSecond = 0;
+};
+
+//! \brief The diagnostic which reports suppressed diagnostics.
+//!
+//! The arguments are the number of diagnostics, which have been suppressed
+//! since the last report, and the pattern of the rate limit.
+constexpr Descriptor<void(unsigned, const char*)> suppressedDiagnostics(
+        "DIME_SUPPRESSED", "{0} diagnostics matching {1} suppressed", Severity::Warning);
+
 class Engine : public Allocator
 {
     struct FilteredSubscriber
@@ -70,16 +116,256 @@ class Engine : public Allocator
         Subscriber* subscriber;
     };
 
+    //! The threshold for the codes starting with a prefix.
+    struct ThresholdOverride
+    {
+        Code prefix;
+        //! The mask of the symbols in the prefix.
+        Code mask;
+        unsigned length;
+        Severity threshold;
+    };
+
+    //! The token buckets of a rate limit.
+    struct RateLimitBuckets
+    {
+        //! The codes with their own bucket or a null pointer, if all codes
+        //! share one bucket.
+        DIME_STD::unique_ptr<CodeInterner> codes;
+        //! The time at which a bucket is full again. There is a bucket for
+        //! every interned code plus a shared one.
+        DIME_STD::unique_ptr<DIME_STD::atomic<std::int64_t>[]> fullAt;
+    };
+
+    //! A token bucket for the codes matching a pattern.
+    struct RateLimitRule
+    {
+        explicit
+        RateLimitRule(const char* pattern);
+
+        //! Replaces the parameters with the \p limit and refills the
+        //! buckets at the time \p now. The mutex must be locked.
+        void set(const RateLimit& limit, std::int64_t now);
+
+        //! Takes a token for the \p code at the time \p now. Returns
+        //! \p false, if the bucket is empty.
+        bool admit(const Code& code, std::int64_t now) noexcept;
+
+        std::string pattern;
+        DIME_STD::unique_ptr<dime_detail::PatternMatcher> matcher;
+        //! The time between two tokens in ns. Like the other parameters,
+        //! it is updated in place while other threads take tokens.
+        DIME_STD::atomic<std::int64_t> interval;
+        //! How far the bucket may run ahead of the current time in ns.
+        DIME_STD::atomic<std::int64_t> tolerance;
+        //! The time between two reports in ns.
+        DIME_STD::atomic<std::int64_t> reportInterval;
+        //! The buckets for every layout (shared or per code with a maximum
+        //! number of codes) which has been set.
+        std::list<RateLimitBuckets> layouts;
+        //! The buckets of the current layout.
+        DIME_STD::atomic<RateLimitBuckets*> buckets;
+        //! The time of the next report.
+        DIME_STD::atomic<std::int64_t> nextReport;
+        //! The number of suppressed diagnostics since the last report.
+        DIME_STD::atomic<std::uint64_t> numPending;
+    };
+
+    //! The sampling of the codes matching a pattern.
+    struct SamplingRule
+    {
+        SamplingRule(const char* pattern, std::size_t index);
+
+        //! Replaces the parameters of the \p sampling.
+        void set(const Sampling& sampling) noexcept;
+
+        //! Decides if a diagnostic is published. If so, returns \p true
+        //! and sets its sampling \p weight.
+        bool sample(std::uint32_t& weight) const noexcept;
+
+        std::string pattern;
+        DIME_STD::unique_ptr<dime_detail::PatternMatcher> matcher;
+        //! The parameters of the sampling. They are updated in place
+        //! while other threads sample.
+        DIME_STD::atomic<unsigned> oneIn;
+        DIME_STD::atomic<unsigned> ratePerSecond;
+        //! The index of the rule in the thread-local state, which is
+        //! unique among all existing engines.
+        std::size_t index;
+    };
+
+    //! A recently published diagnostic, whose repeats are coalesced.
+    struct RepeatSlot
+    {
+        //! The hash of the code and the arguments or zero, if the slot is
+        //! unused.
+        std::uint64_t hash;
+        Code code;
+        //! The unique ID of the first instance.
+        UniqueId firstId;
+        //! The end of the time window in ns.
+        std::int64_t windowEnd;
+        //! The summary of the repeats or a null pointer, if there has been
+        //! no repeat yet.
+        Diagnostic* summary;
+    };
+
 public:
-    // TODO:
-    // Engine(std::size_t memorySize);
+    //! \brief Creates an engine which allocates diagnostics from the heap.
+    Engine() = default;
+
+    //! \brief Creates an engine which allocates diagnostics from \p allocator.
+    //!
+    //! The \p allocator must outlive the engine.
+    explicit
+    Engine(Allocator& allocator);
+
+    //! \brief Creates an engine with a fixed amount of memory.
+    //!
+    //! The engine allocates diagnostics from a ring in a MemoryArena of
+    //! \p memorySize bytes, which is set up according to \p options.
+    explicit
+    Engine(std::size_t memorySize, const ArenaOptions& options = ArenaOptions());
+
+    //! \brief Destroys the engine.
+    //!
+    //! Summaries of repeats, which have not been flushed, are discarded
+    //! and their repeats are lost. They are not dispatched here, because
+    //! the subscribers may already have been destroyed. Call flushRepeats()
+    //! before destroying an engine with a coalescing window.
+    virtual
+    ~Engine();
 
+    virtual
+    void* allocate(std::size_t size) override;
+
+    virtual
+    void deallocate(void* p) noexcept override;
+
+    //! \brief Publishes a diagnostic.
+    //!
+    //! Creates a diagnostic from the descriptor \p spec and the
+    //! \p arguments and dispatches it to the subscribers. Nothing is
+    //! created, if the severity of the descriptor is below the threshold.
     template <typename... TArguments>
     void publish(const Descriptor<void(TArguments...)>& spec,
                  TArguments&&... arguments);
 
+    //! \brief Publishes a diagnostic which cannot be dropped.
+    //!
+    //! In contrast to the droppable variant, the diagnostic is never
+    //! suppressed by a rate limit.
+    template <typename... TArguments>
+    void publish(non_droppable_t, const Descriptor<void(TArguments...)>& spec,
+                 TArguments&&... arguments);
+
+    //! \brief Checks if diagnostics of the descriptor \p spec are published.
+    template <typename... TArguments>
+    bool enabled(const Descriptor<void(TArguments...)>& spec);
+
+    //! \brief Sets the severity threshold.
+    //!
+    //! Diagnostics whose severity is below the \p threshold are dropped by
+    //! publish() before they are created. Initially, the threshold is
+    //! Severity::Trace, i.e. no diagnostic is dropped. The threshold may be
+    //! changed while other threads publish diagnostics.
+    void setThreshold(Severity threshold);
+
+    //! \brief Sets the severity threshold for a code prefix.
+    //!
+    //! Overrides the threshold for all codes which start with \p prefix. If
+    //! several prefixes match a code, the longest one applies. Throws
+    //! IdentifierTooLongOrWrongChar, if the prefix is not a valid code.
+    void setThreshold(const char* prefix, Severity threshold);
+
+    //! \brief Removes the thresholds of all code prefixes.
+    void clearPrefixThresholds();
+
+    //! \brief Returns the severity threshold.
+    Severity threshold() const noexcept
+    {
+        return Severity(m_threshold.load(DIME_STD::memory_order_relaxed));
+    }
+
+    //! \brief Limits the rate of diagnostics.
+    //!
+    //! Droppable diagnostics whose code matches the \p pattern take a token
+    //! from a bucket with the given \p limit. The bucket is either shared
+    //! by all of them or, if RateLimit::perCode is set, specific to the
+    //! code. A diagnostic for which no token is left is suppressed before
+    //! it is created. Diagnostics below the threshold do not take a token.
+    //! The suppressed diagnostics are counted and reported with a
+    //! suppressedDiagnostics diagnostic at most once per report interval.
+    //! The report is due when a matching diagnostic is published after the
+    //! interval or when flushSuppressed() is called. If several patterns
+    //! match a code, the one which has been set first applies. Setting the
+    //! limit of a pattern again replaces its parameters and refills its
+    //! buckets.
+    void setRateLimit(const char* pattern, const RateLimit& limit);
+
+    //! \brief Removes all rate limits.
+    void clearRateLimits();
+
+    //! \brief Reports the suppressed diagnostics whose report is due.
+    //!
+    //! Without a matching diagnostic, the diagnostics suppressed at the
+    //! end of a flood are not reported. This function should thus be
+    //! called periodically, e.g. from a housekeeping thread.
+    void flushSuppressed();
+
+    //! \brief Samples the diagnostics matching a pattern.
+    //!
+    //! Droppable diagnostics whose code matches the \p pattern are
+    //! published at random according to the \p sampling. The decision is
+    //! made before a diagnostic is created and uses a thread-local random
+    //! number generator only. Diagnostics below the threshold are not
+    //! sampled and do not count towards the rate. A published diagnostic
+    //! carries the inverse of its sampling probability as weight (see
+    //! Diagnostic::samplingWeight()). If several patterns match a code, the
+    //! one which has been set first applies. Setting the sampling of a
+    //! pattern again replaces its parameters but keeps the state of the
+    //! rate.
+    void setSampling(const char* pattern, const Sampling& sampling);
+
+    //! \brief Removes all sampling.
+    void clearSampling();
+
+    //! \brief Sets the time window in which repeats are coalesced.
+    //!
+    //! If a droppable diagnostic with the same code and the same argument
+    //! values as a recently dispatched one is published within the
+    //! \p window, it is not dispatched. Instead, it is merged into a
+    //! summary, which counts the repeats (see Diagnostic::numRepeats()).
+    //! The summary is dispatched when the first diagnostic with the same
+    //! values is published after the window, when its slot in the table of
+    //! recent diagnostics is taken by another diagnostic, or when
+    //! flushRepeats() is called. A window of zero, which is the default,
+    //! disables the coalescing. The summary has the unique ID of the first
+    //! instance. Pending summaries have to be flushed before the engine is
+    //! destroyed.
+    //!
+    //! Diagnostics are considered equal, if their codes and a 64-bit hash
+    //! of their arguments are equal. Strings are compared by content.
+    void setCoalescingWindow(std::chrono::nanoseconds window);
+
+    //! \brief Dispatches all pending summaries of repeats.
+    void flushRepeats();
+
+    //! \brief Returns the total number of suppressed diagnostics.
+    std::uint64_t numSuppressed() const noexcept
+    {
+        return m_numSuppressed.load(DIME_STD::memory_order_relaxed);
+    }
+
     void dispatch(Diagnostic* diagnostic);
 
+    //! \brief Releases a diagnostic.
+    //!
+    //! Removes a reference from the \p diagnostic and destroys it when the
+    //! last reference is gone. A subscriber which keeps a diagnostic has to
+    //! release it when it is done with it.
+    void release(Diagnostic* diagnostic) noexcept;
+
     void subscribe(const char* filterPattern, Subscriber* subscriber);
 
     /*
@@ -97,10 +383,89 @@ public:
 private:
     DIME_STD::mutex m_mutex;
 
+    //! The allocator for the diagnostics or a null pointer to use the heap.
+    Allocator* m_allocator = nullptr;
+
+    //! The memory of an engine with a fixed-size arena.
+    DIME_STD::unique_ptr<MemoryArena> m_arena;
+    //! The allocator in the arena.
+    DIME_STD::unique_ptr<RingAllocator> m_arenaAllocator;
+
     Subscriber* m_fallbackConsumer = nullptr;
 
     std::list<FilteredSubscriber> m_list;
 
+    //! The threshold for codes without an override.
+    DIME_STD::atomic<std::uint8_t> m_threshold{0};
+    //! The minimum of all thresholds. A diagnostic below it is dropped
+    //! without taking the lock.
+    DIME_STD::atomic<std::uint8_t> m_minThreshold{0};
+    //! The overrides sorted by decreasing prefix length.
+    std::vector<ThresholdOverride> m_thresholds;
+
+    //! Checks if a diagnostic with the \p code and the \p severity passes
+    //! the overrides. The mutex must be locked.
+    bool passesPrefixThresholds(const Code& code, Severity severity) const noexcept;
+
+    //! Recomputes the minimum threshold. The mutex must be locked.
+    void updateMinThreshold() noexcept;
+
+    //! Set if there are overrides. It allows to check the threshold
+    //! without the lock otherwise.
+    DIME_STD::atomic<bool> m_hasPrefixThresholds{false};
+
+    //! Checks if a diagnostic with the \p code and the \p severity passes
+    //! the threshold and the overrides. The mutex must not be locked.
+    bool passesThresholds(const Code& code, Severity severity);
+
+    //! The rate limit rules, one per pattern which has ever been set. They
+    //! are kept alive until the engine is destroyed, because publish()
+    //! reads them without the lock.
+    std::list<RateLimitRule> m_rateLimitRules;
+    //! All distinct sets of active rules which have ever been published.
+    std::list<std::vector<RateLimitRule*>> m_rateLimitSets;
+    //! The active rules or a null pointer, if there is no rate limit.
+    DIME_STD::atomic<const std::vector<RateLimitRule*>*> m_rateLimits{nullptr};
+    //! The total number of suppressed diagnostics.
+    DIME_STD::atomic<std::uint64_t> m_numSuppressed{0};
+
+    //! The sampling rules, one per pattern which has ever been set. They
+    //! are kept alive like the rate limit rules.
+    std::list<SamplingRule> m_samplingRules;
+    //! All distinct sets of active sampling rules which have ever been
+    //! published.
+    std::list<std::vector<const SamplingRule*>> m_samplingSets;
+    //! The active sampling rules or a null pointer, if nothing is sampled.
+    DIME_STD::atomic<const std::vector<const SamplingRule*>*> m_sampling{nullptr};
+
+    //! Decides if a diagnostic with the \p code is published. If so,
+    //! returns \p true and sets its sampling \p weight.
+    bool sample(const Code& code, std::uint32_t& weight) const noexcept;
+
+    //! The window for coalescing repeats in ns or zero.
+    std::int64_t m_coalescingWindow = 0;
+    //! The recently published diagnostics.
+    RepeatSlot m_repeats[DIME_COALESCING_SLOTS] = {};
+
+    static_assert((DIME_COALESCING_SLOTS & (DIME_COALESCING_SLOTS - 1)) == 0,
+                  "The number of coalescing slots must be a power of two");
+
+    //! Merges the \p diagnostic into a summary, if it repeats a recent one.
+    //! Returns \p true, if it has been merged. The mutex must be locked.
+    bool coalesce(Diagnostic* diagnostic);
+
+    //! Dispatches the summary in the \p slot. The mutex must be locked.
+    void flushRepeats(RepeatSlot& slot);
+
+    //! Checks if a diagnostic with the \p code passes the rate limits.
+    bool admit(const Code& code);
+    //! Reports the suppressed diagnostics of a \p rule, if the report is
+    //! due at the given \p time.
+    void reportSuppressed(RateLimitRule& rule, std::int64_t time);
+
+    //! Publishes the active rate limit \p rules.
+    void setRateLimitRules(std::vector<RateLimitRule*> rules);
+
     // TODO:
     // - Fallback diagnostic
     // - Common base class for everything allocated in DiagnosticAllocator
@@ -110,9 +475,55 @@ template <typename... TArguments>
 void Engine::publish(const Descriptor<void(TArguments...)>& spec,
                      TArguments&&... arguments)
 {
+    if (std::uint8_t(spec.severity()) < m_minThreshold.load(DIME_STD::memory_order_relaxed))
+        return;
+    std::uint32_t weight = 1;
+    bool sampled = m_sampling.load(DIME_STD::memory_order_acquire) != nullptr;
+    bool limited = m_rateLimits.load(DIME_STD::memory_order_acquire) != nullptr;
+    if (sampled || limited)
+    {
+        // Diagnostics which are filtered anyway must neither count towards
+        // the sampling rate nor take a token.
+        if (!passesThresholds(spec.m_code, spec.severity()))
+            return;
+        if (sampled && !sample(spec.m_code, weight))
+            return;
+        if (limited && !admit(spec.m_code))
+            return;
+    }
     DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    if (!m_thresholds.empty() && !passesPrefixThresholds(spec.m_code, spec.severity()))
+        return;
     auto diagnostic = Diagnostic::create(*this, spec, DIME_STD::forward<TArguments>(arguments)...);
+    diagnostic->m_samplingWeight = weight;
+    if (m_coalescingWindow != 0 && coalesce(diagnostic))
+        return;
     dispatch(diagnostic);
+    release(diagnostic);
+}
+
+template <typename... TArguments>
+void Engine::publish(non_droppable_t, const Descriptor<void(TArguments...)>& spec,
+                     TArguments&&... arguments)
+{
+    if (std::uint8_t(spec.severity()) < m_minThreshold.load(DIME_STD::memory_order_relaxed))
+        return;
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    if (!m_thresholds.empty() && !passesPrefixThresholds(spec.m_code, spec.severity()))
+        return;
+    auto diagnostic = Diagnostic::create(non_droppable, *this, spec,
+                                         DIME_STD::forward<TArguments>(arguments)...);
+    dispatch(diagnostic);
+    release(diagnostic);
+}
+
+template <typename... TArguments>
+bool Engine::enabled(const Descriptor<void(TArguments...)>& spec)
+{
+    if (std::uint8_t(spec.severity()) < m_minThreshold.load(DIME_STD::memory_order_relaxed))
+        return false;
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    return m_thresholds.empty() || passesPrefixThresholds(spec.m_code, spec.severity());
 }
 
 } // namespace dime
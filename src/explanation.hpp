@@ -0,0 +1,266 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_EXPLANATION_HPP
+#define DIME_EXPLANATION_HPP
+
+#include "argument.hpp"
+#include "config.hpp"
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+
+namespace dime
+{
+
+//! \brief An error in the format of an explanation.
+//!
+//! Thrown while parsing an explanation. If the explanation is parsed at
+//! compile-time, the error turns into a compilation error.
+struct InvalidExplanationFormat {};
+
+//! \brief A segment of an explanation.
+//!
+//! A segment is either literal text or the placeholder of an argument.
+struct ExplanationSegment
+{
+    //! The literal text. Not null-terminated.
+    const char* text;
+    //! The length of the text.
+    std::size_t length;
+    //! The index of the argument or -1 for literal text.
+    int argument;
+};
+
+//! \brief An explanation split into literal text and arguments.
+//!
+//! The explanation of a Descriptor may contain placeholders for the
+//! arguments of the diagnostic. A placeholder \p {N} refers to the N-th
+//! argument and \p {N:T} additionally states the type, which must match the
+//! argument: \p d for \p int, \p u for \p unsigned, \p f for any
+//! floating-point type and \p s for strings. Literal braces are written as
+//! \p {{ and \p }}. Example:
+//!
+//!     Descriptor<void(int, int, int)> desc("RANGE", "value {0} outside [{1}, {2}]");
+//!
+//! The explanation is split once when the descriptor is constructed, which
+//! happens at compile-time for a \p constexpr descriptor. An explanation
+//! with an unknown argument, a mismatching type or a syntax error cannot be
+//! compiled then.
+class Explanation
+{
+public:
+    constexpr
+    Explanation() noexcept
+        : m_segments{},
+          m_numSegments(0)
+    {
+    }
+
+    //! \brief Returns the number of segments.
+    constexpr
+    std::size_t numSegments() const noexcept
+    {
+        return m_numSegments;
+    }
+
+    //! \brief Returns the \p index-th segment.
+    constexpr
+    const ExplanationSegment& segment(std::size_t index) const noexcept
+    {
+        return m_segments[index];
+    }
+
+    //! \brief Appends literal text. Empty text is skipped.
+    constexpr
+    void appendText(const char* text, std::size_t length)
+    {
+        if (length != 0)
+            append(ExplanationSegment{text, length, -1});
+    }
+
+    //! \brief Appends the placeholder of the \p index-th argument.
+    constexpr
+    void appendArgument(int index)
+    {
+        append(ExplanationSegment{nullptr, 0, index});
+    }
+
+private:
+    ExplanationSegment m_segments[DIME_MAX_EXPLANATION_SEGMENTS];
+    std::size_t m_numSegments;
+
+
+    constexpr
+    void append(const ExplanationSegment& segment)
+    {
+        if (m_numSegments == DIME_MAX_EXPLANATION_SEGMENTS)
+            throw InvalidExplanationFormat();
+        m_segments[m_numSegments++] = segment;
+    }
+};
+
+namespace dime_detail
+{
+
+//! The kind of an argument of type \p T. Integers are promoted as in the
+//! construction of an Argument, e.g. a \p bool or an \p unsigned \p char
+//! is stored as \p int.
+template <typename T>
+struct ArgumentKindOf
+{
+    static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                  "The type cannot be stored in an argument");
+
+    using Promoted = decltype(+std::declval<T>());
+    static constexpr ArgumentKind value = std::is_signed<Promoted>::value
+                                          ? ArgumentKind::SignedInteger
+                                          : ArgumentKind::UnsignedInteger;
+};
+
+template <>
+struct ArgumentKindOf<float>
+{
+    static constexpr ArgumentKind value = ArgumentKind::Float;
+};
+
+template <>
+struct ArgumentKindOf<double>
+{
+    static constexpr ArgumentKind value = ArgumentKind::Double;
+};
+
+template <>
+struct ArgumentKindOf<long double>
+{
+    static constexpr ArgumentKind value = ArgumentKind::LongDouble;
+};
+
+template <>
+struct ArgumentKindOf<const char*>
+{
+    static constexpr ArgumentKind value = ArgumentKind::String;
+};
+
+template <>
+struct ArgumentKindOf<char*>
+{
+    static constexpr ArgumentKind value = ArgumentKind::String;
+};
+
+//! Checks if the type letter of a placeholder matches the \p kind.
+constexpr
+bool typeMatches(char type, ArgumentKind kind) noexcept
+{
+    return type == 'd' ? kind == ArgumentKind::SignedInteger
+         : type == 'u' ? kind == ArgumentKind::UnsignedInteger
+         : type == 'f' ? (kind == ArgumentKind::Float || kind == ArgumentKind::Double
+                          || kind == ArgumentKind::LongDouble)
+         : type == 's' ? kind == ArgumentKind::String
+         : false;
+}
+
+//! \brief Splits an explanation for a diagnostic with the \p kinds of
+//! arguments.
+constexpr
+Explanation parseExplanation(const char* text, const ArgumentKind* kinds,
+                             std::size_t numArguments)
+{
+    Explanation result;
+    if (text == nullptr)
+        return result;
+
+    const char* begin = text;
+    const char* iter = text;
+    while (*iter)
+    {
+        if ((iter[0] == '{' && iter[1] == '{') || (iter[0] == '}' && iter[1] == '}'))
+        {
+            // Keep one of the two braces.
+            result.appendText(begin, std::size_t(iter - begin + 1));
+            iter += 2;
+            begin = iter;
+        }
+        else if (*iter == '}')
+        {
+            throw InvalidExplanationFormat();
+        }
+        else if (*iter == '{')
+        {
+            result.appendText(begin, std::size_t(iter - begin));
+            ++iter;
+            if (*iter < '0' || *iter > '9')
+                throw InvalidExplanationFormat();
+            std::size_t index = 0;
+            while (*iter >= '0' && *iter <= '9')
+            {
+                index = index * 10 + std::size_t(*iter - '0');
+                if (index >= numArguments)
+                    throw InvalidExplanationFormat();
+                ++iter;
+            }
+            if (*iter == ':')
+            {
+                ++iter;
+                if (!typeMatches(*iter, kinds[index]))
+                    throw InvalidExplanationFormat();
+                ++iter;
+            }
+            if (*iter != '}')
+                throw InvalidExplanationFormat();
+            ++iter;
+            begin = iter;
+            result.appendArgument(int(index));
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+    result.appendText(begin, std::size_t(iter - begin));
+    return result;
+}
+
+//! \brief Splits an explanation for a diagnostic with the arguments
+//! \p TArguments.
+template <typename... TArguments>
+constexpr
+Explanation parseExplanation(const char* text)
+{
+    // The last kind avoids an empty array.
+    const ArgumentKind kinds[] = {ArgumentKindOf<std::decay_t<TArguments>>::value...,
+                                  ArgumentKind::String};
+    return parseExplanation(text, kinds, sizeof...(TArguments));
+}
+
+} // namespace dime_detail
+} // namespace dime
+
+#endif // DIME_EXPLANATION_HPP
@@ -0,0 +1,432 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "filesink.hpp"
+#include "diagnostic.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <limits>
+#include <system_error>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace dime;
+
+namespace
+{
+
+//! The source of the sink IDs.
+DIME_STD::atomic<std::uint64_t> nextSinkId(1);
+
+//! Caches the stage of the sink, which the current thread has used last.
+struct StageCache
+{
+    std::uint64_t sinkId;
+    void* stage;
+};
+
+thread_local StageCache stageCache = {0, nullptr};
+
+#ifdef IOV_MAX
+constexpr std::size_t maxIoVectors = IOV_MAX;
+#else
+constexpr std::size_t maxIoVectors = 16;
+#endif // IOV_MAX
+
+} // anonymous namespace
+
+
+FileSink::FileSink(const char* path, const FileSinkOptions& options)
+    : m_options(options),
+      m_id(nextSinkId++),
+      m_fd(::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)),
+      m_indexFd(-1),
+      m_offset(0),
+      m_numDropped(0)
+{
+    if (m_fd < 0)
+        throw std::system_error(errno, std::generic_category(), "open");
+    if (options.writeIndex)
+        openIndex(path);
+    m_flusher = DIME_STD::thread(&FileSink::run, this);
+}
+
+FileSink::~FileSink()
+{
+    {
+        DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_flusherCondition.notify_one();
+    m_flusher.join();
+    ::close(m_fd);
+    if (m_indexFd >= 0)
+        ::close(m_indexFd);
+}
+
+Subscriber::Action FileSink::process(Diagnostic* diagnostic)
+{
+    Stage& stage = localStage();
+    DIME_STD::unique_lock<DIME_STD::mutex> lock(stage.mutex);
+
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        if (!stage.block)
+        {
+            // Do not block the flusher while waiting for a free block.
+            // Only the owner of the stage installs a block, so it cannot
+            // have changed meanwhile.
+            lock.unlock();
+            Block* block = acquireBlock(!diagnostic->droppable());
+            lock.lock();
+            if (!block)
+                break;
+            stage.block = block;
+        }
+        if (stage.block->writer.append(*diagnostic))
+        {
+            if (m_indexFd >= 0)
+                stage.block->track(*diagnostic);
+            return Action::DropDiagnostic;
+        }
+
+        // The record does not fit. Seal the block and retry with a new one,
+        // unless the block has been empty.
+        if (stage.block->writer.empty())
+            break;
+        seal(stage);
+    }
+
+    m_numDropped.fetch_add(1, DIME_STD::memory_order_relaxed);
+    return Action::DropDiagnostic;
+}
+
+void FileSink::flush()
+{
+    DIME_STD::unique_lock<DIME_STD::mutex> lock(m_mutex);
+    std::uint64_t request = ++m_flushRequested;
+    m_flusherCondition.notify_one();
+    m_flushedCondition.wait(lock, [&] { return m_flushCompleted >= request; });
+}
+
+void FileSink::Block::track(const Diagnostic& diagnostic)
+{
+    std::int64_t timeStamp = toNanoseconds(diagnostic.timeStamp());
+    minTimeStamp = std::min(minTimeStamp, timeStamp);
+    maxTimeStamp = std::max(maxTimeStamp, timeStamp);
+
+    // Diagnostics with the same code tend to come in bursts.
+    const Code& code = diagnostic.code();
+    if (code != lastCode)
+    {
+        codes.insert(code);
+        lastCode = code;
+    }
+}
+
+void FileSink::Block::reset()
+{
+    writer.reset();
+    minTimeStamp = std::numeric_limits<std::int64_t>::max();
+    maxTimeStamp = std::numeric_limits<std::int64_t>::min();
+    // No code consists of padding symbols only.
+    lastCode = Code{0, 0};
+    codes.clear();
+}
+
+void FileSink::openIndex(const char* path)
+{
+    struct stat status;
+    if (::fstat(m_fd, &status) == 0)
+        m_offset = std::uint64_t(status.st_size);
+
+    m_indexFd = ::open(indexPath(path).c_str(),
+                       O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (m_indexFd < 0 || ::fstat(m_indexFd, &status) != 0)
+    {
+        int error = errno;
+        ::close(m_fd);
+        if (m_indexFd >= 0)
+            ::close(m_indexFd);
+        throw std::system_error(error, std::generic_category(), "open");
+    }
+
+    if (status.st_size == 0)
+    {
+        unsigned char header[indexHeaderSize];
+        writeIndexHeader(header);
+        if (::write(m_indexFd, header, indexHeaderSize) != ssize_t(indexHeaderSize))
+        {
+            int error = errno;
+            ::close(m_fd);
+            ::close(m_indexFd);
+            throw std::system_error(error, std::generic_category(), "write");
+        }
+    }
+}
+
+void FileSink::Block::prepare()
+{
+    output = writer.data();
+    outputSize = writer.size();
+    if (!compressed)
+        return;
+
+    std::size_t size = compressBlock(writer.data(), writer.size(),
+                                     compressed.get(), writer.size());
+    if (size != 0)
+    {
+        output = compressed.get();
+        outputSize = size;
+    }
+}
+
+FileSink::Stage& FileSink::localStage()
+{
+    if (stageCache.sinkId == m_id)
+        return *static_cast<Stage*>(stageCache.stage);
+
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    auto self = DIME_STD::this_thread::get_id();
+    auto iter = std::find_if(m_stages.begin(), m_stages.end(),
+                             [&](const DIME_STD::unique_ptr<Stage>& stage) {
+                                 return stage->owner == self;
+                             });
+    Stage* stage;
+    if (iter != m_stages.end())
+    {
+        stage = iter->get();
+    }
+    else
+    {
+        m_stages.emplace_back(new Stage);
+        stage = m_stages.back().get();
+        stage->owner = self;
+    }
+
+    stageCache.sinkId = m_id;
+    stageCache.stage = stage;
+    return *stage;
+}
+
+FileSink::Block* FileSink::acquireBlock(bool wait)
+{
+    DIME_STD::unique_lock<DIME_STD::mutex> lock(m_mutex);
+    while (m_freeBlocks.empty())
+    {
+        if (m_blocks.size() < m_options.maxBlocks)
+        {
+            m_blocks.emplace_back(new Block(m_options.blockSize, m_options.compress));
+            m_blocks.back()->reset();
+            return m_blocks.back().get();
+        }
+        if (!wait)
+            return nullptr;
+        m_flusherCondition.notify_one();
+        m_freeCondition.wait(lock);
+    }
+
+    Block* block = m_freeBlocks.back();
+    m_freeBlocks.pop_back();
+    return block;
+}
+
+void FileSink::seal(Stage& stage)
+{
+    Block* block = stage.block;
+    stage.block = nullptr;
+    std::size_t size = block->writer.finish();
+
+    bool wake;
+    {
+        DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+        m_pendingBlocks.push_back(block);
+        m_pendingBytes += size;
+        wake = m_pendingBytes >= m_options.flushSize;
+    }
+    if (wake)
+        m_flusherCondition.notify_one();
+}
+
+void FileSink::sealAll()
+{
+    std::vector<Stage*> stages;
+    {
+        DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+        for (auto& stage : m_stages)
+            stages.push_back(stage.get());
+    }
+
+    for (Stage* stage : stages)
+    {
+        DIME_STD::lock_guard<DIME_STD::mutex> lock(stage->mutex);
+        if (stage->block && !stage->block->writer.empty())
+            seal(*stage);
+    }
+}
+
+void FileSink::write(std::vector<Block*>& blocks)
+{
+    std::vector<iovec> vectors;
+    for (Block* block : blocks)
+    {
+        block->prepare();
+        vectors.push_back(iovec{block->output, block->outputSize});
+    }
+
+    std::size_t first = 0;
+    bool failed = false;
+    while (first < vectors.size())
+    {
+        int count = int(std::min(vectors.size() - first, maxIoVectors));
+        ssize_t written = ::writev(m_fd, &vectors[first], count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            // The remaining records are lost.
+            for (std::size_t idx = first; idx < vectors.size(); ++idx)
+                m_numDropped.fetch_add(blocks[idx]->writer.header().numRecords,
+                                       DIME_STD::memory_order_relaxed);
+            failed = true;
+            break;
+        }
+
+        // Skip the vectors which have been written completely and adjust
+        // the one which has been written partially.
+        std::size_t remaining = std::size_t(written);
+        while (first < vectors.size() && remaining >= vectors[first].iov_len)
+            remaining -= vectors[first++].iov_len;
+        if (remaining)
+        {
+            vectors[first].iov_base = static_cast<char*>(vectors[first].iov_base) + remaining;
+            vectors[first].iov_len -= remaining;
+        }
+    }
+
+    if (m_options.sync == FileSinkOptions::Sync::EveryBatch)
+        ::fdatasync(m_fd);
+
+    if (m_indexFd >= 0)
+    {
+        // A block which has been written partially has no entry.
+        writeIndex(blocks, first);
+        if (failed)
+        {
+            struct stat status;
+            if (::fstat(m_fd, &status) == 0)
+                m_offset = std::uint64_t(status.st_size);
+        }
+    }
+}
+
+void FileSink::writeIndex(const std::vector<Block*>& blocks, std::size_t numWritten)
+{
+    std::vector<unsigned char> entries(numWritten * IndexEntry::encodedSize);
+    IndexEntry entry;
+    for (std::size_t idx = 0; idx < numWritten; ++idx)
+    {
+        const Block& block = *blocks[idx];
+        entry.offset = m_offset;
+        entry.size = std::uint32_t(block.outputSize);
+        entry.numRecords = block.writer.header().numRecords;
+        entry.minTimeStamp = block.minTimeStamp;
+        entry.maxTimeStamp = block.maxTimeStamp;
+        entry.codes = block.codes;
+        entry.write(entries.data() + idx * IndexEntry::encodedSize);
+        m_offset += entry.size;
+    }
+
+    // The index is only a hint. A lost entry makes the reader scan the
+    // block.
+    std::size_t offset = 0;
+    while (offset < entries.size())
+    {
+        ssize_t written = ::write(m_indexFd, entries.data() + offset,
+                                  entries.size() - offset);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        offset += std::size_t(written);
+    }
+
+    if (m_options.sync == FileSinkOptions::Sync::EveryBatch)
+        ::fdatasync(m_indexFd);
+}
+
+void FileSink::run()
+{
+    DIME_STD::unique_lock<DIME_STD::mutex> lock(m_mutex);
+    while (true)
+    {
+        bool timeout = !m_flusherCondition.wait_for(
+                           lock, m_options.flushInterval,
+                           [&] {
+                               return m_stop
+                                      || m_flushRequested != m_flushCompleted
+                                      || m_pendingBytes >= m_options.flushSize
+                                      || (m_freeBlocks.empty() && !m_pendingBlocks.empty());
+                           });
+        bool stop = m_stop;
+        std::uint64_t request = m_flushRequested;
+
+        // Seal partially filled blocks to bound the latency.
+        if (timeout || stop || request != m_flushCompleted)
+        {
+            lock.unlock();
+            sealAll();
+            lock.lock();
+        }
+
+        std::vector<Block*> blocks;
+        blocks.swap(m_pendingBlocks);
+        m_pendingBytes = 0;
+        lock.unlock();
+
+        write(blocks);
+        for (Block* block : blocks)
+            block->reset();
+
+        lock.lock();
+        m_freeBlocks.insert(m_freeBlocks.end(), blocks.begin(), blocks.end());
+        m_freeCondition.notify_all();
+        m_flushCompleted = request;
+        m_flushedCondition.notify_all();
+
+        if (stop)
+            break;
+    }
+}
@@ -0,0 +1,218 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_FILESINK_HPP
+#define DIME_FILESINK_HPP
+
+#include "config.hpp"
+#include "segment.hpp"
+#include "segmentindex.hpp"
+#include "subscriber.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef DIME_USE_WEOS
+#include <weos/atomic.hpp>
+#include <weos/condition_variable.hpp>
+#include <weos/memory.hpp>
+#include <weos/mutex.hpp>
+#include <weos/thread.hpp>
+#else
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#endif // DIME_USE_WEOS
+
+
+namespace dime
+{
+
+//! \brief Options for a FileSink.
+struct FileSinkOptions
+{
+    enum class Sync
+    {
+        //! Leave it to the operating system when the data reaches the disk.
+        Never,
+        //! Synchronize the file after every batch of blocks.
+        EveryBatch
+    };
+
+    //! The size of a staging buffer, which is also the maximum size of a
+    //! block in the file.
+    std::size_t blockSize = 64 * 1024;
+    //! The maximum number of staging buffers. When all of them are in use,
+    //! droppable diagnostics are dropped and non-droppable ones wait.
+    std::size_t maxBlocks = 64;
+    //! The latency bound. Partially filled buffers are written after this
+    //! interval at the latest.
+    std::chrono::milliseconds flushInterval = std::chrono::milliseconds(100);
+    //! The size bound. The flusher is woken up as soon as this many bytes
+    //! are waiting to be written.
+    std::size_t flushSize = 1024 * 1024;
+    //! The policy for synchronizing the file with the disk.
+    Sync sync = Sync::Never;
+    //! If set, the sink maintains an index of the blocks in a sidecar file
+    //! (see segmentindex.hpp and indexPath()).
+    bool writeIndex = false;
+    //! If set, the flusher compresses the blocks before writing them (see
+    //! compressBlock()). Blocks which do not shrink are written as they are.
+    bool compress = false;
+};
+
+//! \brief A subscriber which appends diagnostics to a binary log segment.
+//!
+//! Every thread which calls process() encodes the records into its own
+//! staging buffer, so producers do not contend with each other. Full
+//! buffers are sealed as blocks (see segment.hpp) and handed over to a
+//! background thread, which writes them with a single writev() per batch.
+//! The diagnostics are copied, so the sink never keeps them.
+//!
+//! Optionally, the flusher appends an entry for every written block to an
+//! index, which lets queries skip blocks by time and code.
+class FileSink : public Subscriber
+{
+public:
+    //! \brief Creates a sink which appends to the file at \p path.
+    //!
+    //! Throws \p std::system_error, if the file cannot be opened.
+    explicit
+    FileSink(const char* path, const FileSinkOptions& options = FileSinkOptions());
+
+    //! \brief Writes all staged records and closes the file.
+    virtual
+    ~FileSink();
+
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    virtual
+    Action process(Diagnostic* diagnostic) override;
+
+    //! \brief Writes all staged records.
+    //!
+    //! Blocks until all records which have been processed before the call
+    //! have been written to the file.
+    void flush();
+
+    //! \brief Returns the number of dropped diagnostics.
+    std::uint64_t numDropped() const noexcept
+    {
+        return m_numDropped.load(DIME_STD::memory_order_relaxed);
+    }
+
+private:
+    struct Block
+    {
+        explicit
+        Block(std::size_t size, bool compress)
+            : memory(new unsigned char[size]),
+              writer(memory.get(), size),
+              compressed(compress ? new unsigned char[size] : nullptr),
+              output(nullptr),
+              outputSize(0)
+        {
+        }
+
+        //! Records the time stamp and the code of an appended diagnostic
+        //! for the index.
+        void track(const Diagnostic& diagnostic);
+
+        void reset();
+
+        //! Selects the bytes to write. Compresses the block into the second
+        //! buffer, if there is one.
+        void prepare();
+
+        DIME_STD::unique_ptr<unsigned char[]> memory;
+        BlockWriter writer;
+        DIME_STD::unique_ptr<unsigned char[]> compressed;
+        //! The bytes which are written to the file.
+        unsigned char* output;
+        std::size_t outputSize;
+        std::int64_t minTimeStamp;
+        std::int64_t maxTimeStamp;
+        Code lastCode;
+        CodeFilter codes;
+    };
+
+    //! The staging area of a thread.
+    struct Stage
+    {
+        DIME_STD::mutex mutex;
+        DIME_STD::thread::id owner;
+        Block* block = nullptr;
+    };
+
+    const FileSinkOptions m_options;
+    //! A unique number to identify the sink in the thread-local cache.
+    const std::uint64_t m_id;
+    int m_fd;
+    //! The index file or -1, if no index is written.
+    int m_indexFd;
+    //! The offset of the next block in the segment. Only used by the
+    //! flusher.
+    std::uint64_t m_offset;
+
+    DIME_STD::mutex m_mutex;
+    DIME_STD::condition_variable m_flusherCondition;
+    DIME_STD::condition_variable m_freeCondition;
+    DIME_STD::condition_variable m_flushedCondition;
+
+    std::vector<DIME_STD::unique_ptr<Stage>> m_stages;
+    std::vector<DIME_STD::unique_ptr<Block>> m_blocks;
+    std::vector<Block*> m_freeBlocks;
+    std::vector<Block*> m_pendingBlocks;
+    std::size_t m_pendingBytes = 0;
+    std::uint64_t m_flushRequested = 0;
+    std::uint64_t m_flushCompleted = 0;
+    bool m_stop = false;
+
+    DIME_STD::atomic<std::uint64_t> m_numDropped;
+
+    DIME_STD::thread m_flusher;
+
+
+    void openIndex(const char* path);
+    Stage& localStage();
+    Block* acquireBlock(bool wait);
+    void seal(Stage& stage);
+    void sealAll();
+    void write(std::vector<Block*>& blocks);
+    void writeIndex(const std::vector<Block*>& blocks, std::size_t numWritten);
+    void run();
+};
+
+} // namespace dime
+
+#endif // DIME_FILESINK_HPP
@@ -0,0 +1,287 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "flightrecorder.hpp"
+#include "diagnostic.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace dime;
+using namespace dime_detail;
+
+namespace
+{
+
+constexpr std::uint32_t flightRecorderMagic = 0x464D4944; // "DIMF"
+constexpr std::uint32_t flightRecorderVersion = 2;
+//! The offset of the ring in the file.
+constexpr std::size_t headerSize = 4096;
+//! The size of the lap stamp in front of every record.
+constexpr std::size_t lapStampSize = 4;
+
+//! Returns the stamp of the lap in which the byte at the logical
+//! \p position is written. The stamp of the first lap is 1, so that the
+//! zeros of a new file are never taken for a record.
+std::uint32_t lapStamp(std::uint64_t position, std::uint64_t capacity) noexcept
+{
+    return std::uint32_t(position / capacity + 1);
+}
+
+//! Closes a file descriptor when going out of scope.
+class FileCloser
+{
+public:
+    explicit
+    FileCloser(int fd)
+        : m_fd(fd)
+    {
+    }
+
+    ~FileCloser()
+    {
+        if (m_fd >= 0)
+            ::close(m_fd);
+    }
+
+private:
+    int m_fd;
+};
+
+[[noreturn]]
+void throwSystemError(const char* what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+} // anonymous namespace
+
+
+FlightRecorder::FlightRecorder(const char* path, std::size_t capacity)
+    : m_mapping(MAP_FAILED),
+      m_mappingSize(0),
+      m_header(nullptr),
+      m_ring(nullptr),
+      m_capacity(0),
+      m_numDropped(0)
+{
+    static_assert(sizeof(FlightRecorderHeader) <= headerSize, "Header is too large");
+
+    std::size_t pageSize = std::size_t(::sysconf(_SC_PAGESIZE));
+    m_capacity = (capacity + pageSize - 1) / pageSize * pageSize;
+    m_mappingSize = headerSize + m_capacity;
+
+    int fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throwSystemError("open");
+    FileCloser closer(fd);
+
+    // Check if the file holds a ring of the same size, which is continued.
+    bool reuse = false;
+    struct stat status;
+    if (::fstat(fd, &status) != 0)
+        throwSystemError("fstat");
+    if (std::size_t(status.st_size) == m_mappingSize)
+    {
+        FlightRecorderHeader header;
+        if (::pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header)))
+        {
+            reuse = header.magic == flightRecorderMagic
+                    && header.version == flightRecorderVersion
+                    && header.capacity == m_capacity;
+        }
+    }
+
+    if (!reuse && (::ftruncate(fd, 0) != 0 || ::ftruncate(fd, off_t(m_mappingSize)) != 0))
+        throwSystemError("ftruncate");
+
+    m_mapping = ::mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m_mapping == MAP_FAILED)
+        throwSystemError("mmap");
+
+    m_header = static_cast<FlightRecorderHeader*>(m_mapping);
+    m_ring = static_cast<unsigned char*>(m_mapping) + headerSize;
+    if (!reuse)
+    {
+        new (m_header) FlightRecorderHeader;
+        m_header->capacity = m_capacity;
+        m_header->reference = toNanoseconds(Diagnostic::TimePoint::clock::now());
+        m_header->cursor.store(0, DIME_STD::memory_order_relaxed);
+        m_header->version = flightRecorderVersion;
+        m_header->magic = flightRecorderMagic;
+    }
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    ::munmap(m_mapping, m_mappingSize);
+}
+
+Subscriber::Action FlightRecorder::process(Diagnostic* diagnostic)
+{
+    std::int64_t reference = m_header->reference;
+    std::size_t size = lapStampSize + encodedSize(*diagnostic, reference);
+    if (size > m_capacity)
+    {
+        m_numDropped.fetch_add(1, DIME_STD::memory_order_relaxed);
+        return Action::DropDiagnostic;
+    }
+
+    // Reserve the space for the record. If it does not fit in front of the
+    // end of the ring, the record starts at the beginning.
+    std::uint64_t cursor = m_header->cursor.load(DIME_STD::memory_order_relaxed);
+    std::uint64_t start;
+    do
+    {
+        std::uint64_t offset = cursor % m_capacity;
+        start = offset + size > m_capacity ? cursor + (m_capacity - offset) : cursor;
+    } while (!m_header->cursor.compare_exchange_weak(cursor, start + size,
+                                                     DIME_STD::memory_order_relaxed));
+
+    // Clear the skipped bytes. A zero length after the lap stamp marks the
+    // skip for the reader.
+    if (start != cursor)
+    {
+        std::uint64_t offset = cursor % m_capacity;
+        std::memset(m_ring + offset, 0, std::size_t(m_capacity - offset));
+        if (m_capacity - offset >= lapStampSize)
+            writeLittleEndian(m_ring + offset, lapStamp(cursor, m_capacity), lapStampSize);
+    }
+
+    // The lap stamp distinguishes the record from the ones of earlier laps,
+    // which are still in place if the process dies before the record has
+    // been written.
+    unsigned char* dest = m_ring + start % m_capacity;
+    writeLittleEndian(dest, lapStamp(start, m_capacity), lapStampSize);
+    encode(*diagnostic, reference, dest + lapStampSize, size - lapStampSize);
+    return Action::DropDiagnostic;
+}
+
+FlightRecorderReader::FlightRecorderReader(const char* path)
+    : m_mapping(MAP_FAILED),
+      m_mappingSize(0),
+      m_ring(nullptr),
+      m_capacity(0),
+      m_reference(0),
+      m_position(0),
+      m_end(0),
+      m_synchronized(true),
+      m_numSkippedBytes(0)
+{
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throwSystemError("open");
+    FileCloser closer(fd);
+
+    struct stat status;
+    if (::fstat(fd, &status) != 0)
+        throwSystemError("fstat");
+    m_mappingSize = std::size_t(status.st_size);
+    if (m_mappingSize <= headerSize)
+        throw std::runtime_error("Not a flight recorder file");
+
+    m_mapping = ::mmap(nullptr, m_mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (m_mapping == MAP_FAILED)
+        throwSystemError("mmap");
+
+    auto header = static_cast<const FlightRecorderHeader*>(m_mapping);
+    if (header->magic != flightRecorderMagic
+        || header->version != flightRecorderVersion
+        || header->capacity != m_mappingSize - headerSize)
+    {
+        ::munmap(m_mapping, m_mappingSize);
+        throw std::runtime_error("Not a flight recorder file");
+    }
+
+    m_ring = static_cast<const unsigned char*>(m_mapping) + headerSize;
+    m_capacity = header->capacity;
+    m_reference = header->reference;
+    m_end = header->cursor.load(DIME_STD::memory_order_acquire);
+
+    // Once the ring has wrapped around, the oldest bytes may belong to a
+    // record whose start has been overwritten.
+    if (m_end > m_capacity)
+    {
+        m_position = m_end - m_capacity;
+        m_synchronized = false;
+    }
+}
+
+FlightRecorderReader::~FlightRecorderReader()
+{
+    ::munmap(m_mapping, m_mappingSize);
+}
+
+bool FlightRecorderReader::next(RecordView& view, std::int64_t& timeStamp) noexcept
+{
+    while (m_position < m_end)
+    {
+        std::uint64_t offset = m_position % m_capacity;
+        std::uint64_t toEnd = m_capacity - offset;
+
+        // Follow the skip to the start of the ring. While searching for the
+        // start of a record, a zero length is not trusted.
+        bool stamped = toEnd >= lapStampSize + recordPrefixSize
+                       && readLittleEndian(m_ring + offset, lapStampSize)
+                          == lapStamp(m_position, m_capacity);
+        if (m_synchronized
+            && (toEnd < lapStampSize + recordPrefixSize
+                || (stamped && readLittleEndian(m_ring + offset + lapStampSize, 4) == 0)))
+        {
+            m_position += toEnd;
+            continue;
+        }
+
+        // Records of an earlier lap carry a different stamp.
+        std::uint64_t available = toEnd < m_end - m_position ? toEnd : m_end - m_position;
+        RecordReader reader(m_ring + offset + lapStampSize,
+                            stamped && available > lapStampSize
+                            ? std::size_t(available - lapStampSize) : 0);
+        if (stamped && reader.next(view))
+        {
+            m_position += lapStampSize + reader.offset();
+            m_synchronized = true;
+            timeStamp = view.timeStamp(m_reference);
+            return true;
+        }
+
+        // Search the start of the next valid record byte by byte.
+        m_synchronized = false;
+        ++m_position;
+        ++m_numSkippedBytes;
+    }
+    return false;
+}
@@ -0,0 +1,171 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_FLIGHTRECORDER_HPP
+#define DIME_FLIGHTRECORDER_HPP
+
+#include "config.hpp"
+#include "subscriber.hpp"
+#include "wireformat.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef DIME_USE_WEOS
+#include <weos/atomic.hpp>
+#else
+#include <atomic>
+#endif // DIME_USE_WEOS
+
+
+namespace dime
+{
+
+namespace dime_detail
+{
+
+//! The header of a flight recorder file. It is stored in the native byte
+//! order and occupies the first page of the file.
+struct FlightRecorderHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    //! The size of the ring in bytes.
+    std::uint64_t capacity;
+    //! The reference of the time stamps of all records in nanoseconds.
+    std::int64_t reference;
+    //! The number of bytes which have been written to the ring since it
+    //! has been created. The ring offset is the cursor modulo the capacity.
+    DIME_STD::atomic<std::uint64_t> cursor;
+};
+
+} // namespace dime_detail
+
+//! \brief A subscriber which records diagnostics in a memory-mapped ring.
+//!
+//! The flight recorder maps a file with a header and a fixed-size ring.
+//! Every diagnostic is encoded directly into the mapping and the cursor in
+//! the header is advanced, overwriting the oldest records. Nothing is
+//! flushed explicitly. Because the mapping is shared with the page cache,
+//! the records survive a crash or a SIGKILL of the process (but not a
+//! crash of the operating system). Use FlightRecorderReader to read them
+//! after a restart.
+//!
+//! Every record is preceded by a 32-bit stamp of the lap of the ring, in
+//! which it has been written. Thus, the reader rejects records of earlier
+//! laps, which remain in a range that has been reserved but not written
+//! before the process died. A record never wraps around the end of the
+//! ring. If it does not fit, the remaining bytes are skipped, which is
+//! marked by a lap stamp and a zero length prefix if there is room for it.
+class FlightRecorder : public Subscriber
+{
+public:
+    //! \brief Opens a flight recorder.
+    //!
+    //! Opens the file at \p path with a ring of \p capacity bytes. The
+    //! capacity is rounded up to the page size. If the file holds a ring
+    //! of the same capacity, new records are appended to it. Otherwise, it
+    //! is re-initialized. Throws \p std::system_error, if the file cannot
+    //! be created or mapped.
+    FlightRecorder(const char* path, std::size_t capacity);
+
+    virtual
+    ~FlightRecorder();
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    virtual
+    Action process(Diagnostic* diagnostic) override;
+
+    //! \brief Returns the number of diagnostics which did not fit the ring.
+    std::uint64_t numDropped() const noexcept
+    {
+        return m_numDropped.load(DIME_STD::memory_order_relaxed);
+    }
+
+private:
+    void* m_mapping;
+    std::size_t m_mappingSize;
+    dime_detail::FlightRecorderHeader* m_header;
+    unsigned char* m_ring;
+    std::uint64_t m_capacity;
+    DIME_STD::atomic<std::uint64_t> m_numDropped;
+};
+
+//! \brief Reads the records of a flight recorder file.
+//!
+//! The reader maps the file read-only and returns the records from the
+//! oldest to the newest one. Records which have been partially overwritten,
+//! not been completely written before a crash or stem from an earlier lap
+//! of the ring are skipped.
+class FlightRecorderReader
+{
+public:
+    //! \brief Opens the flight recorder file at \p path.
+    //!
+    //! Throws \p std::system_error, if the file cannot be mapped, and
+    //! \p std::runtime_error, if it is not a flight recorder file.
+    explicit
+    FlightRecorderReader(const char* path);
+
+    ~FlightRecorderReader();
+
+    FlightRecorderReader(const FlightRecorderReader&) = delete;
+    FlightRecorderReader& operator=(const FlightRecorderReader&) = delete;
+
+    //! \brief Reads the next record.
+    //!
+    //! Fills the \p view and sets \p timeStamp to the absolute time stamp in
+    //! nanoseconds. Returns \p false, if there are no more records.
+    bool next(RecordView& view, std::int64_t& timeStamp) noexcept;
+
+    //! \brief Returns the number of bytes which have been skipped.
+    std::uint64_t numSkippedBytes() const noexcept
+    {
+        return m_numSkippedBytes;
+    }
+
+private:
+    void* m_mapping;
+    std::size_t m_mappingSize;
+    const unsigned char* m_ring;
+    std::uint64_t m_capacity;
+    std::int64_t m_reference;
+    //! The logical position of the next record.
+    std::uint64_t m_position;
+    //! The logical end of the written data.
+    std::uint64_t m_end;
+    //! Set if the position is known to be at the start of a record.
+    bool m_synchronized;
+    std::uint64_t m_numSkippedBytes;
+};
+
+} // namespace dime
+
+#endif // DIME_FLIGHTRECORDER_HPP
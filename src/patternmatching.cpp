@@ -50,8 +50,10 @@ public:
     virtual
     bool matches(const Code& id) const override
     {
-        auto stringId = id.toString();
-        return dime_detail::match(m_pattern, stringId.c_str());
+        char text[21];
+        id.toChars(text);
+        text[20] = 0;
+        return dime_detail::match(m_pattern, text);
     }
 
     virtual
@@ -77,18 +79,83 @@ private:
     PatternMatcher* m_next;
 };
 
+namespace
+{
 
-std::unique_ptr<PatternMatcher> dime::dime_detail::compilePattern(const char* pattern)
+//! Matches a pattern, whose characters in front of the first '*' are
+//! literals or '?', by comparing the masked words of a code. If the pattern
+//! does not look beyond the 10th character, only the first word is compared.
+class MaskMatcher : public PatternMatcher
+{
+public:
+    MaskMatcher(const Code& mask, const Code& value)
+        : m_mask(mask),
+          m_value(value)
+    {
+    }
+
+    virtual
+    bool matches(const Code& id) const override
+    {
+        if ((id[0] & m_mask[0]) != m_value[0])
+            return false;
+        return m_mask.isShort() || (id[1] & m_mask[1]) == m_value[1];
+    }
+
+    virtual
+    Type type() const override
+    {
+        return Exact;
+    }
+
+    virtual
+    bool moreSpecificThan(const PatternMatcher&) const override
+    {
+        // The matcher replaces a MatcherImpl and ranks like it.
+        return false;
+    }
+
+private:
+    Code m_mask;
+    Code m_value;
+};
+
+//! Computes the \p mask and the \p value of a MaskMatcher for the
+//! \p pattern. Returns \p false, if the pattern cannot be matched this way.
+bool compileMask(const char* pattern, Code& mask, Code& value)
 {
-    /*
-    bool hasWildcard = false;
-    int numClassWildcards = 0;
-    for (const char* iter = pattern; *iter != 0; ++iter)
+    mask = Code{0, 0};
+    value = Code{0, 0};
+    for (unsigned idx = 0; ; ++idx, ++pattern)
     {
-        if (*iter == '?')
-            hasWildcard = true;
+        if (*pattern == '*')
+            return true;
+        // Without a '*', the pattern has to cover all characters.
+        if (*pattern == 0)
+            return idx == 20;
+        if (idx == 20)
+            return false;
+        if (*pattern == '?')
+            continue;
+
+        unsigned char c = static_cast<unsigned char>(*pattern);
+        if (c >= 128 || compressionTable[c] == 99)
+            return false;
+        unsigned shift = (idx % 10) * 6;
+        mask.data[idx / 10] |= std::uint64_t(0x3F) << shift;
+        value.data[idx / 10] |= compressionTable[c] << shift;
     }
-    */
+}
+
+} // anonymous namespace
+
+
+std::unique_ptr<PatternMatcher> dime::dime_detail::compilePattern(const char* pattern)
+{
+    Code mask;
+    Code value;
+    if (compileMask(pattern, mask, value))
+        return std::unique_ptr<PatternMatcher>(new MaskMatcher(mask, value));
 
     return std::unique_ptr<PatternMatcher>(new MatcherImpl(pattern));
 }
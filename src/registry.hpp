@@ -0,0 +1,322 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_REGISTRY_HPP
+#define DIME_REGISTRY_HPP
+
+#include "argument.hpp"
+#include "code.hpp"
+#include "descriptor.hpp"
+#include "explanation.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+
+namespace dime
+{
+
+//! \brief Two descriptors in a registry have the same code.
+//!
+//! If the registry is built at compile-time, the error turns into a
+//! compilation error.
+struct DuplicateDescriptorCode {};
+
+//! \brief No perfect hash has been found for the codes of a registry.
+struct PerfectHashNotFound {};
+
+//! \brief The metadata of a descriptor.
+struct DescriptorInfo
+{
+    Code code;
+    //! The number of arguments.
+    std::size_t numArguments;
+    //! The kinds of the arguments.
+    const ArgumentKind* kinds;
+    //! The explanation of the descriptor.
+    const Explanation* explanation;
+    //! The severity of the descriptor.
+    Severity severity = Severity::Info;
+};
+
+namespace dime_detail
+{
+
+//! The kinds of the arguments \p TArguments. The last kind avoids an empty
+//! array.
+template <typename... TArguments>
+struct ArgumentKinds
+{
+    static constexpr ArgumentKind value[] = {ArgumentKindOf<std::decay_t<TArguments>>::value...,
+                                             ArgumentKind::String};
+};
+
+template <typename... TArguments>
+constexpr ArgumentKind ArgumentKinds<TArguments...>::value[];
+
+template <typename... TArguments>
+constexpr
+DescriptorInfo describe(const Descriptor<void(TArguments...)>& descriptor) noexcept
+{
+    return DescriptorInfo{descriptor.m_code, sizeof...(TArguments),
+                          ArgumentKinds<TArguments...>::value,
+                          &descriptor.m_explanation, descriptor.severity()};
+}
+
+constexpr
+std::size_t nextPowerOfTwo(std::size_t value) noexcept
+{
+    std::size_t result = 1;
+    while (result < value)
+        result *= 2;
+    return result;
+}
+
+constexpr
+std::uint64_t mixBits(std::uint64_t value) noexcept
+{
+    value ^= value >> 31;
+    value *= 0x7FB5D329728EA185ull;
+    value ^= value >> 27;
+    value *= 0x81DADEF4BC2DD44Dull;
+    value ^= value >> 33;
+    return value;
+}
+
+//! Hashes a \p code. A short code is hashed as a single word.
+constexpr
+std::uint64_t hashCode(const Code& code) noexcept
+{
+    return code.isShort()
+           ? mixBits(code[0])
+           : mixBits(code[0] ^ mixBits(code[1] + 0x9E3779B97F4A7C15ull));
+}
+
+//! Returns the slot of a code with the \p hash for a bucket \p displacement.
+constexpr
+std::size_t slotOf(std::uint64_t hash, std::uint32_t displacement, std::size_t tableSize) noexcept
+{
+    return std::size_t(mixBits(hash + displacement * 0x9E3779B97F4A7C15ull)) & (tableSize - 1);
+}
+
+//! Returns the bucket of a code with the \p hash.
+constexpr
+std::size_t bucketOf(std::uint64_t hash, std::size_t numBuckets) noexcept
+{
+    return std::size_t(hash >> 32) & (numBuckets - 1);
+}
+
+constexpr
+const DescriptorInfo* findDescriptor(const Code& code, const DescriptorInfo* slots,
+                                     std::size_t tableSize, const std::uint32_t* displacements,
+                                     std::size_t numBuckets) noexcept
+{
+    std::uint64_t hash = hashCode(code);
+    const DescriptorInfo& slot = slots[slotOf(hash, displacements[bucketOf(hash, numBuckets)],
+                                              tableSize)];
+    return slot.explanation && slot.code == code
+           ? &slot : nullptr;
+}
+
+} // namespace dime_detail
+
+//! \brief A type-erased reference to a DescriptorRegistry.
+class DescriptorRegistryView
+{
+public:
+    constexpr
+    DescriptorRegistryView(const DescriptorInfo* slots, std::size_t tableSize,
+                           const std::uint32_t* displacements, std::size_t numBuckets) noexcept
+        : m_slots(slots),
+          m_tableSize(tableSize),
+          m_displacements(displacements),
+          m_numBuckets(numBuckets)
+    {
+    }
+
+    //! \brief Returns the metadata of the descriptor with the \p code or a
+    //! null-pointer, if there is none.
+    constexpr
+    const DescriptorInfo* find(const Code& code) const noexcept
+    {
+        return dime_detail::findDescriptor(code, m_slots, m_tableSize,
+                                           m_displacements, m_numBuckets);
+    }
+
+private:
+    const DescriptorInfo* m_slots;
+    std::size_t m_tableSize;
+    const std::uint32_t* m_displacements;
+    std::size_t m_numBuckets;
+};
+
+//! \brief A registry of \p TSize descriptors keyed by their code.
+//!
+//! The registry uses a perfect hash with displacements: the hash of a code
+//! selects a bucket and the displacement of the bucket selects a slot,
+//! which holds at most one code. A lookup hashes the two words of the code
+//! once and compares a single slot.
+//!
+//! A registry is built from \p constexpr descriptors with
+//! makeDescriptorRegistry(). If the registry is \p constexpr, too, it needs
+//! no construction at run-time and duplicate codes are compilation errors:
+//!
+//!     constexpr Descriptor<void(int)> overheat("OVERHEAT", "{0} degrees");
+//!     constexpr Descriptor<void()> shutdown("SHUTDOWN", "shutting down");
+//!     constexpr auto registry = makeDescriptorRegistry(overheat, shutdown);
+template <std::size_t TSize>
+class DescriptorRegistry
+{
+public:
+    //! The number of slots.
+    static constexpr std::size_t tableSize = dime_detail::nextPowerOfTwo(2 * TSize);
+    //! The number of buckets.
+    static constexpr std::size_t numBuckets = dime_detail::nextPowerOfTwo(TSize);
+
+    //! \brief Creates a registry of the \p TSize descriptors described by
+    //! \p infos.
+    //!
+    //! Throws DuplicateDescriptorCode, if two descriptors have the same code.
+    constexpr explicit
+    DescriptorRegistry(const DescriptorInfo* infos)
+        : m_slots{},
+          m_displacements{}
+    {
+        for (std::size_t i = 0; i < TSize; ++i)
+            for (std::size_t j = i + 1; j < TSize; ++j)
+                if (infos[i].code == infos[j].code)
+                    throw DuplicateDescriptorCode();
+
+        std::uint64_t hashes[TSize > 0 ? TSize : 1] = {};
+        std::size_t bucketSizes[numBuckets] = {};
+        std::size_t maxBucketSize = 0;
+        for (std::size_t i = 0; i < TSize; ++i)
+        {
+            hashes[i] = dime_detail::hashCode(infos[i].code);
+            std::size_t& size = bucketSizes[dime_detail::bucketOf(hashes[i], numBuckets)];
+            if (++size > maxBucketSize)
+                maxBucketSize = size;
+        }
+
+        // Place the largest buckets first, while most slots are free.
+        std::size_t placed[TSize > 0 ? TSize : 1] = {};
+        for (std::size_t size = maxBucketSize; size > 0; --size)
+        {
+            for (std::size_t bucket = 0; bucket < numBuckets; ++bucket)
+            {
+                if (bucketSizes[bucket] != size)
+                    continue;
+                for (std::uint32_t displacement = 0;; ++displacement)
+                {
+                    if (displacement == maxDisplacement)
+                        throw PerfectHashNotFound();
+                    if (place(infos, hashes, bucket, displacement, placed))
+                    {
+                        m_displacements[bucket] = displacement;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    //! \brief Returns the metadata of the descriptor with the \p code or a
+    //! null-pointer, if there is none.
+    constexpr
+    const DescriptorInfo* find(const Code& code) const noexcept
+    {
+        return dime_detail::findDescriptor(code, m_slots, tableSize,
+                                           m_displacements, numBuckets);
+    }
+
+    //! \brief Returns a type-erased reference to this registry.
+    constexpr
+    DescriptorRegistryView view() const noexcept
+    {
+        return DescriptorRegistryView(m_slots, tableSize, m_displacements, numBuckets);
+    }
+
+private:
+    //! The number of displacements which are tried per bucket.
+    static constexpr std::uint32_t maxDisplacement = 1u << 16;
+
+    DescriptorInfo m_slots[tableSize];
+    std::uint32_t m_displacements[numBuckets];
+
+
+    //! Tries to place the descriptors of a \p bucket with a \p displacement.
+    //! \p placed is scratch space for the slots of the bucket.
+    constexpr
+    bool place(const DescriptorInfo* infos, const std::uint64_t* hashes,
+               std::size_t bucket, std::uint32_t displacement,
+               std::size_t* placed)
+    {
+        std::size_t numPlaced = 0;
+        for (std::size_t i = 0; i < TSize; ++i)
+        {
+            if (dime_detail::bucketOf(hashes[i], numBuckets) != bucket)
+                continue;
+            std::size_t slot = dime_detail::slotOf(hashes[i], displacement, tableSize);
+            if (m_slots[slot].explanation)
+            {
+                // Undo the placement of the bucket.
+                for (std::size_t idx = 0; idx < numPlaced; ++idx)
+                    m_slots[placed[idx]] = DescriptorInfo{};
+                return false;
+            }
+            m_slots[slot] = infos[i];
+            placed[numPlaced++] = slot;
+        }
+        return true;
+    }
+};
+
+template <std::size_t TSize>
+constexpr std::size_t DescriptorRegistry<TSize>::tableSize;
+
+template <std::size_t TSize>
+constexpr std::size_t DescriptorRegistry<TSize>::numBuckets;
+
+//! \brief Creates a registry of \p descriptors.
+//!
+//! The descriptors must outlive the registry. If they are \p constexpr, the
+//! registry can be \p constexpr, too.
+template <typename... TSignatures>
+constexpr
+DescriptorRegistry<sizeof...(TSignatures)>
+makeDescriptorRegistry(const Descriptor<TSignatures>&... descriptors)
+{
+    // The last entry avoids an empty array.
+    const DescriptorInfo infos[] = {dime_detail::describe(descriptors)..., DescriptorInfo{}};
+    return DescriptorRegistry<sizeof...(TSignatures)>(infos);
+}
+
+} // namespace dime
+
+#endif // DIME_REGISTRY_HPP
@@ -0,0 +1,122 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "ringallocator.hpp"
+
+#include <new>
+
+using namespace dime;
+
+
+RingAllocator::RingAllocator(std::size_t size)
+    : m_memory(nullptr),
+      m_numLines(size / DIME_CACHE_LINE_SIZE),
+      m_ownsMemory(true),
+      m_markers(new std::uint32_t[m_numLines]()),
+      m_head(0),
+      m_tail(0),
+      m_usedLines(0)
+{
+    m_memory = static_cast<char*>(Allocator::allocate(capacity()));
+}
+
+RingAllocator::RingAllocator(void* memory, std::size_t size)
+    : m_memory(static_cast<char*>(memory)),
+      m_numLines(size / DIME_CACHE_LINE_SIZE),
+      m_ownsMemory(false),
+      m_markers(new std::uint32_t[m_numLines]()),
+      m_head(0),
+      m_tail(0),
+      m_usedLines(0)
+{
+}
+
+RingAllocator::~RingAllocator()
+{
+    if (m_ownsMemory)
+        Allocator::deallocate(m_memory);
+}
+
+void* RingAllocator::allocate(std::size_t size)
+{
+    std::size_t numLines = (size + DIME_CACHE_LINE_SIZE - 1) / DIME_CACHE_LINE_SIZE;
+    if (numLines == 0)
+        numLines = 1;
+
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+
+    // Start over at the beginning of an empty ring to avoid padding.
+    if (m_usedLines == 0)
+        m_head = m_tail = 0;
+
+    // A block must not wrap around. If it does not fit in front of the end
+    // of the ring, the remaining lines are padded with a released block.
+    std::size_t padding = m_head + numLines > m_numLines ? m_numLines - m_head : 0;
+    if (m_usedLines + padding + numLines > m_numLines)
+        throw std::bad_alloc();
+
+    if (padding)
+    {
+        m_markers[m_head] = std::uint32_t(padding) | releasedFlag;
+        m_usedLines += padding;
+        m_head = 0;
+    }
+
+    void* block = m_memory + m_head * DIME_CACHE_LINE_SIZE;
+    m_markers[m_head] = std::uint32_t(numLines);
+    m_usedLines += numLines;
+    m_head += numLines;
+    if (m_head == m_numLines)
+        m_head = 0;
+    return block;
+}
+
+void RingAllocator::deallocate(void* p) noexcept
+{
+    std::size_t line = std::size_t(static_cast<char*>(p) - m_memory) / DIME_CACHE_LINE_SIZE;
+
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    m_markers[line] |= releasedFlag;
+
+    // Reclaim the oldest blocks as long as they have been released.
+    while (m_usedLines && (m_markers[m_tail] & releasedFlag))
+    {
+        std::size_t numLines = m_markers[m_tail] & ~releasedFlag;
+        m_markers[m_tail] = 0;
+        m_usedLines -= numLines;
+        m_tail += numLines;
+        if (m_tail == m_numLines)
+            m_tail = 0;
+    }
+}
+
+std::size_t RingAllocator::used() const noexcept
+{
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    return m_usedLines * DIME_CACHE_LINE_SIZE;
+}
@@ -0,0 +1,130 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_RINGALLOCATOR_HPP
+#define DIME_RINGALLOCATOR_HPP
+
+#include "config.hpp"
+#include "allocator.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef DIME_USE_WEOS
+#include <weos/memory.hpp>
+#include <weos/mutex.hpp>
+#else
+#include <memory>
+#include <mutex>
+#endif // DIME_USE_WEOS
+
+
+namespace dime
+{
+
+//! \brief An allocator for diagnostics which are freed in FIFO order.
+//!
+//! The ring allocator manages a contiguous circular buffer, which is split
+//! into cache lines. Blocks are allocated by bumping the head of the ring
+//! and reclaimed by advancing its tail. Consecutive diagnostics are thus
+//! placed next to each other in memory.
+//!
+//! For every cache line, a release marker records the length of the block
+//! which starts at this line and whether it has been released. When a
+//! block is released out of order, only its marker is set. The space is
+//! reclaimed as soon as all older blocks have been released, too.
+class RingAllocator : public Allocator
+{
+public:
+    //! \brief Creates a ring allocator with \p size bytes.
+    //!
+    //! The size is rounded down to a multiple of the cache line size.
+    explicit
+    RingAllocator(std::size_t size);
+
+    //! \brief Creates a ring allocator in external memory.
+    //!
+    //! Creates a ring allocator which manages the \p size bytes starting at
+    //! \p memory. The memory must be aligned to a cache line and must
+    //! outlive the allocator.
+    RingAllocator(void* memory, std::size_t size);
+
+    virtual
+    ~RingAllocator();
+
+    RingAllocator(const RingAllocator&) = delete;
+    RingAllocator& operator=(const RingAllocator&) = delete;
+
+    //! \brief Allocates a block at the head of the ring.
+    //!
+    //! Throws \p std::bad_alloc, if there is not enough contiguous space
+    //! between the head and the oldest block which is still in use.
+    virtual
+    void* allocate(std::size_t size) override;
+
+    //! \brief Releases a block.
+    virtual
+    void deallocate(void* p) noexcept override;
+
+    //! \brief Returns the capacity in bytes.
+    std::size_t capacity() const noexcept
+    {
+        return m_numLines * DIME_CACHE_LINE_SIZE;
+    }
+
+    //! \brief Returns the number of bytes which are in use.
+    //!
+    //! This includes the space of blocks which have been released out of
+    //! order and padding at the end of the ring.
+    std::size_t used() const noexcept;
+
+private:
+    //! Set in a marker if the block has been released.
+    static constexpr std::uint32_t releasedFlag = std::uint32_t(1) << 31;
+
+    mutable DIME_STD::mutex m_mutex;
+    //! The start of the ring.
+    char* m_memory;
+    //! The number of cache lines in the ring.
+    std::size_t m_numLines;
+    //! If set, the memory has been allocated by the ring allocator.
+    bool m_ownsMemory;
+    //! The release marker for every cache line. A non-zero marker denotes
+    //! the start of a block and holds its length in lines.
+    DIME_STD::unique_ptr<std::uint32_t[]> m_markers;
+    //! The line at which the next block will be allocated.
+    std::size_t m_head;
+    //! The first line of the oldest block.
+    std::size_t m_tail;
+    //! The number of lines between the tail and the head.
+    std::size_t m_usedLines;
+};
+
+} // namespace dime
+
+#endif // DIME_RINGALLOCATOR_HPP
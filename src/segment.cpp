@@ -0,0 +1,597 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "segment.hpp"
+
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+using namespace dime;
+using namespace dime_detail;
+
+namespace
+{
+
+//! Writes to a bounded buffer and remembers if the buffer overflowed.
+class Output
+{
+public:
+    Output(unsigned char* begin, unsigned char* end) noexcept
+        : m_iter(begin),
+          m_end(end),
+          m_overflow(false)
+    {
+    }
+
+    void writeByte(unsigned value) noexcept
+    {
+        if (reserve(1))
+            *m_iter++ = static_cast<unsigned char>(value);
+    }
+
+    void writeLittleEndian(std::uint64_t value, unsigned numBytes) noexcept
+    {
+        if (reserve(numBytes))
+            m_iter = dime_detail::writeLittleEndian(m_iter, value, numBytes);
+    }
+
+    void writeVarint(std::uint64_t value) noexcept
+    {
+        if (reserve(varintSize(value)))
+            m_iter = dime_detail::writeVarint(m_iter, value);
+    }
+
+    void writeBytes(const void* data, std::size_t size) noexcept
+    {
+        if (reserve(size))
+        {
+            std::memcpy(m_iter, data, size);
+            m_iter += size;
+        }
+    }
+
+    unsigned char* position() const noexcept
+    {
+        return m_iter;
+    }
+
+    bool overflow() const noexcept
+    {
+        return m_overflow;
+    }
+
+private:
+    unsigned char* m_iter;
+    unsigned char* m_end;
+    bool m_overflow;
+
+    bool reserve(std::size_t size) noexcept
+    {
+        if (m_overflow || std::size_t(m_end - m_iter) < size)
+        {
+            m_overflow = true;
+            return false;
+        }
+        return true;
+    }
+};
+
+//! Writes the XOR of two floating-point values without its leading and
+//! trailing zero bytes.
+void writeXor(Output& output, std::uint64_t bits, unsigned numBytes) noexcept
+{
+    unsigned leading = 0;
+    unsigned trailing = 0;
+    if (bits == 0)
+    {
+        leading = numBytes;
+    }
+    else
+    {
+        while (((bits >> (8 * (numBytes - 1 - leading))) & 0xFF) == 0)
+            ++leading;
+        while (((bits >> (8 * trailing)) & 0xFF) == 0)
+            ++trailing;
+    }
+    output.writeByte((leading << 4) | trailing);
+    if (leading + trailing < numBytes)
+        output.writeLittleEndian(bits >> (8 * trailing), numBytes - leading - trailing);
+}
+
+bool readXor(const unsigned char*& src, const unsigned char* end,
+             std::uint64_t& bits, unsigned numBytes) noexcept
+{
+    if (src == end)
+        return false;
+    unsigned leading = *src >> 4;
+    unsigned trailing = *src & 0x0F;
+    ++src;
+    if (leading + trailing > numBytes
+        || std::size_t(end - src) < numBytes - leading - trailing)
+    {
+        return false;
+    }
+
+    bits = 0;
+    if (leading + trailing < numBytes)
+    {
+        bits = readLittleEndian(src, numBytes - leading - trailing) << (8 * trailing);
+        src += numBytes - leading - trailing;
+    }
+    return true;
+}
+
+//! The previous value of an argument of a shape in the compressor.
+struct EncoderSlot
+{
+    std::uint64_t bits = 0;
+    const char* string = nullptr;
+    std::size_t stringSize = 0;
+};
+
+void writeArgument(Output& output, const ArgumentView& argument, EncoderSlot& slot) noexcept
+{
+    switch (argument.kind())
+    {
+    case ArgumentKind::SignedInteger:
+    case ArgumentKind::UnsignedInteger:
+    {
+        std::int64_t value = argument.kind() == ArgumentKind::SignedInteger
+                             ? std::int64_t(argument.toInteger().value())
+                             : std::int64_t(argument.toUnsigned().value());
+        output.writeVarint(zigZagEncode(value - std::int64_t(slot.bits)));
+        slot.bits = std::uint64_t(value);
+        break;
+    }
+    case ArgumentKind::Float:
+    {
+        float value = argument.toFloat().value();
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, 4);
+        writeXor(output, bits ^ slot.bits, 4);
+        slot.bits = bits;
+        break;
+    }
+    case ArgumentKind::Double:
+    {
+        double value = argument.toDouble().value();
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, 8);
+        writeXor(output, bits ^ slot.bits, 8);
+        slot.bits = bits;
+        break;
+    }
+    case ArgumentKind::LongDouble:
+        output.writeByte(unsigned(argument.size()));
+        output.writeBytes(argument.data(), argument.size());
+        break;
+    case ArgumentKind::String:
+    {
+        const char* data = argument.stringData();
+        std::size_t size = argument.stringSize();
+        if (slot.string && size == slot.stringSize
+            && std::memcmp(data, slot.string, size) == 0)
+        {
+            output.writeVarint(0);
+        }
+        else
+        {
+            output.writeVarint(size + 1);
+            output.writeBytes(data, size);
+            slot.string = data;
+            slot.stringSize = size;
+        }
+        break;
+    }
+    }
+}
+
+} // anonymous namespace
+
+
+void BlockHeader::write(unsigned char* dest) const noexcept
+{
+    unsigned char* iter = writeLittleEndian(dest, blockMagic, 4);
+    *iter++ = blockVersion;
+    *iter++ = flags;
+    iter = writeLittleEndian(iter, 0, 2);
+    iter = writeLittleEndian(iter, payloadSize, 4);
+    iter = writeLittleEndian(iter, numRecords, 4);
+    iter = writeLittleEndian(iter, std::uint64_t(baseTimeStamp), 8);
+    writeLittleEndian(iter, crc32(dest, std::size_t(iter - dest)), 4);
+}
+
+bool BlockHeader::read(const unsigned char* src) noexcept
+{
+    if (readLittleEndian(src, 4) != blockMagic || src[4] != blockVersion
+        || readLittleEndian(src + 24, 4) != crc32(src, 24))
+    {
+        return false;
+    }
+    flags = src[5];
+    payloadSize = std::uint32_t(readLittleEndian(src + 8, 4));
+    numRecords = std::uint32_t(readLittleEndian(src + 12, 4));
+    baseTimeStamp = std::int64_t(readLittleEndian(src + 16, 8));
+    return true;
+}
+
+BlockWriter::BlockWriter(void* buffer, std::size_t size) noexcept
+    : m_buffer(static_cast<unsigned char*>(buffer)),
+      m_capacity(size),
+      m_size(blockHeaderSize),
+      m_previous(0)
+{
+}
+
+bool BlockWriter::append(const Diagnostic& diagnostic) noexcept
+{
+    if (m_size >= m_capacity)
+        return false;
+
+    std::int64_t timeStamp = toNanoseconds(diagnostic.timeStamp());
+    if (m_header.numRecords == 0)
+        m_header.baseTimeStamp = m_previous = timeStamp;
+
+    std::size_t size = encode(diagnostic, m_previous, m_buffer + m_size,
+                              m_capacity - m_size);
+    if (size == 0)
+        return false;
+
+    m_size += size;
+    m_previous = timeStamp;
+    ++m_header.numRecords;
+    return true;
+}
+
+std::size_t BlockWriter::finish() noexcept
+{
+    m_header.payloadSize = std::uint32_t(m_size - blockHeaderSize);
+    m_header.write(m_buffer);
+    return m_size;
+}
+
+void BlockWriter::reset() noexcept
+{
+    m_size = blockHeaderSize;
+    m_previous = 0;
+    m_header = BlockHeader();
+}
+
+bool SegmentReader::next(BlockHeader& header, const unsigned char*& payload) noexcept
+{
+    std::size_t remaining = m_size - m_offset;
+    if (remaining == 0)
+        return false;
+    if (remaining < blockHeaderSize)
+    {
+        m_status = Status::Truncated;
+        return false;
+    }
+    if (!header.read(m_data + m_offset))
+    {
+        m_status = Status::Corrupt;
+        return false;
+    }
+    if (header.payloadSize > remaining - blockHeaderSize)
+    {
+        m_status = Status::Truncated;
+        return false;
+    }
+
+    payload = m_data + m_offset + blockHeaderSize;
+    m_offset += blockHeaderSize + header.payloadSize;
+    return true;
+}
+
+std::size_t dime::compressBlock(const unsigned char* block, std::size_t size,
+                                unsigned char* dest, std::size_t capacity)
+{
+    BlockHeader header;
+    if (size < blockHeaderSize || capacity < blockHeaderSize
+        || !header.read(block) || (header.flags & BlockCompressed) != 0
+        || blockHeaderSize + header.payloadSize != size)
+    {
+        return 0;
+    }
+
+    // Collect the shapes, which are keyed by the code and the argument kinds.
+    std::unordered_map<std::string, unsigned> shapeIndices;
+    std::vector<RecordView> shapes;
+    std::vector<unsigned> recordShapes;
+    std::vector<std::size_t> firstSlots;
+    std::string key;
+    RecordReader reader(block + blockHeaderSize, header.payloadSize);
+    RecordView view;
+    while (reader.next(view))
+    {
+        if ((view.flags() & ~(RecordDroppable | RecordShortCode)) != 0)
+            return 0;
+
+        key.assign(reinterpret_cast<const char*>(view.code().data), 16);
+        key += char(view.numArguments());
+        for (unsigned idx = 0; idx < view.numArguments(); ++idx)
+            key += char(view.argument(idx).kind());
+
+        auto result = shapeIndices.emplace(key, unsigned(shapes.size()));
+        if (result.second)
+        {
+            firstSlots.push_back(firstSlots.empty()
+                                 ? 0
+                                 : firstSlots.back() + shapes.back().numArguments());
+            shapes.push_back(view);
+        }
+        recordShapes.push_back(result.first->second);
+    }
+    if (reader.status() != RecordReader::Status::Ok
+        || recordShapes.size() != header.numRecords)
+    {
+        return 0;
+    }
+
+    Output output(dest + blockHeaderSize, dest + capacity);
+    output.writeVarint(shapes.size());
+    for (const RecordView& shape : shapes)
+    {
+        output.writeLittleEndian(shape.code()[0], 8);
+        output.writeLittleEndian(shape.code()[1], 8);
+        output.writeByte(shape.numArguments());
+        for (unsigned idx = 0; idx < shape.numArguments(); ++idx)
+            output.writeByte(unsigned(shape.argument(idx).kind()));
+    }
+
+    std::vector<EncoderSlot> slots(firstSlots.empty()
+                                   ? 0
+                                   : firstSlots.back() + shapes.back().numArguments());
+    std::int64_t timeStamp = header.baseTimeStamp;
+    std::int64_t delta = 0;
+    std::uint32_t uniqueId = 0;
+    reader = RecordReader(block + blockHeaderSize, header.payloadSize);
+    for (unsigned shape : recordShapes)
+    {
+        reader.next(view);
+        std::int64_t nextTimeStamp = view.timeStamp(timeStamp);
+        std::int64_t nextDelta = nextTimeStamp - timeStamp;
+        output.writeVarint((std::uint64_t(shape) << 1) | (view.droppable() ? 1 : 0));
+        output.writeVarint(zigZagEncode(nextDelta - delta));
+        output.writeVarint(zigZagEncode(std::int64_t(view.uniqueId()) - std::int64_t(uniqueId)));
+        for (unsigned idx = 0; idx < view.numArguments(); ++idx)
+            writeArgument(output, view.argument(idx), slots[firstSlots[shape] + idx]);
+        if (output.overflow())
+            return 0;
+
+        timeStamp = nextTimeStamp;
+        delta = nextDelta;
+        uniqueId = view.uniqueId();
+    }
+
+    unsigned char* payload = dest + blockHeaderSize;
+    std::size_t payloadSize = std::size_t(output.position() - payload);
+    output.writeLittleEndian(crc32(payload, payloadSize), 4);
+    if (output.overflow())
+        return 0;
+
+    header.flags |= BlockCompressed;
+    header.payloadSize = std::uint32_t(payloadSize + 4);
+    header.write(dest);
+    return blockHeaderSize + header.payloadSize;
+}
+
+BlockRecordReader::BlockRecordReader(const BlockHeader& header, const unsigned char* payload)
+    : m_reader(payload, (header.flags & BlockCompressed) != 0 ? 0 : header.payloadSize),
+      m_timeStamp(header.baseTimeStamp),
+      m_compressed((header.flags & BlockCompressed) != 0),
+      m_status(RecordReader::Status::Ok),
+      m_iter(payload),
+      m_end(payload + header.payloadSize),
+      m_numRemaining(header.numRecords),
+      m_delta(0),
+      m_uniqueId(0)
+{
+    if (!m_compressed)
+        return;
+
+    if (header.payloadSize < 4
+        || crc32(payload, header.payloadSize - 4) != readLittleEndian(m_end - 4, 4))
+    {
+        m_status = RecordReader::Status::Corrupt;
+        m_numRemaining = 0;
+        return;
+    }
+    m_end -= 4;
+    if (!readDictionary())
+    {
+        m_status = RecordReader::Status::Corrupt;
+        m_numRemaining = 0;
+    }
+}
+
+bool BlockRecordReader::readDictionary()
+{
+    std::uint64_t numShapes;
+    if (!readVarint(m_iter, m_end, numShapes) || numShapes > std::uint64_t(m_end - m_iter))
+        return false;
+
+    m_shapes.reserve(std::size_t(numShapes));
+    for (std::uint64_t count = 0; count < numShapes; ++count)
+    {
+        if (m_end - m_iter < 17)
+            return false;
+        Shape shape;
+        shape.code.data[0] = readLittleEndian(m_iter, 8);
+        shape.code.data[1] = readLittleEndian(m_iter + 8, 8);
+        shape.numArguments = m_iter[16];
+        m_iter += 17;
+        if (std::size_t(m_end - m_iter) < shape.numArguments)
+            return false;
+        shape.kinds = m_iter;
+        for (unsigned idx = 0; idx < shape.numArguments; ++idx)
+            if (m_iter[idx] > unsigned(ArgumentKind::String))
+                return false;
+        m_iter += shape.numArguments;
+        shape.firstSlot = m_slots.size();
+        m_slots.resize(m_slots.size() + shape.numArguments, Slot{0, nullptr, 0});
+        m_shapes.push_back(shape);
+    }
+    return true;
+}
+
+bool BlockRecordReader::decode(RecordView& view)
+{
+    if (m_status != RecordReader::Status::Ok)
+        return false;
+    if (m_numRemaining == 0)
+    {
+        if (m_iter != m_end)
+            m_status = RecordReader::Status::Corrupt;
+        return false;
+    }
+
+    std::uint64_t value;
+    std::uint64_t deltaOfDelta;
+    std::uint64_t uniqueIdDelta;
+    if (!readVarint(m_iter, m_end, value) || (value >> 1) >= m_shapes.size()
+        || !readVarint(m_iter, m_end, deltaOfDelta)
+        || !readVarint(m_iter, m_end, uniqueIdDelta))
+    {
+        m_status = RecordReader::Status::Corrupt;
+        return false;
+    }
+    const Shape& shape = m_shapes[std::size_t(value >> 1)];
+    bool droppable = (value & 1) != 0;
+    m_delta += zigZagDecode(deltaOfDelta);
+    m_uniqueId += std::uint32_t(zigZagDecode(uniqueIdDelta));
+
+    // Decode the arguments into their slots and compute the size of the
+    // body in the record format.
+    std::uint64_t encodedDelta = zigZagEncode(m_delta);
+    std::size_t bodySize = 1 + (shape.code.isShort() ? 8 : 16) + varintSize(encodedDelta)
+                           + 4 + 1 + shape.numArguments;
+    for (unsigned idx = 0; idx < shape.numArguments; ++idx)
+    {
+        Slot& slot = m_slots[shape.firstSlot + idx];
+        bool valid = true;
+        switch (ArgumentKind(shape.kinds[idx]))
+        {
+        case ArgumentKind::SignedInteger:
+        case ArgumentKind::UnsignedInteger:
+            valid = readVarint(m_iter, m_end, value);
+            slot.bits = std::uint64_t(std::int64_t(slot.bits) + zigZagDecode(value));
+            bodySize += 4;
+            break;
+        case ArgumentKind::Float:
+            valid = readXor(m_iter, m_end, value, 4);
+            slot.bits ^= value;
+            bodySize += 4;
+            break;
+        case ArgumentKind::Double:
+            valid = readXor(m_iter, m_end, value, 8);
+            slot.bits ^= value;
+            bodySize += 8;
+            break;
+        case ArgumentKind::LongDouble:
+            valid = m_iter != m_end && std::size_t(m_end - m_iter) > *m_iter;
+            if (valid)
+            {
+                slot.stringSize = *m_iter++;
+                slot.string = m_iter;
+                m_iter += slot.stringSize;
+                bodySize += 1 + slot.stringSize;
+            }
+            break;
+        case ArgumentKind::String:
+            valid = readVarint(m_iter, m_end, value)
+                    && (value != 0 || slot.string)
+                    && (value == 0 || value - 1 <= std::uint64_t(m_end - m_iter));
+            if (!valid)
+                break;
+            if (value != 0)
+            {
+                slot.string = m_iter;
+                slot.stringSize = std::size_t(value - 1);
+                m_iter += slot.stringSize;
+            }
+            bodySize += varintSize(slot.stringSize) + slot.stringSize;
+            break;
+        }
+        if (!valid)
+        {
+            m_status = RecordReader::Status::Corrupt;
+            return false;
+        }
+    }
+
+    // Rebuild the body. The buffer only grows, so that it is allocated
+    // once for most blocks.
+    if (m_body.size() < bodySize)
+        m_body.resize(bodySize);
+    unsigned char* iter = m_body.data();
+    *iter++ = (droppable ? RecordDroppable : 0)
+              | (shape.code.isShort() ? RecordShortCode : 0);
+    iter = writeLittleEndian(iter, shape.code[0], 8);
+    if (!shape.code.isShort())
+        iter = writeLittleEndian(iter, shape.code[1], 8);
+    iter = writeVarint(iter, encodedDelta);
+    iter = writeLittleEndian(iter, m_uniqueId, 4);
+    *iter++ = static_cast<unsigned char>(shape.numArguments);
+    std::memcpy(iter, shape.kinds, shape.numArguments);
+    iter += shape.numArguments;
+    for (unsigned idx = 0; idx < shape.numArguments; ++idx)
+    {
+        const Slot& slot = m_slots[shape.firstSlot + idx];
+        switch (ArgumentKind(shape.kinds[idx]))
+        {
+        case ArgumentKind::SignedInteger:
+        case ArgumentKind::UnsignedInteger:
+        case ArgumentKind::Float:
+            iter = writeLittleEndian(iter, slot.bits, 4);
+            break;
+        case ArgumentKind::Double:
+            iter = writeLittleEndian(iter, slot.bits, 8);
+            break;
+        case ArgumentKind::LongDouble:
+            *iter++ = static_cast<unsigned char>(slot.stringSize);
+            std::memcpy(iter, slot.string, slot.stringSize);
+            iter += slot.stringSize;
+            break;
+        case ArgumentKind::String:
+            iter = writeVarint(iter, slot.stringSize);
+            std::memcpy(iter, slot.string, slot.stringSize);
+            iter += slot.stringSize;
+            break;
+        }
+    }
+
+    if (!view.parse(m_body.data(), bodySize))
+    {
+        m_status = RecordReader::Status::Corrupt;
+        return false;
+    }
+    --m_numRemaining;
+    return true;
+}
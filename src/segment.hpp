@@ -0,0 +1,324 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_SEGMENT_HPP
+#define DIME_SEGMENT_HPP
+
+#include "diagnostic.hpp"
+#include "wireformat.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace dime
+{
+
+// Binary log segments
+// ===================
+//
+// A segment is a sequence of blocks. Every block starts with a header,
+// which is followed by the payload. All integers are little-endian.
+//
+//     u32   magic "DIMB"
+//     u8    version
+//     u8    flags (BlockFlags)
+//     u16   reserved
+//     u32   size of the payload in bytes
+//     u32   number of records
+//     i64   base time stamp in ns
+//     u32   CRC-32 of the preceding header bytes
+//
+// The payload of an uncompressed block is a sequence of records in the
+// wire format. The time stamp of the first record is relative to the base
+// time stamp of the block, every further one is relative to its
+// predecessor. Thus, blocks can be decoded independently of each other.
+//
+// The payload of a compressed block starts with a dictionary of the shapes
+// of its records. A shape is a code together with the kinds of the
+// arguments.
+//
+//     varint  number of shapes
+//     per shape:
+//       u64   first word of the code
+//       u64   second word of the code
+//       u8    number of arguments
+//       u8    kind of every argument
+//
+// The dictionary always holds both words of a code. A record with a short
+// code is decoded with the RecordShortCode flag, i.e. as it was encoded.
+//
+// The dictionary is followed by the records and a checksum.
+//
+//     per record:
+//       varint  index of the shape << 1 | droppable
+//       varint  time stamp delta-of-delta in ns (zig-zag encoded)
+//       varint  unique ID minus the previous one (zig-zag encoded)
+//       ...     payload of every argument
+//     u32       CRC-32 of the preceding payload bytes
+//
+// The time stamp delta of a record is the difference to its predecessor
+// (the base time stamp for the first record), the delta-of-delta is the
+// difference of two successive deltas. Arguments are encoded relative to
+// the argument at the same position in the previous record with the same
+// shape (or zero):
+// - SignedInteger, UnsignedInteger: difference as zig-zag varint
+// - Float, Double: the XOR of the bits as a control byte, which holds the
+//   number of leading zero bytes in the upper and the number of trailing
+//   zero bytes in the lower nibble, followed by the remaining bytes
+// - LongDouble: as in the record format
+// - String: varint 0, if equal to the previous string, or the length plus
+//   one followed by the characters
+
+//! \brief Flags in the header of a block.
+enum BlockFlags : std::uint8_t
+{
+    //! Set if the payload is compressed.
+    BlockCompressed = 0x01
+};
+
+//! The magic number at the start of every block.
+constexpr std::uint32_t blockMagic = 0x424D4944;
+//! The version of the block format.
+constexpr std::uint8_t blockVersion = 1;
+//! The size of a block header in bytes.
+constexpr std::size_t blockHeaderSize = 28;
+
+//! \brief The header of a block.
+struct BlockHeader
+{
+    std::uint8_t flags = 0;
+    std::uint32_t payloadSize = 0;
+    std::uint32_t numRecords = 0;
+    std::int64_t baseTimeStamp = 0;
+
+    //! \brief Writes the header to the \p blockHeaderSize bytes at \p dest.
+    void write(unsigned char* dest) const noexcept;
+
+    //! \brief Reads the header from the \p blockHeaderSize bytes at \p src.
+    //!
+    //! Returns \p false, if the magic number, the version or the checksum
+    //! do not match.
+    bool read(const unsigned char* src) noexcept;
+};
+
+//! \brief Builds an uncompressed block in a buffer.
+//!
+//! The writer appends records after the space for the header. The header
+//! is written by finish().
+class BlockWriter
+{
+public:
+    //! \brief Creates a writer for the \p size bytes at \p buffer.
+    BlockWriter(void* buffer, std::size_t size) noexcept;
+
+    //! \brief Appends the record of a \p diagnostic.
+    //!
+    //! Returns \p false, if the block has no room for the record.
+    bool append(const Diagnostic& diagnostic) noexcept;
+
+    //! \brief Writes the header.
+    //!
+    //! Writes the header of the block and returns the size of the block.
+    std::size_t finish() noexcept;
+
+    //! \brief Discards all records.
+    void reset() noexcept;
+
+    //! \brief Checks if the block holds no records.
+    bool empty() const noexcept
+    {
+        return m_header.numRecords == 0;
+    }
+
+    //! \brief Returns the current size of the block including the header.
+    std::size_t size() const noexcept
+    {
+        return m_size;
+    }
+
+    //! \brief Returns the capacity of the block.
+    std::size_t capacity() const noexcept
+    {
+        return m_capacity;
+    }
+
+    //! \brief Returns the header as it will be written.
+    const BlockHeader& header() const noexcept
+    {
+        return m_header;
+    }
+
+    //! \brief Returns the time stamp of the last record.
+    std::int64_t lastTimeStamp() const noexcept
+    {
+        return m_previous;
+    }
+
+    //! \brief Returns the start of the block.
+    unsigned char* data() const noexcept
+    {
+        return m_buffer;
+    }
+
+private:
+    unsigned char* m_buffer;
+    std::size_t m_capacity;
+    std::size_t m_size;
+    std::int64_t m_previous;
+    BlockHeader m_header;
+};
+
+//! \brief Reads the blocks of a segment from a byte span.
+class SegmentReader
+{
+public:
+    enum class Status
+    {
+        //! All blocks so far have been valid.
+        Ok,
+        //! The data ends in the middle of a block.
+        Truncated,
+        //! A block header is invalid.
+        Corrupt
+    };
+
+    //! \brief Creates a reader for the \p size bytes at \p data.
+    SegmentReader(const void* data, std::size_t size) noexcept
+        : m_data(static_cast<const unsigned char*>(data)),
+          m_size(size),
+          m_offset(0),
+          m_status(Status::Ok)
+    {
+    }
+
+    //! \brief Reads the next block.
+    //!
+    //! Fills the \p header and sets \p payload to the start of the payload.
+    //! Returns \p false at the end of the data or if the block is invalid.
+    bool next(BlockHeader& header, const unsigned char*& payload) noexcept;
+
+    //! \brief Returns the offset of the next block.
+    std::size_t offset() const noexcept
+    {
+        return m_offset;
+    }
+
+    //! \brief Returns the status of the reader.
+    Status status() const noexcept
+    {
+        return m_status;
+    }
+
+private:
+    const unsigned char* m_data;
+    std::size_t m_size;
+    std::size_t m_offset;
+    Status m_status;
+};
+
+//! \brief Compresses a block.
+//!
+//! Reads the finished, uncompressed block of \p size bytes at \p block and
+//! writes a compressed block to the \p capacity bytes at \p dest. Returns
+//! the size of the compressed block. Returns zero, if the compressed block
+//! does not fit or if the block cannot be compressed.
+std::size_t compressBlock(const unsigned char* block, std::size_t size,
+                          unsigned char* dest, std::size_t capacity);
+
+//! \brief Reads the records of a block.
+//!
+//! The reader resolves the chained time stamps into absolute ones. The
+//! records of a compressed block are decoded one at a time into a buffer
+//! of the reader. Thus, a view is only valid until the next call to next().
+class BlockRecordReader
+{
+public:
+    BlockRecordReader(const BlockHeader& header, const unsigned char* payload);
+
+    //! \brief Reads the next record.
+    //!
+    //! Fills the \p view and sets \p timeStamp to the absolute time stamp of
+    //! the record in nanoseconds. Returns \p false at the end of the block or
+    //! if the record is invalid.
+    bool next(RecordView& view, std::int64_t& timeStamp)
+    {
+        if (!(m_compressed ? decode(view) : m_reader.next(view)))
+            return false;
+        m_timeStamp = view.timeStamp(m_timeStamp);
+        timeStamp = m_timeStamp;
+        return true;
+    }
+
+    //! \brief Returns the status of the reader.
+    RecordReader::Status status() const noexcept
+    {
+        return m_compressed ? m_status : m_reader.status();
+    }
+
+private:
+    struct Shape
+    {
+        Code code;
+        unsigned numArguments;
+        const unsigned char* kinds;
+        //! The index of the slot of the first argument.
+        std::size_t firstSlot;
+    };
+
+    //! The previous value of an argument of a shape.
+    struct Slot
+    {
+        std::uint64_t bits;
+        const unsigned char* string;
+        std::size_t stringSize;
+    };
+
+    RecordReader m_reader;
+    std::int64_t m_timeStamp;
+    bool m_compressed;
+
+    // The state of the decoder of a compressed block.
+    RecordReader::Status m_status;
+    const unsigned char* m_iter;
+    const unsigned char* m_end;
+    std::uint32_t m_numRemaining;
+    std::int64_t m_delta;
+    std::uint32_t m_uniqueId;
+    std::vector<Shape> m_shapes;
+    std::vector<Slot> m_slots;
+    std::vector<unsigned char> m_body;
+
+    bool readDictionary();
+    bool decode(RecordView& view);
+};
+
+} // namespace dime
+
+#endif // DIME_SEGMENT_HPP
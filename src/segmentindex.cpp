@@ -0,0 +1,218 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "segmentindex.hpp"
+#include "wireformat.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace dime;
+using namespace dime_detail;
+
+namespace
+{
+
+//! The number of bits which are set per prefix.
+constexpr unsigned numHashes = 3;
+constexpr unsigned numBits = CodeFilter::numWords * 64;
+
+std::uint64_t symbolMask(unsigned numSymbols)
+{
+    return numSymbols >= 10 ? (std::uint64_t(1) << 60) - 1
+                            : (std::uint64_t(1) << (numSymbols * 6)) - 1;
+}
+
+//! Returns the longest prefix length not above \p length, which is inserted
+//! into a filter. Only the lengths 1, 2, 4, 8 and 16 are inserted.
+unsigned filterLength(unsigned length)
+{
+    unsigned result = 0;
+    for (unsigned candidate = 1; candidate <= length && candidate <= 16; candidate *= 2)
+        result = candidate;
+    return result;
+}
+
+std::uint64_t hashPrefix(const Code& prefix, unsigned length)
+{
+    std::uint64_t hash = prefix[0] ^ (prefix[1] << 4) ^ (prefix[1] >> 60)
+                         ^ (std::uint64_t(length) << 59);
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EB;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+} // anonymous namespace
+
+
+unsigned dime::codeLength(const Code& code) noexcept
+{
+    // The padding symbol '-' may also occur within a code, so the length
+    // is given by the last symbol which is not padding.
+    for (unsigned idx = 20; idx > 0; --idx)
+        if (((code[(idx - 1) / 10] >> (((idx - 1) % 10) * 6)) & 0x3F) != 0)
+            return idx;
+    return 0;
+}
+
+Code dime::codePrefix(const Code& code, unsigned length) noexcept
+{
+    return Code{code[0] & symbolMask(length),
+                code[1] & symbolMask(length > 10 ? length - 10 : 0)};
+}
+
+unsigned dime::literalPrefix(const char* pattern, Code& prefix) noexcept
+{
+    std::size_t length = std::strcspn(pattern, "*?");
+    if (!parseCode(pattern, length, prefix))
+    {
+        prefix = Code{0, 0};
+        return 0;
+    }
+    return unsigned(length);
+}
+
+void CodeFilter::insert(const Code& code) noexcept
+{
+    unsigned length = codeLength(code);
+    for (unsigned prefixLength = 1; prefixLength <= length; prefixLength *= 2)
+    {
+        std::uint64_t hash = hashPrefix(codePrefix(code, prefixLength), prefixLength);
+        for (unsigned count = 0; count < numHashes; ++count, hash >>= 9)
+            words[(hash % numBits) / 64] |= std::uint64_t(1) << (hash % 64);
+    }
+}
+
+bool CodeFilter::mayContain(const Code& prefix, unsigned length) const noexcept
+{
+    // Trailing padding symbols of the prefix also match shorter codes.
+    // A matching code is at least as long as the remaining prefix and thus
+    // has inserted the longest filter length within it.
+    length = filterLength(std::min(length, codeLength(prefix)));
+    if (length == 0)
+        return true;
+
+    std::uint64_t hash = hashPrefix(codePrefix(prefix, length), length);
+    for (unsigned count = 0; count < numHashes; ++count, hash >>= 9)
+        if ((words[(hash % numBits) / 64] & (std::uint64_t(1) << (hash % 64))) == 0)
+            return false;
+    return true;
+}
+
+void CodeFilter::merge(const CodeFilter& other) noexcept
+{
+    for (unsigned idx = 0; idx < numWords; ++idx)
+        words[idx] |= other.words[idx];
+}
+
+void CodeFilter::clear() noexcept
+{
+    for (unsigned idx = 0; idx < numWords; ++idx)
+        words[idx] = 0;
+}
+
+void IndexEntry::write(unsigned char* dest) const noexcept
+{
+    unsigned char* iter = writeLittleEndian(dest, offset, 8);
+    iter = writeLittleEndian(iter, size, 4);
+    iter = writeLittleEndian(iter, numRecords, 4);
+    iter = writeLittleEndian(iter, std::uint64_t(minTimeStamp), 8);
+    iter = writeLittleEndian(iter, std::uint64_t(maxTimeStamp), 8);
+    for (unsigned idx = 0; idx < CodeFilter::numWords; ++idx)
+        iter = writeLittleEndian(iter, codes.words[idx], 8);
+    writeLittleEndian(iter, crc32(dest, std::size_t(iter - dest)), 4);
+}
+
+bool IndexEntry::read(const unsigned char* src) noexcept
+{
+    if (readLittleEndian(src + encodedSize - 4, 4) != crc32(src, encodedSize - 4))
+        return false;
+
+    offset = readLittleEndian(src, 8);
+    size = std::uint32_t(readLittleEndian(src + 8, 4));
+    numRecords = std::uint32_t(readLittleEndian(src + 12, 4));
+    minTimeStamp = std::int64_t(readLittleEndian(src + 16, 8));
+    maxTimeStamp = std::int64_t(readLittleEndian(src + 24, 8));
+    for (unsigned idx = 0; idx < CodeFilter::numWords; ++idx)
+        codes.words[idx] = readLittleEndian(src + 32 + 8 * idx, 8);
+    return true;
+}
+
+void dime::writeIndexHeader(unsigned char* dest) noexcept
+{
+    unsigned char* iter = writeLittleEndian(dest, indexMagic, 4);
+    *iter++ = indexVersion;
+    writeLittleEndian(iter, 0, 3);
+}
+
+std::string dime::indexPath(const char* segmentPath)
+{
+    return std::string(segmentPath) + ".idx";
+}
+
+IndexReader::IndexReader(const void* data, std::size_t size) noexcept
+    : m_data(static_cast<const unsigned char*>(data)),
+      m_size(size),
+      m_offset(indexHeaderSize),
+      m_status(Status::Ok)
+{
+    if (size < indexHeaderSize)
+    {
+        m_status = Status::Truncated;
+        m_offset = size;
+    }
+    else if (readLittleEndian(m_data, 4) != indexMagic || m_data[4] != indexVersion)
+    {
+        m_status = Status::Corrupt;
+        m_offset = size;
+    }
+}
+
+bool IndexReader::next(IndexEntry& entry) noexcept
+{
+    std::size_t remaining = m_size - m_offset;
+    if (remaining == 0)
+        return false;
+    if (remaining < IndexEntry::encodedSize)
+    {
+        m_status = Status::Truncated;
+        return false;
+    }
+    if (!entry.read(m_data + m_offset))
+    {
+        m_status = Status::Corrupt;
+        m_offset = m_size;
+        return false;
+    }
+
+    m_offset += IndexEntry::encodedSize;
+    return true;
+}
@@ -0,0 +1,194 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_SEGMENTINDEX_HPP
+#define DIME_SEGMENTINDEX_HPP
+
+#include "code.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+namespace dime
+{
+
+// Segment indexes
+// ===============
+//
+// A segment index is a sidecar file, which a FileSink appends to after
+// every batch of blocks. It starts with a header, which is followed by one
+// entry per block. All integers are little-endian.
+//
+//     u32   magic "DIMX"
+//     u8    version
+//     u8[3] reserved
+//
+// Every entry is laid out as
+//
+//     u64   offset of the block in the segment
+//     u32   size of the block including its header
+//     u32   number of records
+//     i64   smallest time stamp in ns
+//     i64   largest time stamp in ns
+//     u64[] code filter (CodeFilter::numWords words)
+//     u32   CRC-32 of the preceding entry bytes
+//
+// The entries are checkpoints which map time ranges to offsets. Together
+// with the filter of the codes in a block, a query can skip all blocks
+// which cannot hold a matching record. An index need not cover a segment
+// completely. Blocks without an entry have to be scanned.
+
+//! The magic number at the start of an index.
+constexpr std::uint32_t indexMagic = 0x584D4944;
+//! The version of the index format.
+constexpr std::uint8_t indexVersion = 2;
+//! The size of the index header in bytes.
+constexpr std::size_t indexHeaderSize = 8;
+
+//! \brief Returns the length of a \p code in symbols.
+//!
+//! The length excludes the trailing padding symbols but includes a '-'
+//! within the code.
+unsigned codeLength(const Code& code) noexcept;
+
+//! \brief Returns the first \p length symbols of a \p code.
+Code codePrefix(const Code& code, unsigned length) noexcept;
+
+//! \brief Extracts the literal prefix of a code \p pattern.
+//!
+//! Stores the symbols before the first wildcard in \p prefix and returns
+//! their number. Returns 0, if the pattern has no usable prefix.
+unsigned literalPrefix(const char* pattern, Code& prefix) noexcept;
+
+//! \brief A Bloom filter over the prefixes of codes.
+//!
+//! Inserting a code inserts its prefixes of 1, 2, 4, 8 and 16 symbols, so
+//! that a pattern such as \p NET* can be tested with the longest of them
+//! within its literal prefix. Limiting the number of prefixes keeps the
+//! filter selective for blocks with a few dozen distinct codes. The filter
+//! may report false positives but never false negatives.
+struct CodeFilter
+{
+    //! The number of 64-bit words in the filter.
+    static constexpr unsigned numWords = 8;
+
+    //! \brief Inserts the prefixes of a \p code.
+    void insert(const Code& code) noexcept;
+
+    //! \brief Checks if a code starting with \p prefix may have been inserted.
+    //!
+    //! The \p prefix must have been created with codePrefix() for the
+    //! given \p length. A length of 0 matches every filter.
+    bool mayContain(const Code& prefix, unsigned length) const noexcept;
+
+    //! \brief Adds the codes of the \p other filter to this filter.
+    void merge(const CodeFilter& other) noexcept;
+
+    //! \brief Removes all codes.
+    void clear() noexcept;
+
+    std::uint64_t words[numWords] = {};
+};
+
+//! \brief The index entry of a block.
+struct IndexEntry
+{
+    //! The size of an entry in bytes.
+    static constexpr std::size_t encodedSize = 32 + 8 * CodeFilter::numWords + 4;
+
+    std::uint64_t offset = 0;
+    std::uint32_t size = 0;
+    std::uint32_t numRecords = 0;
+    std::int64_t minTimeStamp = 0;
+    std::int64_t maxTimeStamp = 0;
+    CodeFilter codes;
+
+    //! \brief Checks if the block may hold a record in the time range
+    //! [\p from, \p to), whose code starts with the given \p prefix.
+    bool mayMatch(std::int64_t from, std::int64_t to,
+                  const Code& prefix, unsigned prefixLength) const noexcept
+    {
+        return minTimeStamp < to && maxTimeStamp >= from
+               && codes.mayContain(prefix, prefixLength);
+    }
+
+    //! \brief Writes the entry to the \p encodedSize bytes at \p dest.
+    void write(unsigned char* dest) const noexcept;
+
+    //! \brief Reads the entry from the \p encodedSize bytes at \p src.
+    //!
+    //! Returns \p false, if the checksum does not match.
+    bool read(const unsigned char* src) noexcept;
+};
+
+//! \brief Writes an index header to the \p indexHeaderSize bytes at \p dest.
+void writeIndexHeader(unsigned char* dest) noexcept;
+
+//! \brief Returns the path of the index of the segment at \p segmentPath.
+std::string indexPath(const char* segmentPath);
+
+//! \brief Reads the entries of an index from a byte span.
+class IndexReader
+{
+public:
+    enum class Status
+    {
+        //! All entries so far have been valid.
+        Ok,
+        //! The data ends in the middle of an entry.
+        Truncated,
+        //! The header or an entry is invalid.
+        Corrupt
+    };
+
+    //! \brief Creates a reader for the \p size bytes at \p data.
+    IndexReader(const void* data, std::size_t size) noexcept;
+
+    //! \brief Reads the next \p entry.
+    //!
+    //! Returns \p false at the end of the data or if the entry is invalid.
+    bool next(IndexEntry& entry) noexcept;
+
+    //! \brief Returns the status of the reader.
+    Status status() const noexcept
+    {
+        return m_status;
+    }
+
+private:
+    const unsigned char* m_data;
+    std::size_t m_size;
+    std::size_t m_offset;
+    Status m_status;
+};
+
+} // namespace dime
+
+#endif // DIME_SEGMENTINDEX_HPP
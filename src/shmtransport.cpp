@@ -0,0 +1,352 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "shmtransport.hpp"
+#include "diagnostic.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace dime;
+using namespace dime_detail;
+
+namespace
+{
+
+constexpr std::uint32_t shmRingMagic = 0x534D4944; // "DIMS"
+constexpr std::uint32_t shmRingVersion = 1;
+//! The offset of the ring in the shared memory object.
+constexpr std::size_t headerSize = 4096;
+//! The largest ring. The size of an entry must fit the commit word.
+constexpr std::uint64_t maxCapacity = std::uint64_t(1) << 31;
+//! The size of the commit word in front of a record.
+constexpr std::size_t commitWordSize = 4;
+constexpr std::uint32_t paddingBit = 1;
+
+//! The source of the numbers in the ring names of this process.
+DIME_STD::atomic<std::uint32_t> nextRingNumber(0);
+
+//! Closes a file descriptor when going out of scope.
+class FileCloser
+{
+public:
+    explicit
+    FileCloser(int fd)
+        : m_fd(fd)
+    {
+    }
+
+    ~FileCloser()
+    {
+        if (m_fd >= 0)
+            ::close(m_fd);
+    }
+
+private:
+    int m_fd;
+};
+
+[[noreturn]]
+void throwSystemError(const char* what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+DIME_STD::atomic<std::uint32_t>& commitWord(unsigned char* ring, std::uint64_t offset)
+{
+    return *reinterpret_cast<DIME_STD::atomic<std::uint32_t>*>(ring + offset);
+}
+
+} // anonymous namespace
+
+
+ShmSink::ShmSink(const ShmSinkOptions& options)
+    : m_mapping(MAP_FAILED),
+      m_mappingSize(0),
+      m_header(nullptr),
+      m_ring(nullptr),
+      m_capacity(0)
+{
+    static_assert(sizeof(ShmRingHeader) <= headerSize, "Header is too large");
+
+    std::size_t pageSize = std::size_t(::sysconf(_SC_PAGESIZE));
+    m_capacity = pageSize;
+    while (m_capacity < options.capacity && m_capacity < maxCapacity)
+        m_capacity *= 2;
+    m_mappingSize = headerSize + m_capacity;
+
+    m_name = std::string("/") + options.prefix + "." + std::to_string(::getpid())
+             + "." + std::to_string(nextRingNumber++);
+    int fd = ::shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0)
+        throwSystemError("shm_open");
+    FileCloser closer(fd);
+
+    if (::ftruncate(fd, off_t(m_mappingSize)) != 0)
+    {
+        int error = errno;
+        ::shm_unlink(m_name.c_str());
+        throw std::system_error(error, std::generic_category(), "ftruncate");
+    }
+    m_mapping = ::mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m_mapping == MAP_FAILED)
+    {
+        int error = errno;
+        ::shm_unlink(m_name.c_str());
+        throw std::system_error(error, std::generic_category(), "mmap");
+    }
+
+    // The new object is zero-filled, which is the initial state of the
+    // ring. The magic number is published last.
+    m_header = new (m_mapping) ShmRingHeader;
+    m_ring = static_cast<unsigned char*>(m_mapping) + headerSize;
+    m_header->version = shmRingVersion;
+    m_header->capacity = m_capacity;
+    m_header->reference = toNanoseconds(Diagnostic::TimePoint::clock::now());
+    m_header->pid = ::getpid();
+    m_header->closed.store(0, DIME_STD::memory_order_relaxed);
+    m_header->numDropped.store(0, DIME_STD::memory_order_relaxed);
+    m_header->head.store(0, DIME_STD::memory_order_relaxed);
+    m_header->tail.store(0, DIME_STD::memory_order_relaxed);
+    m_header->magic.store(shmRingMagic, DIME_STD::memory_order_release);
+}
+
+ShmSink::~ShmSink()
+{
+    m_header->closed.store(1, DIME_STD::memory_order_release);
+    ::munmap(m_mapping, m_mappingSize);
+}
+
+Subscriber::Action ShmSink::process(Diagnostic* diagnostic)
+{
+    std::int64_t reference = m_header->reference;
+    std::size_t recordSize = encodedSize(*diagnostic, reference);
+    std::uint64_t size = (commitWordSize + recordSize + 7) & ~std::uint64_t(7);
+    if (size > m_capacity / 2)
+    {
+        m_header->numDropped.fetch_add(1, DIME_STD::memory_order_relaxed);
+        return Action::DropDiagnostic;
+    }
+
+    // Reserve the entry. If it does not fit in front of the end of the
+    // ring, the remaining bytes are padded and the entry starts at the
+    // beginning. The tail is loaded with acquire semantics, such that the
+    // collector has finished clearing the released space.
+    std::uint64_t head = m_header->head.load(DIME_STD::memory_order_relaxed);
+    std::uint64_t padding;
+    do
+    {
+        std::uint64_t offset = head & (m_capacity - 1);
+        padding = offset + size > m_capacity ? m_capacity - offset : 0;
+        std::uint64_t tail = m_header->tail.load(DIME_STD::memory_order_acquire);
+        if (head + padding + size - tail > m_capacity)
+        {
+            m_header->numDropped.fetch_add(1, DIME_STD::memory_order_relaxed);
+            return Action::DropDiagnostic;
+        }
+    } while (!m_header->head.compare_exchange_weak(head, head + padding + size,
+                                                   DIME_STD::memory_order_relaxed));
+
+    if (padding)
+    {
+        commitWord(m_ring, head & (m_capacity - 1)).store(
+                    std::uint32_t(padding) | paddingBit, DIME_STD::memory_order_release);
+    }
+    std::uint64_t offset = (head + padding) & (m_capacity - 1);
+    encode(*diagnostic, reference, m_ring + offset + commitWordSize, recordSize);
+    commitWord(m_ring, offset).store(std::uint32_t(size), DIME_STD::memory_order_release);
+    return Action::DropDiagnostic;
+}
+
+ShmRingReader::ShmRingReader(const std::string& name)
+    : m_name(name),
+      m_mapping(MAP_FAILED),
+      m_mappingSize(0),
+      m_header(nullptr),
+      m_ring(nullptr),
+      m_capacity(0),
+      m_position(0),
+      m_corrupt(false)
+{
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0)
+        throwSystemError("shm_open");
+    FileCloser closer(fd);
+
+    struct stat status;
+    if (::fstat(fd, &status) != 0)
+        throwSystemError("fstat");
+    m_mappingSize = std::size_t(status.st_size);
+    if (m_mappingSize <= headerSize)
+        throw std::runtime_error("Not a shared memory ring");
+
+    m_mapping = ::mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m_mapping == MAP_FAILED)
+        throwSystemError("mmap");
+
+    m_header = static_cast<ShmRingHeader*>(m_mapping);
+    m_ring = static_cast<unsigned char*>(m_mapping) + headerSize;
+    m_capacity = m_header->capacity;
+    if (m_header->magic.load(DIME_STD::memory_order_acquire) != shmRingMagic
+        || m_header->version != shmRingVersion
+        || m_capacity != m_mappingSize - headerSize
+        || (m_capacity & (m_capacity - 1)) != 0)
+    {
+        ::munmap(m_mapping, m_mappingSize);
+        throw std::runtime_error("Not a shared memory ring");
+    }
+    m_position = m_header->tail.load(DIME_STD::memory_order_relaxed);
+}
+
+ShmRingReader::~ShmRingReader()
+{
+    ::munmap(m_mapping, m_mappingSize);
+}
+
+bool ShmRingReader::next(RecordView& view, std::int64_t& timeStamp) noexcept
+{
+    std::uint64_t head = m_header->head.load(DIME_STD::memory_order_acquire);
+    while (!m_corrupt && m_position != head)
+    {
+        std::uint64_t offset = m_position & (m_capacity - 1);
+        std::uint32_t word = commitWord(m_ring, offset).load(DIME_STD::memory_order_acquire);
+        if (word == 0)
+            return false;
+
+        std::uint64_t size = word & ~std::uint32_t(7);
+        if (size < 8 || size > m_capacity - offset || size > head - m_position)
+        {
+            m_corrupt = true;
+            return false;
+        }
+        m_position += size;
+        if (word & paddingBit)
+            continue;
+
+        RecordReader reader(m_ring + offset + commitWordSize, std::size_t(size - commitWordSize));
+        if (reader.next(view))
+        {
+            timeStamp = view.timeStamp(m_header->reference);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ShmRingReader::release() noexcept
+{
+    // Clear the consumed entries, so that the next round of the ring
+    // starts with zero commit words.
+    std::uint64_t tail = m_header->tail.load(DIME_STD::memory_order_relaxed);
+    while (tail != m_position)
+    {
+        std::uint64_t offset = tail & (m_capacity - 1);
+        std::uint64_t size = std::min(m_position - tail, m_capacity - offset);
+        std::memset(m_ring + offset, 0, std::size_t(size));
+        tail += size;
+    }
+    m_header->tail.store(m_position, DIME_STD::memory_order_release);
+}
+
+bool ShmRingReader::producerAlive() const noexcept
+{
+    return ::kill(pid_t(m_header->pid), 0) == 0 || errno != ESRCH;
+}
+
+ShmCollector::ShmCollector(const char* prefix)
+    : m_prefix(std::string(prefix) + ".")
+{
+}
+
+std::size_t ShmCollector::scan()
+{
+    // POSIX shared memory objects are files in /dev/shm on Linux.
+    DIR* directory = ::opendir("/dev/shm");
+    if (!directory)
+        return 0;
+
+    std::size_t count = 0;
+    while (dirent* entry = ::readdir(directory))
+    {
+        if (std::strncmp(entry->d_name, m_prefix.c_str(), m_prefix.size()) != 0)
+            continue;
+        std::string name = std::string("/") + entry->d_name;
+        bool known = false;
+        for (auto& reader : m_readers)
+            known = known || reader->name() == name;
+        if (known)
+            continue;
+
+        // The ring may not be initialized yet. It is picked up by a later
+        // scan in this case.
+        try
+        {
+            m_readers.emplace_back(new ShmRingReader(name));
+            ++count;
+        }
+        catch (std::exception&)
+        {
+        }
+    }
+    ::closedir(directory);
+    return count;
+}
+
+void ShmCollector::removeAbandoned()
+{
+    // The closed flag must be checked before the ring is tested for being
+    // empty. Otherwise, records which are committed right before the
+    // producer closes the ring could be lost. If the producer has died,
+    // entries which it has reserved will never be committed.
+    auto iter = m_readers.begin();
+    while (iter != m_readers.end())
+    {
+        ShmRingReader& reader = **iter;
+        if (reader.corrupt()
+            || (reader.abandoned() && (reader.empty() || !reader.producerAlive())))
+        {
+            ::shm_unlink(reader.name().c_str());
+            iter = m_readers.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
@@ -0,0 +1,294 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_SHMTRANSPORT_HPP
+#define DIME_SHMTRANSPORT_HPP
+
+#include "config.hpp"
+#include "subscriber.hpp"
+#include "wireformat.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef DIME_USE_WEOS
+#include <weos/atomic.hpp>
+#include <weos/memory.hpp>
+#else
+#include <atomic>
+#include <memory>
+#endif // DIME_USE_WEOS
+
+
+namespace dime
+{
+
+namespace dime_detail
+{
+
+//! The header of a ring in shared memory. It is stored in the native byte
+//! order and occupies the first page of the shared memory object.
+//!
+//! The ring is a sequence of entries, which are aligned to 8 bytes. An
+//! entry starts with a 32-bit commit word, which holds the size of the
+//! entry and is written last. A set bit 0 marks padding up to the end of
+//! the ring, otherwise a record follows. A commit word of zero means that
+//! the entry has been reserved but not yet written. The collector clears
+//! the bytes of the consumed entries before it advances the tail.
+struct ShmRingHeader
+{
+    //! Set to the magic number after the header has been initialized.
+    DIME_STD::atomic<std::uint32_t> magic;
+    std::uint32_t version;
+    //! The size of the ring in bytes, which is a power of two.
+    std::uint64_t capacity;
+    //! The reference of the time stamps of all records in nanoseconds.
+    std::int64_t reference;
+    //! The ID of the producing process.
+    std::int64_t pid;
+    //! Set when the producer has detached from the ring.
+    DIME_STD::atomic<std::uint32_t> closed;
+    //! The number of diagnostics which did not fit the ring.
+    DIME_STD::atomic<std::uint64_t> numDropped;
+
+    //! The number of bytes which have been reserved by the producers.
+    alignas(DIME_CACHE_LINE_SIZE) DIME_STD::atomic<std::uint64_t> head;
+    //! The number of bytes which have been released by the collector.
+    alignas(DIME_CACHE_LINE_SIZE) DIME_STD::atomic<std::uint64_t> tail;
+};
+
+} // namespace dime_detail
+
+//! \brief Options for a ShmSink.
+struct ShmSinkOptions
+{
+    //! The prefix of the names of the shared memory objects. A ring is
+    //! named /<prefix>.<process ID>.<number>.
+    const char* prefix = "dime";
+    //! The size of the ring in bytes. It is rounded up to a power of two.
+    std::size_t capacity = 1024 * 1024;
+};
+
+//! \brief A subscriber which passes diagnostics to another process.
+//!
+//! The sink creates a ring in POSIX shared memory and encodes every
+//! diagnostic directly into it. Producers reserve space with a single
+//! compare-and-swap, so neither a lock nor a system call is needed per
+//! diagnostic. A ShmCollector in another process drains the rings of all
+//! processes on the host.
+//!
+//! If the ring is full, the diagnostic is dropped and counted. The ring
+//! is not removed when the sink is destroyed but marked as closed, so
+//! that the collector can drain it before removing it.
+class ShmSink : public Subscriber
+{
+public:
+    //! \brief Creates a ring in shared memory.
+    //!
+    //! Throws \p std::system_error, if the ring cannot be created.
+    explicit
+    ShmSink(const ShmSinkOptions& options = ShmSinkOptions());
+
+    //! \brief Closes the ring.
+    virtual
+    ~ShmSink();
+
+    ShmSink(const ShmSink&) = delete;
+    ShmSink& operator=(const ShmSink&) = delete;
+
+    virtual
+    Action process(Diagnostic* diagnostic) override;
+
+    //! \brief Returns the name of the shared memory object.
+    const std::string& name() const noexcept
+    {
+        return m_name;
+    }
+
+    //! \brief Returns the number of dropped diagnostics.
+    std::uint64_t numDropped() const noexcept
+    {
+        return m_header->numDropped.load(DIME_STD::memory_order_relaxed);
+    }
+
+private:
+    std::string m_name;
+    void* m_mapping;
+    std::size_t m_mappingSize;
+    dime_detail::ShmRingHeader* m_header;
+    unsigned char* m_ring;
+    std::uint64_t m_capacity;
+};
+
+//! \brief Reads the records of a ring in shared memory.
+//!
+//! The reader is the single consumer of a ring. Records are returned in
+//! the order in which their space has been reserved. Their views refer to
+//! the ring and stay valid until release() is called.
+class ShmRingReader
+{
+public:
+    //! \brief Opens the ring with the given \p name.
+    //!
+    //! Throws \p std::system_error, if the shared memory object cannot be
+    //! mapped, and \p std::runtime_error, if it is not an initialized ring.
+    explicit
+    ShmRingReader(const std::string& name);
+
+    ~ShmRingReader();
+
+    ShmRingReader(const ShmRingReader&) = delete;
+    ShmRingReader& operator=(const ShmRingReader&) = delete;
+
+    //! \brief Reads the next record.
+    //!
+    //! Fills the \p view and sets \p timeStamp to the absolute time stamp in
+    //! nanoseconds. Returns \p false, if no further record has been
+    //! committed.
+    bool next(RecordView& view, std::int64_t& timeStamp) noexcept;
+
+    //! \brief Gives the space of all records read so far back to the
+    //! producers.
+    void release() noexcept;
+
+    //! \brief Returns the name of the shared memory object.
+    const std::string& name() const noexcept
+    {
+        return m_name;
+    }
+
+    //! \brief Returns the ID of the producing process.
+    std::int64_t pid() const noexcept
+    {
+        return m_header->pid;
+    }
+
+    //! \brief Returns the number of diagnostics which the producer dropped.
+    std::uint64_t numDropped() const noexcept
+    {
+        return m_header->numDropped.load(DIME_STD::memory_order_relaxed);
+    }
+
+    //! \brief Checks if the process of the producer exists.
+    bool producerAlive() const noexcept;
+
+    //! \brief Checks if the ring has been abandoned.
+    //!
+    //! Returns \p true, if the producer has closed the ring or if its
+    //! process does not exist any longer.
+    bool abandoned() const noexcept
+    {
+        return m_header->closed.load(DIME_STD::memory_order_acquire) || !producerAlive();
+    }
+
+    //! \brief Checks if all reserved entries have been read.
+    bool empty() const noexcept
+    {
+        return m_position == m_header->head.load(DIME_STD::memory_order_acquire);
+    }
+
+    //! \brief Checks if the ring holds an invalid entry.
+    bool corrupt() const noexcept
+    {
+        return m_corrupt;
+    }
+
+private:
+    std::string m_name;
+    void* m_mapping;
+    std::size_t m_mappingSize;
+    dime_detail::ShmRingHeader* m_header;
+    unsigned char* m_ring;
+    std::uint64_t m_capacity;
+    //! The position of the next entry.
+    std::uint64_t m_position;
+    bool m_corrupt;
+};
+
+//! \brief Drains the rings of all ShmSinks on the host.
+//!
+//! The collector discovers the rings by their name prefix in /dev/shm.
+//! Rings which have been abandoned by their producer are removed as soon
+//! as they have been drained.
+class ShmCollector
+{
+public:
+    //! \brief Creates a collector for the rings with the given \p prefix.
+    explicit
+    ShmCollector(const char* prefix = "dime");
+
+    ShmCollector(const ShmCollector&) = delete;
+    ShmCollector& operator=(const ShmCollector&) = delete;
+
+    //! \brief Opens the rings which have been created since the last scan.
+    //!
+    //! Returns the number of new rings.
+    std::size_t scan();
+
+    //! \brief Reads all committed records.
+    //!
+    //! Calls \p handler(view, timeStamp, reader) for every record, where
+    //! \p reader is the ShmRingReader of the record's ring. Returns the
+    //! number of records.
+    template <typename THandler>
+    std::size_t drain(THandler&& handler)
+    {
+        std::size_t count = 0;
+        for (auto& reader : m_readers)
+        {
+            RecordView view;
+            std::int64_t timeStamp;
+            while (reader->next(view, timeStamp))
+            {
+                handler(view, timeStamp, static_cast<const ShmRingReader&>(*reader));
+                ++count;
+            }
+            reader->release();
+        }
+        removeAbandoned();
+        return count;
+    }
+
+    //! \brief Returns the number of open rings.
+    std::size_t numRings() const noexcept
+    {
+        return m_readers.size();
+    }
+
+private:
+    std::string m_prefix;
+    std::vector<DIME_STD::unique_ptr<ShmRingReader>> m_readers;
+
+    void removeAbandoned();
+};
+
+} // namespace dime
+
+#endif // DIME_SHMTRANSPORT_HPP
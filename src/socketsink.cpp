@@ -0,0 +1,412 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "socketsink.hpp"
+#include "diagnostic.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace dime;
+using namespace dime_detail;
+
+namespace
+{
+
+#ifdef IOV_MAX
+constexpr std::size_t maxIoVectors = IOV_MAX;
+#else
+constexpr std::size_t maxIoVectors = 16;
+#endif // IOV_MAX
+
+//! The number of bytes which the collector reads at once.
+constexpr std::size_t receiveSize = 64 * 1024;
+//! The maximum number of reads from a connection per poll. This bounds the
+//! buffer of a connection, whose peer sends faster than it is processed.
+constexpr unsigned maxReads = 16;
+
+sockaddr_un makeAddress(const std::string& path)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        throw std::system_error(ENAMETOOLONG, std::generic_category(), "socket path");
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+    return address;
+}
+
+} // anonymous namespace
+
+
+SocketSink::SocketSink(const char* path, const SocketSinkOptions& options)
+    : m_options(options),
+      m_path(path),
+      m_reference(toNanoseconds(Diagnostic::TimePoint::clock::now())),
+      m_fd(-1),
+      m_numDropped(0)
+{
+    makeAddress(m_path);
+    if (!connect())
+        throw std::system_error(errno, std::generic_category(), "connect");
+    m_sender = DIME_STD::thread(&SocketSink::run, this);
+}
+
+SocketSink::~SocketSink()
+{
+    {
+        DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_senderCondition.notify_one();
+    m_sender.join();
+    if (m_fd >= 0)
+        ::close(m_fd);
+}
+
+Subscriber::Action SocketSink::process(Diagnostic* diagnostic)
+{
+    std::size_t size = encodedSize(*diagnostic, m_reference);
+    if (size > m_options.chunkSize)
+    {
+        m_numDropped.fetch_add(1, DIME_STD::memory_order_relaxed);
+        return Action::DropDiagnostic;
+    }
+
+    DIME_STD::unique_lock<DIME_STD::mutex> lock(m_mutex);
+    while (true)
+    {
+        if (!m_current)
+        {
+            if (!m_freeChunks.empty())
+            {
+                m_current = m_freeChunks.back();
+                m_freeChunks.pop_back();
+            }
+            else if (m_chunks.size() < m_options.maxChunks)
+            {
+                m_chunks.emplace_back(new Chunk(m_options.chunkSize));
+                m_current = m_chunks.back().get();
+            }
+            else if (diagnostic->droppable())
+            {
+                m_numDropped.fetch_add(1, DIME_STD::memory_order_relaxed);
+                return Action::DropDiagnostic;
+            }
+            else
+            {
+                // Apply backpressure to the producer.
+                m_senderCondition.notify_one();
+                m_freeCondition.wait(lock);
+                continue;
+            }
+        }
+
+        if (m_current->size + size <= m_options.chunkSize)
+            break;
+
+        // The chunk is full. Hand it over to the sender.
+        m_pendingChunks.push_back(m_current);
+        m_current = nullptr;
+        m_senderCondition.notify_one();
+    }
+
+    encode(*diagnostic, m_reference, m_current->data.get() + m_current->size, size);
+    m_current->size += size;
+    ++m_current->numRecords;
+    return Action::DropDiagnostic;
+}
+
+void SocketSink::flush()
+{
+    DIME_STD::unique_lock<DIME_STD::mutex> lock(m_mutex);
+    std::uint64_t request = ++m_flushRequested;
+    m_senderCondition.notify_one();
+    m_flushedCondition.wait(lock, [&] { return m_flushCompleted >= request; });
+}
+
+bool SocketSink::connect()
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+        return false;
+
+    sockaddr_un address = makeAddress(m_path);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+
+    // The header is tiny and the socket buffer of a new connection is
+    // empty, so it is sent in one go.
+    unsigned char header[streamHeaderSize];
+    unsigned char* iter = writeLittleEndian(header, streamMagic, 4);
+    *iter++ = streamVersion;
+    iter = writeLittleEndian(iter, 0, 3);
+    writeLittleEndian(iter, std::uint64_t(m_reference), 8);
+    if (::send(fd, header, streamHeaderSize, MSG_NOSIGNAL) != ssize_t(streamHeaderSize))
+    {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+
+    m_fd = fd;
+    return true;
+}
+
+bool SocketSink::stopRequested()
+{
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    return m_stop;
+}
+
+void SocketSink::send(std::vector<Chunk*>& chunks)
+{
+    std::size_t first = 0;
+    if (m_fd < 0 && !connect())
+        first = chunks.size();
+
+    std::vector<iovec> vectors;
+    for (Chunk* chunk : chunks)
+        vectors.push_back(iovec{chunk->data.get(), chunk->size});
+
+    while (first < vectors.size())
+    {
+        msghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_iov = &vectors[first];
+        message.msg_iovlen = std::min(vectors.size() - first, maxIoVectors);
+        ssize_t sent = ::sendmsg(m_fd, &message, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                // Wait until the collector catches up. When stopping, give
+                // up after one interval without progress.
+                pollfd descriptor = {m_fd, POLLOUT, 0};
+                if (::poll(&descriptor, 1, int(m_options.flushInterval.count())) != 0
+                    || !stopRequested())
+                {
+                    continue;
+                }
+            }
+            // The connection is lost. The chunk which has been sent
+            // partially cannot be completed on a new connection.
+            ::close(m_fd);
+            m_fd = -1;
+            break;
+        }
+
+        // Skip the chunks which have been sent completely and adjust the
+        // one which has been sent partially.
+        std::size_t remaining = std::size_t(sent);
+        while (first < vectors.size() && remaining >= vectors[first].iov_len)
+            remaining -= vectors[first++].iov_len;
+        if (remaining)
+        {
+            vectors[first].iov_base = static_cast<char*>(vectors[first].iov_base) + remaining;
+            vectors[first].iov_len -= remaining;
+        }
+    }
+
+    for (std::size_t idx = first; idx < chunks.size(); ++idx)
+        m_numDropped.fetch_add(chunks[idx]->numRecords, DIME_STD::memory_order_relaxed);
+}
+
+void SocketSink::run()
+{
+    DIME_STD::unique_lock<DIME_STD::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_senderCondition.wait_for(lock, m_options.flushInterval,
+                                   [&] {
+                                       return m_stop
+                                              || m_flushRequested != m_flushCompleted
+                                              || !m_pendingChunks.empty();
+                                   });
+        bool stop = m_stop;
+        std::uint64_t request = m_flushRequested;
+
+        // Send the partially filled chunk as well to bound the latency.
+        if (m_current && m_current->size != 0)
+        {
+            m_pendingChunks.push_back(m_current);
+            m_current = nullptr;
+        }
+
+        std::vector<Chunk*> chunks;
+        chunks.swap(m_pendingChunks);
+        lock.unlock();
+
+        if (!chunks.empty())
+            send(chunks);
+        for (Chunk* chunk : chunks)
+        {
+            chunk->size = 0;
+            chunk->numRecords = 0;
+        }
+
+        lock.lock();
+        m_freeChunks.insert(m_freeChunks.end(), chunks.begin(), chunks.end());
+        m_freeCondition.notify_all();
+        m_flushCompleted = request;
+        m_flushedCondition.notify_all();
+
+        if (stop)
+            break;
+    }
+}
+
+SocketCollector::SocketCollector(const char* path)
+    : m_path(path),
+      m_fd(-1)
+{
+    sockaddr_un address = makeAddress(m_path);
+    m_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (m_fd < 0)
+        throw std::system_error(errno, std::generic_category(), "socket");
+
+    ::unlink(path);
+    if (::bind(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || ::listen(m_fd, SOMAXCONN) != 0)
+    {
+        int error = errno;
+        ::close(m_fd);
+        throw std::system_error(error, std::generic_category(), "bind");
+    }
+}
+
+SocketCollector::~SocketCollector()
+{
+    for (auto& connection : m_connections)
+        ::close(connection->fd);
+    ::close(m_fd);
+    ::unlink(m_path.c_str());
+}
+
+void SocketCollector::wait(std::chrono::milliseconds timeout)
+{
+    std::vector<pollfd> descriptors;
+    descriptors.push_back(pollfd{m_fd, POLLIN, 0});
+    for (auto& connection : m_connections)
+        descriptors.push_back(pollfd{connection->fd, POLLIN, 0});
+    if (::poll(descriptors.data(), descriptors.size(), int(timeout.count())) <= 0)
+        return;
+
+    for (std::size_t idx = 1; idx < descriptors.size(); ++idx)
+        if (descriptors[idx].revents)
+            receive(*m_connections[idx - 1]);
+
+    if (descriptors[0].revents & POLLIN)
+    {
+        int fd;
+        while ((fd = ::accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0)
+        {
+            m_connections.emplace_back(new Connection);
+            m_connections.back()->fd = fd;
+            receive(*m_connections.back());
+        }
+    }
+}
+
+void SocketCollector::receive(Connection& connection)
+{
+    // Move the unprocessed bytes to the front. The buffer of a new
+    // connection is still empty.
+    if (connection.offset != 0)
+    {
+        std::memmove(connection.buffer.data(), connection.buffer.data() + connection.offset,
+                     connection.size - connection.offset);
+        connection.size -= connection.offset;
+        connection.offset = 0;
+    }
+
+    for (unsigned count = 0; count < maxReads; ++count)
+    {
+        if (connection.buffer.size() < connection.size + receiveSize)
+            connection.buffer.resize(connection.size + receiveSize);
+        ssize_t received = ::read(connection.fd, connection.buffer.data() + connection.size,
+                                  connection.buffer.size() - connection.size);
+        if (received > 0)
+        {
+            connection.size += std::size_t(received);
+            continue;
+        }
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            connection.closed = true;
+        break;
+    }
+
+    if (!connection.hasHeader && connection.size >= streamHeaderSize)
+    {
+        const unsigned char* header = connection.buffer.data();
+        if (readLittleEndian(header, 4) != streamMagic || header[4] != streamVersion)
+        {
+            connection.closed = true;
+            return;
+        }
+        connection.reference = std::int64_t(readLittleEndian(header + 8, 8));
+        connection.offset = streamHeaderSize;
+        connection.hasHeader = true;
+    }
+}
+
+void SocketCollector::removeClosed()
+{
+    auto iter = m_connections.begin();
+    while (iter != m_connections.end())
+    {
+        if ((*iter)->closed)
+        {
+            ::close((*iter)->fd);
+            iter = m_connections.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
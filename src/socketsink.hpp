@@ -0,0 +1,264 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_SOCKETSINK_HPP
+#define DIME_SOCKETSINK_HPP
+
+#include "config.hpp"
+#include "subscriber.hpp"
+#include "wireformat.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef DIME_USE_WEOS
+#include <weos/atomic.hpp>
+#include <weos/condition_variable.hpp>
+#include <weos/memory.hpp>
+#include <weos/mutex.hpp>
+#include <weos/thread.hpp>
+#else
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#endif // DIME_USE_WEOS
+
+
+namespace dime
+{
+
+// Record streams
+// ==============
+//
+// A SocketSink sends a stream header after connecting, which is followed
+// by records in the wire format. All integers are little-endian.
+//
+//     u32   magic "DIMU"
+//     u8    version
+//     u8[3] reserved
+//     i64   reference of the time stamps of all records in ns
+
+//! The magic number at the start of a record stream.
+constexpr std::uint32_t streamMagic = 0x554D4944;
+//! The version of the stream format.
+constexpr std::uint8_t streamVersion = 1;
+//! The size of the stream header in bytes.
+constexpr std::size_t streamHeaderSize = 16;
+
+//! \brief Options for a SocketSink.
+struct SocketSinkOptions
+{
+    //! The size of a staging buffer. Records are appended to the current
+    //! buffer until it is full.
+    std::size_t chunkSize = 64 * 1024;
+    //! The maximum number of staging buffers. When all of them are in use,
+    //! droppable diagnostics are dropped and non-droppable ones wait.
+    std::size_t maxChunks = 64;
+    //! The latency bound. Partially filled buffers are sent after this
+    //! interval at the latest. A lost connection is re-established at the
+    //! same pace.
+    std::chrono::milliseconds flushInterval = std::chrono::milliseconds(10);
+};
+
+//! \brief A subscriber which streams diagnostics over a Unix domain socket.
+//!
+//! The records are appended to staging buffers. A background thread sends
+//! all filled buffers with a single sendmsg() on a non-blocking socket.
+//! When the collector does not keep up, the socket would block and the
+//! buffers fill up. Then droppable diagnostics are dropped and counted and
+//! non-droppable ones wait for a free buffer. Records which cannot be sent
+//! because the connection has been lost are dropped as well.
+class SocketSink : public Subscriber
+{
+public:
+    //! \brief Creates a sink which connects to the socket at \p path.
+    //!
+    //! Throws \p std::system_error, if the connection cannot be made.
+    explicit
+    SocketSink(const char* path, const SocketSinkOptions& options = SocketSinkOptions());
+
+    //! \brief Sends all buffered records and closes the connection.
+    //!
+    //! Gives up, if the collector does not accept data for the flush
+    //! interval.
+    virtual
+    ~SocketSink();
+
+    SocketSink(const SocketSink&) = delete;
+    SocketSink& operator=(const SocketSink&) = delete;
+
+    virtual
+    Action process(Diagnostic* diagnostic) override;
+
+    //! \brief Sends all buffered records.
+    //!
+    //! Blocks until all records which have been processed before the call
+    //! have been sent or dropped.
+    void flush();
+
+    //! \brief Returns the number of dropped diagnostics.
+    std::uint64_t numDropped() const noexcept
+    {
+        return m_numDropped.load(DIME_STD::memory_order_relaxed);
+    }
+
+private:
+    struct Chunk
+    {
+        explicit
+        Chunk(std::size_t capacity)
+            : data(new unsigned char[capacity])
+        {
+        }
+
+        DIME_STD::unique_ptr<unsigned char[]> data;
+        std::size_t size = 0;
+        std::uint32_t numRecords = 0;
+    };
+
+    const SocketSinkOptions m_options;
+    const std::string m_path;
+    const std::int64_t m_reference;
+    //! The socket. Only used by the sender thread after construction.
+    int m_fd;
+
+    DIME_STD::mutex m_mutex;
+    DIME_STD::condition_variable m_senderCondition;
+    DIME_STD::condition_variable m_freeCondition;
+    DIME_STD::condition_variable m_flushedCondition;
+
+    std::vector<DIME_STD::unique_ptr<Chunk>> m_chunks;
+    std::vector<Chunk*> m_freeChunks;
+    Chunk* m_current = nullptr;
+    std::vector<Chunk*> m_pendingChunks;
+    std::uint64_t m_flushRequested = 0;
+    std::uint64_t m_flushCompleted = 0;
+    bool m_stop = false;
+
+    DIME_STD::atomic<std::uint64_t> m_numDropped;
+
+    DIME_STD::thread m_sender;
+
+
+    bool connect();
+    bool stopRequested();
+    void send(std::vector<Chunk*>& chunks);
+    void run();
+};
+
+//! \brief A reference collector for SocketSinks.
+//!
+//! The collector listens on a Unix domain socket and accepts any number of
+//! connections. It is driven by poll(), which waits for data and passes
+//! every received record to a handler. A connection which sends a corrupt
+//! stream is closed.
+class SocketCollector
+{
+public:
+    //! \brief Listens on the socket at \p path.
+    //!
+    //! A stale socket file at \p path is replaced. Throws
+    //! \p std::system_error, if the socket cannot be created.
+    explicit
+    SocketCollector(const char* path);
+
+    //! \brief Closes all connections and removes the socket file.
+    ~SocketCollector();
+
+    SocketCollector(const SocketCollector&) = delete;
+    SocketCollector& operator=(const SocketCollector&) = delete;
+
+    //! \brief Receives records.
+    //!
+    //! Waits up to \p timeout for new connections and data. Calls
+    //! \p handler(view, timeStamp) for every complete record, where
+    //! \p timeStamp is the absolute time stamp in nanoseconds. Returns the
+    //! number of records.
+    template <typename THandler>
+    std::size_t poll(std::chrono::milliseconds timeout, THandler&& handler)
+    {
+        wait(timeout);
+
+        std::size_t count = 0;
+        for (auto& connection : m_connections)
+        {
+            if (!connection->hasHeader)
+                continue;
+            RecordReader reader(connection->buffer.data() + connection->offset,
+                                connection->size - connection->offset);
+            RecordView view;
+            while (reader.next(view))
+            {
+                handler(view, view.timeStamp(connection->reference));
+                ++count;
+            }
+            connection->offset += reader.offset();
+            if (reader.status() == RecordReader::Status::Corrupt)
+                connection->closed = true;
+        }
+        removeClosed();
+        return count;
+    }
+
+    //! \brief Returns the number of connections.
+    std::size_t numConnections() const noexcept
+    {
+        return m_connections.size();
+    }
+
+private:
+    struct Connection
+    {
+        int fd;
+        std::vector<unsigned char> buffer;
+        //! The number of bytes in the buffer.
+        std::size_t size = 0;
+        //! The offset of the first unprocessed byte.
+        std::size_t offset = 0;
+        bool hasHeader = false;
+        bool closed = false;
+        std::int64_t reference = 0;
+    };
+
+    std::string m_path;
+    int m_fd;
+    std::vector<DIME_STD::unique_ptr<Connection>> m_connections;
+
+    void wait(std::chrono::milliseconds timeout);
+    void receive(Connection& connection);
+    void removeClosed();
+};
+
+} // namespace dime
+
+#endif // DIME_SOCKETSINK_HPP
@@ -0,0 +1,583 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "textformat.hpp"
+#include "registry.hpp"
+#include "wireformat.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef DIME_USE_WEOS
+#include <weos/atomic.hpp>
+#else
+#include <atomic>
+#endif // DIME_USE_WEOS
+
+
+using namespace dime;
+
+namespace
+{
+
+//! The decimal representations of 0 to 99.
+const char digitPairs[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+//! The powers of ten up to the maximum precision.
+const std::uint64_t integerPowersOfTen[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+    10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+    100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull
+};
+
+//! The powers of ten which are exact in a long double.
+const long double exactPowersOfTen[] = {
+    1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L, 1e10L,
+    1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L,
+    1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
+};
+
+constexpr int maxPrecision = 17;
+
+//! The length of a formatted time stamp.
+constexpr std::size_t timeStampSize = 30;
+
+//! The source of the sink IDs.
+DIME_STD::atomic<std::uint64_t> nextSinkId(1);
+
+//! Caches the stage of the sink, which the current thread has used last.
+struct StageCache
+{
+    std::uint64_t sinkId;
+    void* stage;
+};
+
+thread_local StageCache stageCache = {0, nullptr};
+
+char* copy(char* dest, const char* text) noexcept
+{
+    while (*text)
+        *dest++ = *text++;
+    return dest;
+}
+
+//! Writes \p value with exactly \p numDigits digits, where \p numDigits is even.
+char* formatFixedWidth(char* dest, std::uint64_t value, int numDigits) noexcept
+{
+    for (int idx = numDigits - 2; idx >= 0; idx -= 2)
+    {
+        std::memcpy(dest + idx, digitPairs + 2 * (value % 100), 2);
+        value /= 100;
+    }
+    return dest + numDigits;
+}
+
+//! Multiplies \p value by 10^\p exponent. The extended precision keeps the
+//! rounding error below the last of the 17 significant digits.
+long double scale(double value, int exponent) noexcept
+{
+    if (exponent >= 0 && exponent <= 27)
+        return value * exactPowersOfTen[exponent];
+    if (exponent < 0 && exponent >= -27)
+        return value / exactPowersOfTen[-exponent];
+    return value * std::pow(10.0L, exponent);
+}
+
+char* formatString(char* dest, const char* text) noexcept
+{
+    *dest++ = '"';
+    for (; *text; ++text)
+    {
+        unsigned char c = static_cast<unsigned char>(*text);
+        if (c == '"' || c == '\\')
+        {
+            *dest++ = '\\';
+            *dest++ = char(c);
+        }
+        else if (c < 0x20)
+        {
+            *dest++ = '\\';
+            *dest++ = 'x';
+            *dest++ = "0123456789abcdef"[c >> 4];
+            *dest++ = "0123456789abcdef"[c & 0xf];
+        }
+        else
+        {
+            *dest++ = char(c);
+        }
+    }
+    *dest++ = '"';
+    return dest;
+}
+
+char* formatArgument(char* dest, const Argument& argument, bool quoteStrings) noexcept;
+
+//! Returns an upper bound of the length of a formatted \p argument.
+std::size_t maxArgumentSize(const Argument& argument, bool quoteStrings) noexcept
+{
+    if (argument.kind() != ArgumentKind::String)
+        return dime_detail::maxFloatSize;
+    std::size_t length = std::strlen(argument.toString().value());
+    return quoteStrings ? 2 + 4 * length : length;
+}
+
+} // anonymous namespace
+
+namespace dime
+{
+namespace dime_detail
+{
+
+char* formatUnsigned(char* dest, std::uint64_t value) noexcept
+{
+    char buffer[20];
+    char* begin = buffer + sizeof(buffer);
+    while (value >= 100)
+    {
+        begin -= 2;
+        std::memcpy(begin, digitPairs + 2 * (value % 100), 2);
+        value /= 100;
+    }
+    if (value >= 10)
+    {
+        begin -= 2;
+        std::memcpy(begin, digitPairs + 2 * value, 2);
+    }
+    else
+    {
+        *--begin = char('0' + value);
+    }
+
+    std::size_t length = std::size_t(buffer + sizeof(buffer) - begin);
+    std::memcpy(dest, begin, length);
+    return dest + length;
+}
+
+char* formatInteger(char* dest, std::int64_t value) noexcept
+{
+    std::uint64_t magnitude = std::uint64_t(value);
+    if (value < 0)
+    {
+        *dest++ = '-';
+        magnitude = 0 - magnitude;
+    }
+    return formatUnsigned(dest, magnitude);
+}
+
+char* formatFloat(char* dest, double value, int precision) noexcept
+{
+    if (std::isnan(value))
+        return copy(dest, "nan");
+    if (std::signbit(value))
+    {
+        *dest++ = '-';
+        value = -value;
+    }
+    if (std::isinf(value))
+        return copy(dest, "inf");
+    if (value == 0)
+    {
+        *dest++ = '0';
+        return dest;
+    }
+    precision = std::min(std::max(precision, 1), maxPrecision);
+
+    // Scale the value to precision digits before the decimal point. The
+    // decimal exponent is estimated from the binary one, which may be off
+    // by one.
+    int binaryExponent;
+    std::frexp(value, &binaryExponent);
+    int exponent = ((binaryExponent - 1) * 78913) >> 18;
+    long double scaled = scale(value, precision - 1 - exponent);
+    if (scaled >= exactPowersOfTen[precision])
+    {
+        ++exponent;
+        scaled = scale(value, precision - 1 - exponent);
+    }
+    else if (scaled < exactPowersOfTen[precision - 1])
+    {
+        --exponent;
+        scaled = scale(value, precision - 1 - exponent);
+    }
+    // Round half to even like printf() does for exact ties.
+    std::uint64_t mantissa = std::uint64_t(std::int64_t(scaled));
+    long double fraction = scaled - std::int64_t(mantissa);
+    if (fraction > 0.5L || (fraction == 0.5L && (mantissa & 1)))
+        ++mantissa;
+    if (mantissa >= integerPowersOfTen[precision])
+    {
+        mantissa = integerPowersOfTen[precision - 1];
+        ++exponent;
+    }
+
+    // Render an even number of digits with a leading zero for odd precisions.
+    char buffer[maxPrecision + 1];
+    formatFixedWidth(buffer, mantissa, (precision + 1) & ~1);
+    const char* digits = buffer + (precision & 1);
+    int numDigits = precision;
+    while (numDigits > 1 && digits[numDigits - 1] == '0')
+        --numDigits;
+
+    if (exponent < -4 || exponent >= precision)
+    {
+        *dest++ = digits[0];
+        if (numDigits > 1)
+        {
+            *dest++ = '.';
+            std::memcpy(dest, digits + 1, std::size_t(numDigits - 1));
+            dest += numDigits - 1;
+        }
+        *dest++ = 'e';
+        *dest++ = exponent < 0 ? '-' : '+';
+        int magnitude = exponent < 0 ? -exponent : exponent;
+        if (magnitude < 10)
+            *dest++ = '0';
+        return formatUnsigned(dest, std::uint64_t(magnitude));
+    }
+
+    if (exponent < 0)
+    {
+        *dest++ = '0';
+        *dest++ = '.';
+        for (int idx = -1; idx > exponent; --idx)
+            *dest++ = '0';
+        std::memcpy(dest, digits, std::size_t(numDigits));
+        return dest + numDigits;
+    }
+
+    for (int idx = 0; idx <= exponent; ++idx)
+        *dest++ = idx < numDigits ? digits[idx] : '0';
+    if (numDigits > exponent + 1)
+    {
+        *dest++ = '.';
+        std::memcpy(dest, digits + exponent + 1, std::size_t(numDigits - exponent - 1));
+        dest += numDigits - exponent - 1;
+    }
+    return dest;
+}
+
+} // namespace dime_detail
+} // namespace dime
+
+namespace
+{
+
+//! Writes an \p argument. Strings are quoted and escaped, if \p quoteStrings
+//! is set, and written verbatim otherwise.
+char* formatArgument(char* dest, const Argument& argument, bool quoteStrings) noexcept
+{
+    using namespace dime_detail;
+
+    switch (argument.kind())
+    {
+    case ArgumentKind::SignedInteger:
+        return formatInteger(dest, argument.toInteger().value());
+    case ArgumentKind::UnsignedInteger:
+        return formatUnsigned(dest, argument.toUnsigned().value());
+    // Nine and 17 significant digits are enough to parse the value back
+    // exactly. They are what dimedump prints, too.
+    case ArgumentKind::Float:
+        return formatFloat(dest, argument.toFloat().value(), 9);
+    case ArgumentKind::Double:
+        return formatFloat(dest, argument.toDouble().value(), 17);
+    case ArgumentKind::LongDouble:
+        return formatFloat(dest, double(argument.toLongDouble().value()), 17);
+    case ArgumentKind::String:
+        if (quoteStrings)
+            return formatString(dest, argument.toString().value());
+        return copy(dest, argument.toString().value());
+    }
+    return dest;
+}
+
+} // anonymous namespace
+
+// ----=====================================================================----
+//     TextFormatter
+// ----=====================================================================----
+
+std::size_t TextFormatter::maxLineSize(const Diagnostic& diagnostic) noexcept
+{
+    std::size_t size = timeStampSize + 1 + 20 + 1;
+    const Argument* arguments = diagnostic.arguments();
+    for (unsigned idx = 0; idx < diagnostic.numArguments(); ++idx)
+        size += 1 + maxArgumentSize(arguments[idx], true);
+    if (diagnostic.numRepeats() != 0)
+        size += sizeof(" (repeated  times)") - 1 + 10;
+    if (diagnostic.samplingWeight() != 1)
+        size += sizeof(" (weight )") - 1 + 10;
+    return size;
+}
+
+std::size_t TextFormatter::maxExplanationSize(const Explanation& explanation,
+                                              const Diagnostic& diagnostic) noexcept
+{
+    std::size_t size = 0;
+    for (std::size_t idx = 0; idx < explanation.numSegments(); ++idx)
+    {
+        const ExplanationSegment& segment = explanation.segment(idx);
+        if (segment.argument < 0)
+            size += segment.length;
+        else if (unsigned(segment.argument) < diagnostic.numArguments())
+            size += maxArgumentSize(diagnostic.arguments()[segment.argument], false);
+        else
+            size += 3;
+    }
+    return size;
+}
+
+char* TextFormatter::formatExplanation(const Explanation& explanation,
+                                       const Diagnostic& diagnostic, char* dest) noexcept
+{
+    for (std::size_t idx = 0; idx < explanation.numSegments(); ++idx)
+    {
+        const ExplanationSegment& segment = explanation.segment(idx);
+        if (segment.argument < 0)
+        {
+            std::memcpy(dest, segment.text, segment.length);
+            dest += segment.length;
+        }
+        else if (unsigned(segment.argument) < diagnostic.numArguments())
+        {
+            dest = formatArgument(dest, diagnostic.arguments()[segment.argument], false);
+        }
+        else
+        {
+            dest = copy(dest, "{?}");
+        }
+    }
+    return dest;
+}
+
+char* TextFormatter::format(const Diagnostic& diagnostic, char* dest) noexcept
+{
+    using namespace dime_detail;
+
+    std::int64_t timeStamp = toNanoseconds(diagnostic.timeStamp());
+    std::int64_t second = timeStamp / 1000000000;
+    std::int64_t nanoseconds = timeStamp % 1000000000;
+    if (nanoseconds < 0)
+    {
+        nanoseconds += 1000000000;
+        --second;
+    }
+    if (second != m_second)
+    {
+        std::time_t time = std::time_t(second);
+        std::tm utc;
+        char buffer[32];
+        if (!::gmtime_r(&time, &utc)
+            || std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc)
+               != sizeof(m_dateTime))
+        {
+            std::strcpy(buffer, "0000-00-00T00:00:00");
+        }
+        std::memcpy(m_dateTime, buffer, sizeof(m_dateTime));
+        m_second = second;
+    }
+    std::memcpy(dest, m_dateTime, sizeof(m_dateTime));
+    dest += sizeof(m_dateTime);
+    *dest++ = '.';
+    *dest++ = char('0' + nanoseconds / 100000000);
+    dest = formatFixedWidth(dest, std::uint64_t(nanoseconds % 100000000), 8);
+    *dest++ = 'Z';
+
+    *dest++ = ' ';
+    dest += diagnostic.code().toChars(dest);
+
+    const Argument* arguments = diagnostic.arguments();
+    for (unsigned idx = 0; idx < diagnostic.numArguments(); ++idx)
+    {
+        *dest++ = ' ';
+        dest = formatArgument(dest, arguments[idx], true);
+    }
+    if (diagnostic.numRepeats() != 0)
+    {
+        dest = copy(dest, " (repeated ");
+        dest = formatUnsigned(dest, diagnostic.numRepeats());
+        dest = copy(dest, " times)");
+    }
+    if (diagnostic.samplingWeight() != 1)
+    {
+        dest = copy(dest, " (weight ");
+        dest = formatUnsigned(dest, diagnostic.samplingWeight());
+        *dest++ = ')';
+    }
+    *dest++ = '\n';
+    return dest;
+}
+
+// ----=====================================================================----
+//     TextSink
+// ----=====================================================================----
+
+TextSink::TextSink(int fd, const TextSinkOptions& options)
+    : m_options(options),
+      m_id(nextSinkId++),
+      m_fd(fd),
+      m_ownsFd(false)
+{
+}
+
+TextSink::TextSink(const char* path, const TextSinkOptions& options)
+    : m_options(options),
+      m_id(nextSinkId++),
+      m_fd(::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)),
+      m_ownsFd(true)
+{
+    if (m_fd < 0)
+        throw std::system_error(errno, std::generic_category(), "open");
+}
+
+TextSink::~TextSink()
+{
+    flush();
+    if (m_ownsFd)
+        ::close(m_fd);
+}
+
+Subscriber::Action TextSink::process(Diagnostic* diagnostic)
+{
+    Stage& stage = localStage();
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(stage.mutex);
+
+    const DescriptorInfo* info = m_options.registry
+                                 ? m_options.registry->find(diagnostic->code())
+                                 : nullptr;
+    if (info && (info->numArguments != diagnostic->numArguments()
+                 || info->explanation->numSegments() == 0))
+    {
+        info = nullptr;
+    }
+
+    std::size_t size = TextFormatter::maxLineSize(*diagnostic);
+    if (info)
+        size += 4 + TextFormatter::maxExplanationSize(*info->explanation, *diagnostic);
+    if (stage.size + size > stage.buffer.size())
+    {
+        write(stage);
+        // Only a line which is longer than the buffer needs an allocation.
+        if (size > stage.buffer.size())
+            stage.buffer.resize(size);
+    }
+
+    char* begin = stage.buffer.data() + stage.size;
+    char* end = stage.formatter.format(*diagnostic, begin);
+    if (info)
+    {
+        // Insert the explanation before the newline.
+        end = copy(end - 1, " -- ");
+        end = TextFormatter::formatExplanation(*info->explanation, *diagnostic, end);
+        *end++ = '\n';
+    }
+    stage.size += std::size_t(end - begin);
+    if (m_options.lineBuffered)
+        write(stage);
+    return Action::DropDiagnostic;
+}
+
+void TextSink::flush()
+{
+    std::vector<Stage*> stages;
+    {
+        DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+        for (auto& stage : m_stages)
+            stages.push_back(stage.get());
+    }
+
+    for (Stage* stage : stages)
+    {
+        DIME_STD::lock_guard<DIME_STD::mutex> lock(stage->mutex);
+        write(*stage);
+    }
+}
+
+TextSink::Stage& TextSink::localStage()
+{
+    if (stageCache.sinkId == m_id)
+        return *static_cast<Stage*>(stageCache.stage);
+
+    DIME_STD::lock_guard<DIME_STD::mutex> lock(m_mutex);
+    auto self = DIME_STD::this_thread::get_id();
+    auto iter = std::find_if(m_stages.begin(), m_stages.end(),
+                             [&](const DIME_STD::unique_ptr<Stage>& stage) {
+                                 return stage->owner == self;
+                             });
+    Stage* stage;
+    if (iter != m_stages.end())
+    {
+        stage = iter->get();
+    }
+    else
+    {
+        m_stages.emplace_back(new Stage);
+        stage = m_stages.back().get();
+        stage->owner = self;
+        stage->buffer.resize(m_options.bufferSize);
+    }
+
+    stageCache.sinkId = m_id;
+    stageCache.stage = stage;
+    return *stage;
+}
+
+void TextSink::write(Stage& stage)
+{
+    // Lines which cannot be written are discarded. A diagnostic sink must
+    // not fail the code which emits the diagnostic.
+    std::size_t offset = 0;
+    while (offset < stage.size)
+    {
+        ssize_t written = ::write(m_fd, stage.buffer.data() + offset, stage.size - offset);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            break;
+        offset += std::size_t(written);
+    }
+    stage.size = 0;
+}
@@ -0,0 +1,212 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_TEXTFORMAT_HPP
+#define DIME_TEXTFORMAT_HPP
+
+#include "config.hpp"
+#include "diagnostic.hpp"
+#include "explanation.hpp"
+#include "subscriber.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef DIME_USE_WEOS
+#include <weos/memory.hpp>
+#include <weos/mutex.hpp>
+#include <weos/thread.hpp>
+#else
+#include <memory>
+#include <mutex>
+#include <thread>
+#endif // DIME_USE_WEOS
+
+
+namespace dime
+{
+
+class DescriptorRegistryView;
+
+namespace dime_detail
+{
+
+//! \brief Writes the decimal digits of \p value to \p dest.
+//!
+//! Writes at most 20 characters and returns the end of the output.
+char* formatUnsigned(char* dest, std::uint64_t value) noexcept;
+
+//! \brief Writes \p value in decimal to \p dest.
+//!
+//! Writes at most 20 characters and returns the end of the output.
+char* formatInteger(char* dest, std::int64_t value) noexcept;
+
+//! \brief Writes a floating-point \p value to \p dest.
+//!
+//! The value is rounded to \p precision significant digits (at most 17)
+//! and trailing zeros are removed. Like the \p %g format, the scientific
+//! notation is used for very small and very large values. Values which are
+//! very close to a tie may differ from printf() in the last digit. Writes at
+//! most \p maxFloatSize characters and returns the end of the output.
+char* formatFloat(char* dest, double value, int precision) noexcept;
+
+//! The maximum number of characters written by formatFloat().
+constexpr std::size_t maxFloatSize = 32;
+
+} // namespace dime_detail
+
+//! \brief Formats diagnostics as lines of text.
+//!
+//! A line consists of the time stamp in UTC, the code and the arguments,
+//! which are separated by spaces:
+//!
+//!     2016-03-01T10:00:00.000000123Z CODE 42 0.5 "text"
+//!
+//! Floats are written with 9, doubles with 17 significant digits. Strings
+//! are quoted and control characters are escaped. A summary of repeats
+//! ends with the number of repeats, e.g. "(repeated 12 times)", and a
+//! sampled diagnostic with its weight, e.g. "(weight 100)". The formatter
+//! caches the date and time of the current second, so it should be used by
+//! a single thread.
+class TextFormatter
+{
+public:
+    //! \brief Returns an upper bound of the length of the line of a
+    //! \p diagnostic including the newline.
+    static
+    std::size_t maxLineSize(const Diagnostic& diagnostic) noexcept;
+
+    //! \brief Formats a diagnostic.
+    //!
+    //! Writes the line of the \p diagnostic including the newline to
+    //! \p dest, which must have room for maxLineSize() characters. Returns
+    //! the end of the output.
+    char* format(const Diagnostic& diagnostic, char* dest) noexcept;
+
+    //! \brief Returns an upper bound of the length of an \p explanation with
+    //! the arguments of a \p diagnostic.
+    static
+    std::size_t maxExplanationSize(const Explanation& explanation,
+                                   const Diagnostic& diagnostic) noexcept;
+
+    //! \brief Formats an explanation.
+    //!
+    //! Writes the \p explanation of the descriptor of a \p diagnostic to
+    //! \p dest, which must have room for maxExplanationSize() characters.
+    //! The precomputed segments are concatenated; strings are written
+    //! verbatim. A placeholder for an argument which the diagnostic does not
+    //! have is written as \p {?}. The output is not null-terminated. Returns
+    //! the end of the output.
+    static
+    char* formatExplanation(const Explanation& explanation,
+                            const Diagnostic& diagnostic, char* dest) noexcept;
+
+private:
+    //! The second of the cached date and time.
+    std::int64_t m_second = -1;
+    //! The date and time as YYYY-MM-DDTHH:MM:SS.
+    char m_dateTime[19];
+};
+
+//! \brief Options for a TextSink.
+struct TextSinkOptions
+{
+    //! The size of the buffer of every thread. The lines in a buffer are
+    //! written when it is full.
+    std::size_t bufferSize = 16 * 1024;
+    //! If set, every line is written immediately.
+    bool lineBuffered = false;
+    //! If set, the explanation of the descriptor of a diagnostic is looked
+    //! up in this registry and appended to the line after " -- ". The
+    //! registry must outlive the sink.
+    const DescriptorRegistryView* registry = nullptr;
+};
+
+//! \brief A subscriber which writes diagnostics as lines of text.
+//!
+//! Every thread which calls process() formats into its own buffer, which
+//! is reused for all lines. Formatting a diagnostic needs no heap
+//! allocation. A buffer is written with a single write() when it is full,
+//! when flush() is called or when the sink is destroyed.
+class TextSink : public Subscriber
+{
+public:
+    //! \brief Creates a sink which writes to the file descriptor \p fd.
+    //!
+    //! The descriptor is not closed by the sink.
+    explicit
+    TextSink(int fd, const TextSinkOptions& options = TextSinkOptions());
+
+    //! \brief Creates a sink which appends to the file at \p path.
+    //!
+    //! Throws \p std::system_error, if the file cannot be opened.
+    explicit
+    TextSink(const char* path, const TextSinkOptions& options = TextSinkOptions());
+
+    //! \brief Writes all buffered lines.
+    virtual
+    ~TextSink();
+
+    TextSink(const TextSink&) = delete;
+    TextSink& operator=(const TextSink&) = delete;
+
+    virtual
+    Action process(Diagnostic* diagnostic) override;
+
+    //! \brief Writes the buffered lines of all threads.
+    void flush();
+
+private:
+    //! The buffer of a thread.
+    struct Stage
+    {
+        DIME_STD::mutex mutex;
+        DIME_STD::thread::id owner;
+        TextFormatter formatter;
+        std::vector<char> buffer;
+        std::size_t size = 0;
+    };
+
+    const TextSinkOptions m_options;
+    //! A unique number to identify the sink in the thread-local cache.
+    const std::uint64_t m_id;
+    int m_fd;
+    bool m_ownsFd;
+
+    DIME_STD::mutex m_mutex;
+    std::vector<DIME_STD::unique_ptr<Stage>> m_stages;
+
+
+    Stage& localStage();
+    void write(Stage& stage);
+};
+
+} // namespace dime
+
+#endif // DIME_TEXTFORMAT_HPP
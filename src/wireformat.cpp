@@ -0,0 +1,392 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "wireformat.hpp"
+
+#include <cstring>
+
+using namespace dime;
+using namespace dime_detail;
+
+namespace
+{
+
+//! A table for the byte-wise computation of the CRC-32.
+struct CrcTable
+{
+    constexpr
+    CrcTable()
+        : entries()
+    {
+        for (std::uint32_t idx = 0; idx < 256; ++idx)
+        {
+            std::uint32_t crc = idx;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320u : 0u);
+            entries[idx] = crc;
+        }
+    }
+
+    std::uint32_t entries[256];
+};
+
+constexpr CrcTable crcTable;
+
+//! The number of bytes of the flags and the code in front of the time stamp.
+constexpr std::size_t fixedHeaderSize = 1 + 16;
+
+//! Returns the number of bytes of the flags and the \p code.
+std::size_t codeHeaderSize(const Code& code) noexcept
+{
+    return code.isShort() ? fixedHeaderSize - 8 : fixedHeaderSize;
+}
+
+//! Returns the size of the payload of an argument.
+std::size_t payloadSize(const Argument& argument) noexcept
+{
+    switch (argument.kind())
+    {
+    case ArgumentKind::SignedInteger:
+    case ArgumentKind::UnsignedInteger:
+    case ArgumentKind::Float:
+        return 4;
+    case ArgumentKind::Double:
+        return 8;
+    case ArgumentKind::LongDouble:
+        return 1 + longDoubleSize;
+    case ArgumentKind::String:
+    {
+        std::size_t length = std::strlen(argument.toString().value());
+        return varintSize(length) + length;
+    }
+    }
+    return 0;
+}
+
+unsigned char* writePayload(unsigned char* dest, const Argument& argument) noexcept
+{
+    switch (argument.kind())
+    {
+    case ArgumentKind::SignedInteger:
+        return writeLittleEndian(dest, std::uint32_t(argument.toInteger().value()), 4);
+    case ArgumentKind::UnsignedInteger:
+        return writeLittleEndian(dest, argument.toUnsigned().value(), 4);
+    case ArgumentKind::Float:
+    {
+        float value = argument.toFloat().value();
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, 4);
+        return writeLittleEndian(dest, bits, 4);
+    }
+    case ArgumentKind::Double:
+    {
+        double value = argument.toDouble().value();
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, 8);
+        return writeLittleEndian(dest, bits, 8);
+    }
+    case ArgumentKind::LongDouble:
+    {
+        long double value = argument.toLongDouble().value();
+        *dest++ = static_cast<unsigned char>(longDoubleSize);
+        std::memcpy(dest, &value, longDoubleSize);
+        return dest + longDoubleSize;
+    }
+    case ArgumentKind::String:
+    {
+        const char* value = argument.toString().value();
+        std::size_t length = std::strlen(value);
+        dest = writeVarint(dest, length);
+        std::memcpy(dest, value, length);
+        return dest + length;
+    }
+    }
+    return dest;
+}
+
+//! Skips the payload of an argument of the given \p kind in [src, end).
+//! Returns \p false, if the payload does not fit.
+bool skipPayload(ArgumentKind kind, const unsigned char*& src,
+                 const unsigned char* end, std::size_t& size) noexcept
+{
+    std::uint64_t length;
+    switch (kind)
+    {
+    case ArgumentKind::SignedInteger:
+    case ArgumentKind::UnsignedInteger:
+    case ArgumentKind::Float:
+        length = 4;
+        break;
+    case ArgumentKind::Double:
+        length = 8;
+        break;
+    case ArgumentKind::LongDouble:
+        if (src == end)
+            return false;
+        length = *src++;
+        break;
+    case ArgumentKind::String:
+        if (!readVarint(src, end, length))
+            return false;
+        break;
+    default:
+        return false;
+    }
+    if (length > std::uint64_t(end - src))
+        return false;
+    size = std::size_t(length);
+    src += length;
+    return true;
+}
+
+} // anonymous namespace
+
+std::uint32_t dime::crc32(const void* data, std::size_t size, std::uint32_t crc) noexcept
+{
+    const unsigned char* iter = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    while (size--)
+        crc = crcTable.entries[(crc ^ *iter++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+std::size_t dime::encodedSize(const Diagnostic& diagnostic, std::int64_t reference) noexcept
+{
+    std::size_t size = recordPrefixSize + codeHeaderSize(diagnostic.code())
+            + varintSize(zigZagEncode(toNanoseconds(diagnostic.timeStamp()) - reference))
+            + 4 + 1 + diagnostic.numArguments() + recordSuffixSize;
+    if (diagnostic.numRepeats() != 0)
+        size += varintSize(diagnostic.numRepeats());
+    if (diagnostic.samplingWeight() != 1)
+        size += varintSize(diagnostic.samplingWeight());
+    for (unsigned idx = 0; idx < diagnostic.numArguments(); ++idx)
+        size += payloadSize(diagnostic.arguments()[idx]);
+    return size;
+}
+
+std::size_t dime::encode(const Diagnostic& diagnostic, std::int64_t reference,
+                         void* buffer, std::size_t size) noexcept
+{
+    std::size_t recordSize = encodedSize(diagnostic, reference);
+    if (recordSize > size)
+        return 0;
+
+    unsigned char* begin = static_cast<unsigned char*>(buffer);
+    unsigned char* body = begin + recordPrefixSize;
+    unsigned char* iter = body;
+    const Code& code = diagnostic.code();
+    *iter++ = (diagnostic.droppable() ? RecordDroppable : 0)
+              | (code.isShort() ? RecordShortCode : 0)
+              | (diagnostic.numRepeats() != 0 ? RecordRepeated : 0)
+              | (diagnostic.samplingWeight() != 1 ? RecordSampled : 0);
+    iter = writeLittleEndian(iter, code[0], 8);
+    if (!code.isShort())
+        iter = writeLittleEndian(iter, code[1], 8);
+    iter = writeVarint(iter, zigZagEncode(toNanoseconds(diagnostic.timeStamp()) - reference));
+    iter = writeLittleEndian(iter, diagnostic.uniqueId(), 4);
+    if (diagnostic.numRepeats() != 0)
+        iter = writeVarint(iter, diagnostic.numRepeats());
+    if (diagnostic.samplingWeight() != 1)
+        iter = writeVarint(iter, diagnostic.samplingWeight());
+    *iter++ = static_cast<unsigned char>(diagnostic.numArguments());
+    for (unsigned idx = 0; idx < diagnostic.numArguments(); ++idx)
+        *iter++ = static_cast<unsigned char>(diagnostic.arguments()[idx].kind());
+    for (unsigned idx = 0; idx < diagnostic.numArguments(); ++idx)
+        iter = writePayload(iter, diagnostic.arguments()[idx]);
+
+    std::size_t bodySize = std::size_t(iter - body);
+    writeLittleEndian(begin, bodySize, 4);
+    writeLittleEndian(iter, crc32(body, bodySize), 4);
+    return recordSize;
+}
+
+optional<int> ArgumentView::toInteger() const noexcept
+{
+    return m_kind == ArgumentKind::SignedInteger
+           ? optional<int>(int(std::int32_t(readLittleEndian(m_data, 4))))
+           : optional<int>();
+}
+
+optional<unsigned> ArgumentView::toUnsigned() const noexcept
+{
+    return m_kind == ArgumentKind::UnsignedInteger
+           ? optional<unsigned>(unsigned(readLittleEndian(m_data, 4)))
+           : optional<unsigned>();
+}
+
+optional<float> ArgumentView::toFloat() const noexcept
+{
+    if (m_kind != ArgumentKind::Float)
+        return optional<float>();
+    std::uint32_t bits = std::uint32_t(readLittleEndian(m_data, 4));
+    float value;
+    std::memcpy(&value, &bits, 4);
+    return optional<float>(value);
+}
+
+optional<double> ArgumentView::toDouble() const noexcept
+{
+    if (m_kind != ArgumentKind::Double)
+        return optional<double>();
+    std::uint64_t bits = readLittleEndian(m_data, 8);
+    double value;
+    std::memcpy(&value, &bits, 8);
+    return optional<double>(value);
+}
+
+optional<long double> ArgumentView::toLongDouble() const noexcept
+{
+    if (m_kind != ArgumentKind::LongDouble)
+        return optional<long double>();
+    if (m_size == longDoubleSize)
+    {
+        long double value = 0;
+        std::memcpy(&value, m_data, longDoubleSize);
+        return optional<long double>(value);
+    }
+    if (m_size == sizeof(double))
+    {
+        double value;
+        std::memcpy(&value, m_data, sizeof(double));
+        return optional<long double>(value);
+    }
+    return optional<long double>();
+}
+
+bool RecordView::parse(const unsigned char* body, std::size_t size) noexcept
+{
+    const unsigned char* iter = body;
+    const unsigned char* end = body + size;
+    std::uint64_t timeStamp;
+    if (size < fixedHeaderSize - 8)
+        return false;
+    m_flags = *iter++;
+    m_code.data[0] = readLittleEndian(iter, 8);
+    iter += 8;
+    if (m_flags & RecordShortCode)
+    {
+        m_code.data[1] = 0;
+    }
+    else
+    {
+        if (size < fixedHeaderSize)
+            return false;
+        m_code.data[1] = readLittleEndian(iter, 8);
+        iter += 8;
+    }
+    if (!readVarint(iter, end, timeStamp) || end - iter < 5)
+        return false;
+    m_timeStamp = zigZagDecode(timeStamp);
+    m_uniqueId = UniqueId(readLittleEndian(iter, 4));
+    iter += 4;
+    m_numRepeats = 0;
+    if (m_flags & RecordRepeated)
+    {
+        std::uint64_t numRepeats;
+        if (!readVarint(iter, end, numRepeats) || numRepeats > 0xFFFFFFFFu || iter == end)
+            return false;
+        m_numRepeats = std::uint32_t(numRepeats);
+    }
+    m_samplingWeight = 1;
+    if (m_flags & RecordSampled)
+    {
+        std::uint64_t weight;
+        if (!readVarint(iter, end, weight) || weight > 0xFFFFFFFFu || iter == end)
+            return false;
+        m_samplingWeight = std::uint32_t(weight);
+    }
+    m_numArguments = *iter++;
+    if (std::size_t(end - iter) < m_numArguments)
+        return false;
+    m_arguments = iter;
+    iter += m_numArguments;
+    for (unsigned idx = 0; idx < m_numArguments; ++idx)
+    {
+        std::size_t payloadSize;
+        if (!skipPayload(ArgumentKind(m_arguments[idx]), iter, end, payloadSize))
+            return false;
+    }
+    if (iter != end)
+        return false;
+
+    m_body = body;
+    m_bodySize = size;
+    return true;
+}
+
+ArgumentView RecordView::argument(unsigned index) const noexcept
+{
+    const unsigned char* iter = m_arguments + m_numArguments;
+    const unsigned char* end = m_body + m_bodySize;
+    std::size_t size = 0;
+    for (unsigned idx = 0; idx < index; ++idx)
+        skipPayload(ArgumentKind(m_arguments[idx]), iter, end, size);
+
+    // The payload is located at the end of the skipped range, i.e. after
+    // the length prefix if there is one.
+    ArgumentKind kind = ArgumentKind(m_arguments[index]);
+    skipPayload(kind, iter, end, size);
+    return ArgumentView(kind, iter - size, size);
+}
+
+bool RecordReader::next(RecordView& view) noexcept
+{
+    std::size_t remaining = m_size - m_offset;
+    if (remaining == 0)
+        return false;
+    if (remaining < recordPrefixSize)
+    {
+        m_status = Status::Truncated;
+        return false;
+    }
+    const unsigned char* begin = m_data + m_offset;
+    std::size_t bodySize = std::size_t(readLittleEndian(begin, 4));
+    if (remaining < recordPrefixSize + recordSuffixSize
+        || bodySize > remaining - recordPrefixSize - recordSuffixSize)
+    {
+        m_status = Status::Truncated;
+        return false;
+    }
+
+    const unsigned char* body = begin + recordPrefixSize;
+    const unsigned char* end = body + bodySize;
+    if (crc32(body, bodySize) != readLittleEndian(end, 4))
+    {
+        m_status = Status::Corrupt;
+        return false;
+    }
+
+    if (!view.parse(body, bodySize))
+    {
+        m_status = Status::Corrupt;
+        return false;
+    }
+
+    m_offset += recordPrefixSize + bodySize + recordSuffixSize;
+    return true;
+}
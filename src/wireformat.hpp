@@ -0,0 +1,440 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef DIME_WIREFORMAT_HPP
+#define DIME_WIREFORMAT_HPP
+
+#include "argument.hpp"
+#include "code.hpp"
+#include "diagnostic.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace dime
+{
+
+// The binary record format of a diagnostic
+// ========================================
+//
+// A record is framed by its length and a checksum. All integers are
+// little-endian.
+//
+//     u32      length of the body in bytes
+//     body:
+//       u8     flags (RecordFlags)
+//       u64    first word of the code
+//       u64    second word of the code (omitted for a short code)
+//       varint time stamp in ns relative to a reference (zig-zag encoded)
+//       u32    unique ID
+//       varint number of merged repeats (only with RecordRepeated)
+//       varint sampling weight (only with RecordSampled)
+//       u8     number of arguments
+//       u8     kind of every argument (ArgumentKind)
+//       ...    payload of every argument
+//     u32      CRC-32 of the body
+//
+// The payload of an argument depends on its kind:
+// - SignedInteger, UnsignedInteger, Float: 4 bytes
+// - Double: 8 bytes
+// - LongDouble: u8 size followed by the bytes of the native representation
+//   (only portable between hosts with the same format)
+// - String: varint length followed by the characters without terminator
+//
+// If the RecordShortCode flag is set, the code has at most 10 characters and
+// only its first word is stored. The second word is zero.
+//
+// A record with the RecordRepeated flag summarizes the repeats of an earlier
+// record with the same unique ID (see Diagnostic::numRepeats()). Its time
+// stamp is the one of the last repeat.
+//
+// A record with the RecordSampled flag has been published by sampling and
+// stands for the number of diagnostics given by its weight. Records without
+// the flag have a weight of one.
+//
+// The reference for the time stamp is chosen by the container of the
+// records, e.g. the time stamp of the previous record in a stream.
+
+namespace dime_detail
+{
+
+inline
+unsigned char* writeLittleEndian(unsigned char* dest, std::uint64_t value,
+                                 unsigned numBytes) noexcept
+{
+    for (unsigned idx = 0; idx < numBytes; ++idx, value >>= 8)
+        *dest++ = static_cast<unsigned char>(value);
+    return dest;
+}
+
+inline
+std::uint64_t readLittleEndian(const unsigned char* src, unsigned numBytes) noexcept
+{
+    std::uint64_t value = 0;
+    for (unsigned idx = numBytes; idx > 0; --idx)
+        value = (value << 8) | src[idx - 1];
+    return value;
+}
+
+//! Returns the number of bytes of the variable-length encoding of \p value.
+inline
+std::size_t varintSize(std::uint64_t value) noexcept
+{
+    std::size_t size = 1;
+    for (; value >= 0x80; value >>= 7)
+        ++size;
+    return size;
+}
+
+//! Writes \p value with 7 bits per byte. The highest bit of a byte is set,
+//! if another byte follows.
+inline
+unsigned char* writeVarint(unsigned char* dest, std::uint64_t value) noexcept
+{
+    for (; value >= 0x80; value >>= 7)
+        *dest++ = static_cast<unsigned char>(value | 0x80);
+    *dest++ = static_cast<unsigned char>(value);
+    return dest;
+}
+
+//! Reads a varint from [\p src, \p end) and advances \p src. Returns
+//! \p false, if the data ends before the varint or if it is too long.
+inline
+bool readVarint(const unsigned char*& src, const unsigned char* end,
+                std::uint64_t& value) noexcept
+{
+    value = 0;
+    for (unsigned shift = 0; src != end && shift < 64; shift += 7)
+    {
+        unsigned char byte = *src++;
+        value |= std::uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+//! Maps signed integers to unsigned ones such that values with a small
+//! magnitude have a short varint encoding.
+inline
+std::uint64_t zigZagEncode(std::int64_t value) noexcept
+{
+    return (std::uint64_t(value) << 1) ^ std::uint64_t(value >> 63);
+}
+
+inline
+std::int64_t zigZagDecode(std::uint64_t value) noexcept
+{
+    return std::int64_t(value >> 1) ^ -std::int64_t(value & 1);
+}
+
+} // namespace dime_detail
+
+//! \brief Flags in the header of a record.
+enum RecordFlags : std::uint8_t
+{
+    //! Set if the diagnostic is droppable.
+    RecordDroppable = 0x01,
+    //! Set if the code is short and only its first word is stored.
+    RecordShortCode = 0x02,
+    //! Set if the record summarizes repeats of an earlier record.
+    RecordRepeated = 0x04,
+    //! Set if the record carries a sampling weight.
+    RecordSampled = 0x08
+};
+
+//! The number of bytes in front of the body of a record.
+constexpr std::size_t recordPrefixSize = 4;
+//! The number of bytes after the body of a record.
+constexpr std::size_t recordSuffixSize = 4;
+
+//! \brief Converts a time stamp to nanoseconds since the epoch of the clock.
+inline
+std::int64_t toNanoseconds(const Diagnostic::TimePoint& timeStamp) noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                timeStamp.time_since_epoch()).count();
+}
+
+//! \brief Returns the size of the record of a \p diagnostic.
+//!
+//! Returns the number of bytes which encode(\p diagnostic, \p reference, ...)
+//! writes including the framing.
+std::size_t encodedSize(const Diagnostic& diagnostic, std::int64_t reference) noexcept;
+
+//! \brief Encodes a diagnostic.
+//!
+//! Writes the record of \p diagnostic into the \p size bytes at \p buffer.
+//! The time stamp is stored relative to \p reference, which is given in
+//! nanoseconds. Returns the number of bytes written or zero, if the buffer
+//! is too small.
+std::size_t encode(const Diagnostic& diagnostic, std::int64_t reference,
+                   void* buffer, std::size_t size) noexcept;
+
+//! \brief Computes the CRC-32 (IEEE 802.3) of \p size bytes at \p data.
+std::uint32_t crc32(const void* data, std::size_t size,
+                    std::uint32_t crc = 0) noexcept;
+
+//! \brief A view of an encoded argument.
+//!
+//! A string is not copied but refers to the bytes in the record. It is
+//! not null-terminated.
+class ArgumentView
+{
+public:
+    ArgumentView() noexcept
+        : m_data(nullptr),
+          m_size(0),
+          m_kind(ArgumentKind::SignedInteger)
+    {
+    }
+
+    ArgumentView(ArgumentKind kind, const unsigned char* data, std::size_t size) noexcept
+        : m_data(data),
+          m_size(size),
+          m_kind(kind)
+    {
+    }
+
+    ArgumentKind kind() const noexcept
+    {
+        return m_kind;
+    }
+
+    optional<int> toInteger() const noexcept;
+    optional<unsigned> toUnsigned() const noexcept;
+    optional<float> toFloat() const noexcept;
+    optional<double> toDouble() const noexcept;
+    optional<long double> toLongDouble() const noexcept;
+
+    //! \brief Returns the characters of a string argument.
+    //!
+    //! The characters are not null-terminated. Use stringSize() to get
+    //! their number. Returns a null pointer, if the argument is not a string.
+    const char* stringData() const noexcept
+    {
+        return m_kind == ArgumentKind::String
+               ? reinterpret_cast<const char*>(m_data)
+               : nullptr;
+    }
+
+    //! \brief Returns the number of characters of a string argument.
+    std::size_t stringSize() const noexcept
+    {
+        return m_kind == ArgumentKind::String ? m_size : 0;
+    }
+
+    //! \brief Returns the encoded payload.
+    //!
+    //! The size prefix of a string or a long double is not included.
+    const unsigned char* data() const noexcept
+    {
+        return m_data;
+    }
+
+    //! \brief Returns the size of the encoded payload.
+    std::size_t size() const noexcept
+    {
+        return m_size;
+    }
+
+private:
+    const unsigned char* m_data;
+    std::size_t m_size;
+    ArgumentKind m_kind;
+};
+
+//! \brief A view of an encoded record.
+//!
+//! The view refers to the bytes of the record and does not copy them.
+class RecordView
+{
+public:
+    RecordView() noexcept
+        : m_body(nullptr),
+          m_bodySize(0),
+          m_arguments(nullptr),
+          m_timeStamp(0),
+          m_code{{0, 0}},
+          m_uniqueId(0),
+          m_numRepeats(0),
+          m_samplingWeight(1),
+          m_numArguments(0),
+          m_flags(0)
+    {
+    }
+
+    //! \brief Parses the body of a record.
+    //!
+    //! Lets the view refer to the \p size bytes of a body at \p body, which
+    //! is not framed by a length and a checksum. Returns \p false, if the
+    //! body is malformed.
+    bool parse(const unsigned char* body, std::size_t size) noexcept;
+
+    //! \brief Returns the code.
+    const Code& code() const noexcept
+    {
+        return m_code;
+    }
+
+    //! \brief Returns the time stamp relative to the reference.
+    std::int64_t relativeTimeStamp() const noexcept
+    {
+        return m_timeStamp;
+    }
+
+    //! \brief Returns the time stamp in nanoseconds.
+    //!
+    //! The \p reference must be the one which has been used for encoding.
+    std::int64_t timeStamp(std::int64_t reference) const noexcept
+    {
+        return std::int64_t(std::uint64_t(reference) + std::uint64_t(m_timeStamp));
+    }
+
+    //! \brief Returns the unique ID.
+    UniqueId uniqueId() const noexcept
+    {
+        return m_uniqueId;
+    }
+
+    //! \brief Checks if the diagnostic is droppable.
+    bool droppable() const noexcept
+    {
+        return (m_flags & RecordDroppable) != 0;
+    }
+
+    //! \brief Returns the number of merged repeats.
+    std::uint32_t numRepeats() const noexcept
+    {
+        return m_numRepeats;
+    }
+
+    //! \brief Returns the sampling weight.
+    std::uint32_t samplingWeight() const noexcept
+    {
+        return m_samplingWeight;
+    }
+
+    //! \brief Returns the flags.
+    std::uint8_t flags() const noexcept
+    {
+        return m_flags;
+    }
+
+    //! \brief Returns the number of arguments.
+    unsigned numArguments() const noexcept
+    {
+        return m_numArguments;
+    }
+
+    //! \brief Returns the \p index-th argument.
+    //!
+    //! Requires that \p index is less than numArguments().
+    ArgumentView argument(unsigned index) const noexcept;
+
+    //! \brief Returns the body of the record.
+    const unsigned char* body() const noexcept
+    {
+        return m_body;
+    }
+
+    //! \brief Returns the size of the body of the record.
+    std::size_t bodySize() const noexcept
+    {
+        return m_bodySize;
+    }
+
+private:
+    const unsigned char* m_body;
+    std::size_t m_bodySize;
+    //! Points to the kinds of the arguments, which are followed by the
+    //! payloads.
+    const unsigned char* m_arguments;
+    std::int64_t m_timeStamp;
+    Code m_code;
+    UniqueId m_uniqueId;
+    std::uint32_t m_numRepeats;
+    std::uint32_t m_samplingWeight;
+    unsigned m_numArguments;
+    std::uint8_t m_flags;
+};
+
+//! \brief Reads a sequence of records from a byte span.
+class RecordReader
+{
+public:
+    enum class Status
+    {
+        //! All records so far have been valid.
+        Ok,
+        //! The data ends in the middle of a record.
+        Truncated,
+        //! A record has a wrong checksum or is malformed.
+        Corrupt
+    };
+
+    //! \brief Creates a reader for the \p size bytes at \p data.
+    RecordReader(const void* data, std::size_t size) noexcept
+        : m_data(static_cast<const unsigned char*>(data)),
+          m_size(size),
+          m_offset(0),
+          m_status(Status::Ok)
+    {
+    }
+
+    //! \brief Reads the next record.
+    //!
+    //! Returns \p true and fills the \p view with the next record. Returns
+    //! \p false at the end of the data or if the next record is invalid.
+    //! In the latter case, status() tells the reason and the offset stays
+    //! at the start of the invalid record.
+    bool next(RecordView& view) noexcept;
+
+    //! \brief Returns the offset of the next record.
+    std::size_t offset() const noexcept
+    {
+        return m_offset;
+    }
+
+    //! \brief Returns the status of the reader.
+    Status status() const noexcept
+    {
+        return m_status;
+    }
+
+private:
+    const unsigned char* m_data;
+    std::size_t m_size;
+    std::size_t m_offset;
+    Status m_status;
+};
+
+} // namespace dime
+
+#endif // DIME_WIREFORMAT_HPP
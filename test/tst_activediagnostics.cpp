@@ -0,0 +1,144 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/activediagnostics.hpp"
+#include "../src/engine.hpp"
+
+#include <thread>
+#include <vector>
+
+using namespace dime;
+
+
+SCENARIO("active conditions are tracked", "[activediagnostics]")
+{
+    Descriptor<void(int)> txFault("NET_TX_FAULT", "");
+    Descriptor<void(int)> rxFault("NET_RX_FAULT", "");
+    Descriptor<void(int)> linkDown("NET_LINK_DOWN", "");
+    Descriptor<void(int)> overheat("TEMP_HIGH", "");
+
+    Engine engine;
+    ActiveDiagnostics table(16);
+    engine.subscribe("*", &table);
+    REQUIRE(table.size() == 0);
+    REQUIRE(!table.isActive(txFault.m_code));
+    REQUIRE(!table.find(txFault.m_code));
+
+    GIVEN("published conditions")
+    {
+        engine.publish(txFault, 1);
+        engine.publish(rxFault, 2);
+        engine.publish(overheat, 3);
+        engine.publish(txFault, 4);
+        engine.publish(linkDown, 5);
+
+        THEN("they are active")
+        {
+            REQUIRE(table.size() == 4);
+            REQUIRE(table.isActive(txFault.m_code));
+            REQUIRE(table.isActive(overheat.m_code));
+
+            auto state = table.find(txFault.m_code);
+            REQUIRE(state);
+            REQUIRE(state.value().code == txFault.m_code);
+            REQUIRE(state.value().numOccurrences == 2);
+            REQUIRE(state.value().lastSeen > state.value().firstSeen);
+        }
+
+        THEN("they are listed by pattern")
+        {
+            auto active = table.list("NET*");
+            REQUIRE(active.size() == 3);
+            REQUIRE(active[0].code == linkDown.m_code);
+            REQUIRE(active[1].code == rxFault.m_code);
+            REQUIRE(active[2].code == txFault.m_code);
+
+            REQUIRE(table.list("*").size() == 4);
+            REQUIRE(table.list("NET_?X*").size() == 2);
+            REQUIRE(table.list("NET_TX_FAULT*").size() == 1);
+            REQUIRE(table.list("TEMP").size() == 0);
+            REQUIRE(table.list("DISK*").size() == 0);
+        }
+
+        WHEN("a condition is cleared")
+        {
+            REQUIRE(table.clear(txFault.m_code));
+            REQUIRE(!table.clear(txFault.m_code));
+            REQUIRE(!table.clear(makeCode("UNKNOWN")));
+
+            THEN("it is inactive")
+            {
+                REQUIRE(!table.isActive(txFault.m_code));
+                REQUIRE(table.size() == 3);
+                REQUIRE(table.list("NET_T*").size() == 0);
+            }
+
+            THEN("it is activated again by the next diagnostic")
+            {
+                engine.publish(txFault, 6);
+                auto state = table.find(txFault.m_code);
+                REQUIRE(state);
+                REQUIRE(state.value().numOccurrences == 1);
+                REQUIRE(state.value().firstSeen == state.value().lastSeen);
+            }
+        }
+    }
+
+    GIVEN("more codes than the capacity")
+    {
+        ActiveDiagnostics small(1);
+        engine.subscribe("*", &small);
+        engine.publish(txFault, 1);
+        engine.publish(rxFault, 2);
+        REQUIRE(small.isActive(txFault.m_code));
+        REQUIRE(!small.isActive(rxFault.m_code));
+    }
+}
+
+SCENARIO("active conditions are updated concurrently", "[activediagnostics]")
+{
+    Descriptor<void(int)> fault("FAULT", "");
+    Engine engine;
+    ActiveDiagnostics table;
+    engine.subscribe("*", &table);
+
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < 4; ++thread)
+    {
+        threads.emplace_back([&] {
+            for (int count = 0; count < 1000; ++count)
+                engine.publish(fault, int(count));
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    REQUIRE(table.find(fault.m_code).value().numOccurrences == 4000);
+}
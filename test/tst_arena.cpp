@@ -0,0 +1,61 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/arena.hpp"
+#include "../src/engine.hpp"
+
+#include <cstdint>
+
+using namespace dime;
+
+
+SCENARIO("an arena provides pre-faulted memory", "[arena]")
+{
+    ArenaOptions options;
+    options.hugePages = ArenaOptions::HugePages::Transparent;
+    MemoryArena arena(100000, options);
+
+    REQUIRE(arena.size() >= 100000);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(arena.data()) % DIME_CACHE_LINE_SIZE == 0);
+    REQUIRE(!arena.locked());
+
+    char* memory = static_cast<char*>(arena.data());
+    memory[0] = 1;
+    memory[arena.size() - 1] = 2;
+}
+
+SCENARIO("an engine uses a fixed-size arena", "[arena]")
+{
+    Descriptor<void(int)> desc("ARENA", "");
+    Engine engine(1 << 16);
+
+    for (int count = 0; count < 10000; ++count)
+        engine.publish(desc, int(count));
+}
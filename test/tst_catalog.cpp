@@ -0,0 +1,146 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/catalog.hpp"
+#include "../src/engine.hpp"
+#include "../src/textformat.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace dime;
+
+
+namespace
+{
+
+DIME_DESCRIPTOR(pumpSpeed, void(int, int), "CAT_PUMP", "speed {0} above {1:d}");
+DIME_DESCRIPTOR(pumpName, void(const char*), "CAT_NAME", "pump {0:s} stopped");
+DIME_DESCRIPTOR(pumpIdle, void(), "CAT_IDLE", "idle");
+
+std::string explain(const CatalogEntry& entry, const Diagnostic& diagnostic)
+{
+    std::vector<char> buffer(TextFormatter::maxExplanationSize(entry.explanation, diagnostic));
+    return std::string(buffer.data(), TextFormatter::formatExplanation(
+                                          entry.explanation, diagnostic, buffer.data()));
+}
+
+} // anonymous namespace
+
+
+SCENARIO("descriptors place their explanations in the catalog", "[catalog]")
+{
+    // The descriptors carry no explanation themselves.
+    REQUIRE(pumpSpeed.m_explanation.numSegments() == 0);
+
+    Catalog catalog;
+    REQUIRE(catalog.loadBinary());
+    REQUIRE(catalog.size() >= 3);
+
+    const CatalogEntry* entry = catalog.find(makeCode("CAT_PUMP"));
+    REQUIRE(entry != nullptr);
+    REQUIRE(std::string(entry->text) == "speed {0} above {1:d}");
+    REQUIRE(entry->kinds.size() == 2);
+    REQUIRE(entry->kinds[0] == ArgumentKind::SignedInteger);
+
+    entry = catalog.find(makeCode("CAT_IDLE"));
+    REQUIRE(entry != nullptr);
+    REQUIRE(entry->kinds.empty());
+    REQUIRE(catalog.find(makeCode("CAT_NONE")) == nullptr);
+
+    GIVEN("diagnostics which are created from the descriptors")
+    {
+        Allocator a;
+        Diagnostic* speed = Diagnostic::create(a, pumpSpeed, 1500, 1200);
+        Diagnostic* name = Diagnostic::create(a, pumpName, static_cast<const char*>("P1"));
+
+        THEN("they are explained with the catalog")
+        {
+            REQUIRE(explain(*catalog.find(speed->code()), *speed) == "speed 1500 above 1200");
+            REQUIRE(explain(*catalog.find(name->code()), *name) == "pump P1 stopped");
+        }
+
+        a.deallocate(speed);
+        a.deallocate(name);
+    }
+
+    GIVEN("a catalog file")
+    {
+        const char* path = "tst_catalog.catalog";
+        REQUIRE(catalog.writeFile(path));
+
+        Catalog loaded;
+        REQUIRE(loaded.loadFile(path));
+        REQUIRE(loaded.size() == catalog.size());
+        entry = loaded.find(makeCode("CAT_NAME"));
+        REQUIRE(entry != nullptr);
+        REQUIRE(std::string(entry->text) == "pump {0:s} stopped");
+        REQUIRE(entry->kinds[0] == ArgumentKind::String);
+        std::remove(path);
+    }
+}
+
+SCENARIO("catalog records are validated", "[catalog]")
+{
+    Catalog catalog;
+
+    GIVEN("records with padding")
+    {
+        const char data[] = "\0\0\xD1\x01\xFF" "A\0" "{0}\0" "\0\xD1\xFF" "B\0" "b";
+        REQUIRE(catalog.load(data, sizeof(data)));
+        REQUIRE(catalog.size() == 2);
+        REQUIRE(catalog.find(makeCode("A"))->kinds[0] == ArgumentKind::UnsignedInteger);
+        REQUIRE(std::string(catalog.find(makeCode("B"))->text) == "b");
+    }
+
+    GIVEN("duplicate codes")
+    {
+        const char data[] = "\xD1\xFF" "A\0" "first\0" "\xD1\xFF" "A\0" "second";
+        REQUIRE(catalog.load(data, sizeof(data)));
+        REQUIRE(catalog.size() == 1);
+        REQUIRE(std::string(catalog.find(makeCode("A"))->text) == "first");
+    }
+
+    GIVEN("malformed records")
+    {
+        const char badMarker[] = "\xD2\xFF" "A\0" "a";
+        const char badKind[] = "\xD1\x09\xFF" "A\0" "a";
+        const char badCode[] = "\xD1\xFF" "A.B\0" "a";
+        const char badText[] = "\xD1\xFF" "A\0" "{0}";
+        const char truncated[] = {'\xD1', '\xFF', 'A', '\0', 'a'};
+        REQUIRE(!catalog.load(badMarker, sizeof(badMarker)));
+        REQUIRE(!catalog.load(badKind, sizeof(badKind)));
+        REQUIRE(!catalog.load(badCode, sizeof(badCode)));
+        REQUIRE(!catalog.load(badText, sizeof(badText)));
+        REQUIRE(!catalog.load(truncated, sizeof(truncated)));
+        REQUIRE(catalog.size() == 0);
+    }
+}
@@ -30,6 +30,10 @@
 
 #include "../src/code.hpp"
 
+#include <cstring>
+#include <random>
+#include <string>
+
 using namespace dime;
 
 
@@ -39,3 +43,110 @@ SCENARIO("codes are constexpr", "[code]")
     static_assert(id[0] == 182712931821039745, "");
     static_assert(id[1] == 182712931821039745, "");
 }
+
+SCENARIO("short codes fit into the first word", "[code]")
+{
+    static_assert(makeCode("").isShort(), "");
+    static_assert(makeCode("0123456789").isShort(), "");
+    static_assert(!makeCode("01234567890").isShort(), "");
+
+    static_assert(makeCode("NET_TX") == makeCode("NET_TX"), "");
+    static_assert(makeCode("NET_TX") != makeCode("NET_RX"), "");
+    static_assert(makeCode("0123456789A") != makeCode("0123456789B"), "");
+}
+
+SCENARIO("codes are written as characters", "[code]")
+{
+    char buffer[20];
+
+    GIVEN("a code which is shorter than 20 characters")
+    {
+        Code id = makeCode("NET_TX");
+        THEN("the padding is not counted")
+        {
+            REQUIRE(id.toChars(buffer) == 6);
+            REQUIRE(std::string(buffer, 6) == "NET_TX");
+            REQUIRE(std::string(buffer, 20) == id.toString());
+        }
+    }
+
+    GIVEN("a code with 20 characters")
+    {
+        Code id = makeCode("01234567890123456789");
+        REQUIRE(id.toChars(buffer) == 20);
+        REQUIRE(std::string(buffer, 20) == "01234567890123456789");
+    }
+}
+
+SCENARIO("codes are parsed at run-time", "[code]")
+{
+    Code code{0, 0};
+
+    GIVEN("valid codes")
+    {
+        REQUIRE(parseCode("", 0, code));
+        REQUIRE(code.data[0] == 0);
+        REQUIRE(code.data[1] == 0);
+
+        REQUIRE(parseCode("NET_TX", 6, code));
+        REQUIRE(code.data[0] == makeCode("NET_TX")[0]);
+        REQUIRE(code.data[1] == makeCode("NET_TX")[1]);
+
+        const char* text = "01234567890123456789";
+        REQUIRE(parseCode(text, 20, code));
+        REQUIRE(code.data[0] == makeCode(text)[0]);
+        REQUIRE(code.data[1] == makeCode(text)[1]);
+    }
+
+    GIVEN("a text which is not null-terminated")
+    {
+        REQUIRE(parseCode("ABCDEF*", 3, code));
+        REQUIRE(code.data[0] == makeCode("ABC")[0]);
+        REQUIRE(code.data[1] == makeCode("ABC")[1]);
+    }
+
+    GIVEN("invalid codes")
+    {
+        REQUIRE(!parseCode("012345678901234567890", 21, code));
+        REQUIRE(!parseCode("NET.TX", 6, code));
+        REQUIRE(!parseCode("NET TX", 6, code));
+        REQUIRE(!parseCode("0123456789012345678*", 20, code));
+        REQUIRE(!parseCode("\x80", 1, code));
+        REQUIRE(!parseCode("AB\xFF", 3, code));
+        REQUIRE(!parseCode("A\0B", 3, code));
+    }
+
+    GIVEN("random codes")
+    {
+        const char alphabet[] = "-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ_"
+                                "abcdefghijklmnopqrstuvwxyz";
+        std::mt19937 generator(1);
+        std::uniform_int_distribution<int> lengths(0, 20);
+        std::uniform_int_distribution<int> symbols(0, 63);
+        int numMismatches = 0;
+        for (int count = 0; count < 10000; ++count)
+        {
+            char text[21] = {0};
+            int length = lengths(generator);
+            for (int idx = 0; idx < length; ++idx)
+                text[idx] = alphabet[symbols(generator)];
+
+            Code expected = makeCode(text);
+            if (!parseCode(text, std::strlen(text), code)
+                || code.data[0] != expected[0] || code.data[1] != expected[1])
+            {
+                ++numMismatches;
+            }
+
+            char chars[20];
+            std::size_t numChars = expected.toChars(chars);
+            std::string padded = expected.toString();
+            if (std::string(chars, 20) != padded
+                || numChars != padded.find_last_not_of('-') + 1)
+            {
+                ++numMismatches;
+            }
+        }
+        REQUIRE(numMismatches == 0);
+    }
+}
@@ -0,0 +1,133 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/codeinterner.hpp"
+
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dime;
+
+
+SCENARIO("codes are interned", "[codeinterner]")
+{
+    CodeInterner interner(3);
+    REQUIRE(interner.capacity() == 3);
+    REQUIRE(interner.size() == 0);
+    REQUIRE(interner.find(makeCode("NET_TX")) == CodeInterner::invalidId);
+    Code code;
+    REQUIRE(!interner.code(0, code));
+
+    GIVEN("interned codes")
+    {
+        REQUIRE(interner.intern(makeCode("NET_TX")) == 0);
+        REQUIRE(interner.intern(makeCode("NET_TX_QUEUE_FULL")) == 1);
+        REQUIRE(interner.intern(makeCode("NET_TX")) == 0);
+        REQUIRE(interner.size() == 2);
+
+        THEN("the codes are found")
+        {
+            REQUIRE(interner.find(makeCode("NET_TX")) == 0);
+            REQUIRE(interner.find(makeCode("NET_TX_QUEUE_FULL")) == 1);
+            REQUIRE(interner.find(makeCode("NET_RX")) == CodeInterner::invalidId);
+        }
+
+        THEN("the identifiers map back to the codes")
+        {
+            REQUIRE(interner.code(0, code));
+            REQUIRE(code == makeCode("NET_TX"));
+            REQUIRE(interner.code(1, code));
+            REQUIRE(code == makeCode("NET_TX_QUEUE_FULL"));
+            REQUIRE(!interner.code(2, code));
+            REQUIRE(!interner.code(CodeInterner::invalidId, code));
+        }
+
+        WHEN("the interner is full")
+        {
+            REQUIRE(interner.intern(makeCode("NET_RX")) == 2);
+            REQUIRE(interner.intern(makeCode("NET_ERROR")) == CodeInterner::invalidId);
+
+            THEN("known codes are still interned")
+            {
+                REQUIRE(interner.intern(makeCode("NET_RX")) == 2);
+                REQUIRE(interner.intern(makeCode("NET_TX")) == 0);
+                REQUIRE(interner.size() == 3);
+            }
+        }
+    }
+}
+
+SCENARIO("codes are interned concurrently", "[codeinterner]")
+{
+    const unsigned numCodes = 1000;
+    const unsigned numThreads = 4;
+    CodeInterner interner(numCodes);
+
+    // Every thread interns all codes, starting at a different one. Half of
+    // the codes share their first word.
+    auto text = [](unsigned index) {
+        return (index % 2 != 0 ? "CODE_" : "SHARED_WORD_") + std::to_string(index);
+    };
+    std::vector<std::vector<std::uint32_t>> ids(numThreads,
+                                                std::vector<std::uint32_t>(numCodes));
+    std::vector<std::thread> threads;
+    for (unsigned thread = 0; thread < numThreads; ++thread)
+    {
+        threads.emplace_back([&, thread] {
+            for (unsigned count = 0; count < numCodes; ++count)
+            {
+                unsigned index = (count + thread * numCodes / numThreads) % numCodes;
+                ids[thread][index] = interner.intern(makeCode(text(index).c_str()));
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    REQUIRE(interner.size() == numCodes);
+    std::set<std::uint32_t> distinctIds;
+    bool consistent = true;
+    for (unsigned index = 0; index < numCodes; ++index)
+    {
+        Code expected = makeCode(text(index).c_str());
+        std::uint32_t id = ids[0][index];
+        distinctIds.insert(id);
+        for (unsigned thread = 1; thread < numThreads; ++thread)
+            consistent = consistent && ids[thread][index] == id;
+        Code code;
+        consistent = consistent && interner.find(expected) == id
+                     && interner.code(id, code) && code == expected;
+    }
+    REQUIRE(consistent);
+    REQUIRE(distinctIds.size() == numCodes);
+    REQUIRE(*distinctIds.rbegin() == numCodes - 1);
+}
@@ -38,6 +38,33 @@ SCENARIO("basic diagnostic", "[diagnostic]")
     Allocator a;
 }
 
+SCENARIO("diagnostic blocks fill whole cache lines", "[diagnostic]")
+{
+    REQUIRE(Diagnostic::blockSize(0) % DIME_CACHE_LINE_SIZE == 0);
+    REQUIRE(Diagnostic::blockSize(5) % DIME_CACHE_LINE_SIZE == 0);
+    REQUIRE(Diagnostic::blockSize(inlineArguments) == DIME_CACHE_LINE_SIZE);
+
+    Allocator a;
+    Descriptor<void(int, float)> desc("ABC", "");
+    Diagnostic* diag = Diagnostic::create(a, desc, 42, 1.5f);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(diag) % DIME_CACHE_LINE_SIZE == 0);
+    REQUIRE(diag->numArguments() == 2);
+    REQUIRE(diag->arguments()[0].toInteger().value() == 42);
+    REQUIRE(diag->arguments()[1].toFloat().value() == 1.5f);
+    a.deallocate(diag);
+}
+
+SCENARIO("diagnostics have unique IDs", "[diagnostic]")
+{
+    Allocator a;
+    Descriptor<void(int)> desc("ID", "");
+    Diagnostic* first = Diagnostic::create(a, desc, 1);
+    Diagnostic* second = Diagnostic::create(a, desc, 1);
+    REQUIRE(second->uniqueId() != first->uniqueId());
+    a.deallocate(first);
+    a.deallocate(second);
+}
+
 
 
 #include "../src/engine.hpp"
@@ -0,0 +1,139 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/diagnostic.hpp"
+#include "../src/diagnosticlist.hpp"
+
+#include <thread>
+#include <vector>
+
+using namespace dime;
+
+
+SCENARIO("diagnostics are linked intrusively", "[list]")
+{
+    Allocator a;
+    Descriptor<void(int)> desc("LIST", "");
+    Diagnostic* d1 = Diagnostic::create(a, desc, 1);
+    Diagnostic* d2 = Diagnostic::create(a, desc, 2);
+    Diagnostic* d3 = Diagnostic::create(a, desc, 3);
+
+    GIVEN("a list")
+    {
+        DiagnosticList list;
+        list.pushBack(d1);
+        list.pushBack(d2);
+        DiagnosticList other;
+        other.pushBack(d3);
+        list.splice(std::move(other));
+        REQUIRE(other.empty());
+
+        THEN("the diagnostics are kept in FIFO order")
+        {
+            REQUIRE(list.popFront() == d1);
+            REQUIRE(list.popFront() == d2);
+            REQUIRE(list.popFront() == d3);
+            REQUIRE(list.popFront() == nullptr);
+        }
+
+        WHEN("the list is pushed onto a stack")
+        {
+            DiagnosticStack stack;
+            stack.push(std::move(list));
+            REQUIRE(list.empty());
+
+            THEN("the front of the list is on top")
+            {
+                REQUIRE(stack.pop() == d1);
+                REQUIRE(stack.pop() == d2);
+                REQUIRE(stack.pop() == d3);
+                REQUIRE(stack.pop() == nullptr);
+            }
+        }
+    }
+
+    GIVEN("a stack")
+    {
+        DiagnosticStack stack;
+        stack.push(d1);
+        stack.push(d2);
+        stack.push(d3);
+
+        DiagnosticList list = stack.takeAll();
+        REQUIRE(stack.empty());
+        REQUIRE(list.popFront() == d3);
+        REQUIRE(list.popFront() == d2);
+        REQUIRE(list.popFront() == d1);
+    }
+
+    a.deallocate(d1);
+    a.deallocate(d2);
+    a.deallocate(d3);
+}
+
+SCENARIO("a queue preserves the order of every producer", "[list]")
+{
+    const int numProducers = 4;
+    const int numDiagnostics = 1000;
+
+    Allocator a;
+    Descriptor<void(int, int)> desc("QUEUE", "");
+    DiagnosticQueue queue;
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < numProducers; ++producer)
+    {
+        producers.emplace_back([&, producer] {
+            for (int count = 0; count < numDiagnostics; ++count)
+                queue.push(Diagnostic::create(a, desc, int(producer), int(count)));
+        });
+    }
+
+    std::vector<int> expected(numProducers, 0);
+    int received = 0;
+    while (received < numProducers * numDiagnostics)
+    {
+        Diagnostic* diag = queue.pop();
+        if (!diag)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        int producer = diag->arguments()[0].toInteger().value();
+        REQUIRE(diag->arguments()[1].toInteger().value() == expected[producer]);
+        ++expected[producer];
+        ++received;
+        a.deallocate(diag);
+    }
+
+    for (auto& thread : producers)
+        thread.join();
+    REQUIRE(queue.pop() == nullptr);
+}
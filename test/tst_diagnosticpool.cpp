@@ -0,0 +1,92 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/diagnostic.hpp"
+#include "../src/diagnosticpool.hpp"
+#include "../src/engine.hpp"
+
+#include <new>
+
+using namespace dime;
+
+
+SCENARIO("diagnostics are referenced by handles", "[pool]")
+{
+    Descriptor<void(int)> desc("POOL", "");
+    DiagnosticPool pool(2);
+
+    Diagnostic* diag = Diagnostic::create(pool, desc, 1);
+    DiagnosticHandle handle = pool.handle(diag);
+    REQUIRE(handle);
+    REQUIRE(sizeof(handle) == 4);
+    REQUIRE(pool.resolve(handle) == diag);
+    REQUIRE(!pool.resolve(DiagnosticHandle()));
+
+    WHEN("the diagnostic is returned to the pool")
+    {
+        pool.deallocate(diag);
+
+        THEN("the handle is stale")
+        {
+            REQUIRE(pool.resolve(handle) == nullptr);
+        }
+
+        THEN("the slot is reused with a new handle")
+        {
+            Diagnostic* other = Diagnostic::create(pool, desc, 2);
+            REQUIRE(other == diag);
+            REQUIRE(pool.handle(other) != handle);
+            REQUIRE(pool.resolve(handle) == nullptr);
+            REQUIRE(pool.resolve(pool.handle(other)) == other);
+            pool.deallocate(other);
+        }
+    }
+}
+
+SCENARIO("an exhausted pool throws", "[pool]")
+{
+    Descriptor<void(int)> desc("POOL", "");
+    DiagnosticPool pool(1);
+
+    Diagnostic* diag = Diagnostic::create(pool, desc, 1);
+    REQUIRE_THROWS_AS(Diagnostic::create(pool, desc, 2), const std::bad_alloc&);
+    REQUIRE_THROWS_AS(pool.allocate(pool.slotSize() + 1), const std::bad_alloc&);
+    pool.deallocate(diag);
+}
+
+SCENARIO("an engine allocates from a pool", "[pool]")
+{
+    Descriptor<void(int)> desc("POOL", "");
+    DiagnosticPool pool(1);
+    Engine engine(pool);
+
+    engine.publish(desc, 1);
+    engine.publish(desc, 2);
+}
@@ -0,0 +1,589 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/engine.hpp"
+#include "../src/subscriber.hpp"
+#include "../src/textformat.hpp"
+#include "../src/wireformat.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dime;
+
+namespace
+{
+
+class Counter : public Subscriber
+{
+public:
+    virtual
+    Action process(Diagnostic* diagnostic) override
+    {
+        if (diagnostic->code() == suppressedDiagnostics.m_code)
+        {
+            ++numReports;
+            numReported += diagnostic->arguments()[0].toUnsigned().value();
+            lastPattern = diagnostic->arguments()[1].toString().value();
+        }
+        else
+        {
+            ++count;
+        }
+        return Action::DropDiagnostic;
+    }
+
+    int count = 0;
+    int numReports = 0;
+    unsigned numReported = 0;
+    std::string lastPattern;
+};
+
+} // anonymous namespace
+
+
+SCENARIO("diagnostics below the severity threshold are dropped", "[engine]")
+{
+    constexpr Descriptor<void(int)> trace("NET_TRACE", "", Severity::Trace);
+    constexpr Descriptor<void(int)> info("NET_INFO", "");
+    constexpr Descriptor<void(int)> error("DISK_ERROR", "", Severity::Error);
+    static_assert(info.severity() == Severity::Info, "");
+
+    Engine engine;
+    Counter counter;
+    engine.subscribe("*", &counter);
+    REQUIRE(engine.threshold() == Severity::Trace);
+
+    GIVEN("the default threshold")
+    {
+        engine.publish(trace, 1);
+        engine.publish(info, 2);
+        engine.publish(error, 3);
+        REQUIRE(counter.count == 3);
+        REQUIRE(engine.enabled(trace));
+    }
+
+    GIVEN("a threshold")
+    {
+        engine.setThreshold(Severity::Warning);
+        REQUIRE(engine.threshold() == Severity::Warning);
+        REQUIRE(!engine.enabled(info));
+        REQUIRE(engine.enabled(error));
+
+        engine.publish(trace, 1);
+        engine.publish(info, 2);
+        engine.publish(error, 3);
+        REQUIRE(counter.count == 1);
+
+        WHEN("a prefix is more verbose")
+        {
+            engine.setThreshold("NET", Severity::Debug);
+            engine.setThreshold("NET_T", Severity::Trace);
+            engine.setThreshold("DISK", Severity::Critical);
+            REQUIRE(engine.enabled(trace));
+            REQUIRE(engine.enabled(info));
+            REQUIRE(!engine.enabled(error));
+
+            engine.publish(trace, 1);
+            engine.publish(info, 2);
+            engine.publish(error, 3);
+            REQUIRE(counter.count == 3);
+
+            THEN("an override can be replaced")
+            {
+                engine.setThreshold("NET", Severity::Error);
+                REQUIRE(!engine.enabled(info));
+                REQUIRE(engine.enabled(trace));
+            }
+
+            THEN("the overrides can be removed")
+            {
+                engine.clearPrefixThresholds();
+                REQUIRE(!engine.enabled(trace));
+                REQUIRE(!engine.enabled(info));
+                REQUIRE(engine.enabled(error));
+            }
+        }
+    }
+
+    GIVEN("an invalid prefix")
+    {
+        REQUIRE_THROWS_AS(engine.setThreshold("NET.", Severity::Debug),
+                          IdentifierTooLongOrWrongChar);
+    }
+}
+
+SCENARIO("the rate of diagnostics is limited", "[engine]")
+{
+    Descriptor<void(int)> tx("NET_TX", "");
+    Descriptor<void(int)> rx("NET_RX", "");
+
+    Engine engine;
+    Counter counter;
+    engine.subscribe("*", &counter);
+
+    RateLimit limit;
+    limit.rate = 1;
+    limit.burst = 3;
+    limit.reportInterval = std::chrono::hours(1);
+    engine.setRateLimit("NET_TX*", limit);
+
+    GIVEN("a flood of diagnostics")
+    {
+        for (int count = 0; count < 10; ++count)
+        {
+            engine.publish(tx, int(count));
+            engine.publish(rx, int(count));
+        }
+
+        THEN("the limited code is suppressed")
+        {
+            REQUIRE(counter.count == 13);
+            REQUIRE(engine.numSuppressed() == 7);
+            REQUIRE(counter.numReports == 0);
+        }
+
+        THEN("non-droppable diagnostics pass")
+        {
+            engine.publish(non_droppable, tx, 10);
+            REQUIRE(counter.count == 14);
+            REQUIRE(engine.numSuppressed() == 7);
+        }
+
+        THEN("the limit can be removed")
+        {
+            engine.clearRateLimits();
+            engine.publish(tx, 10);
+            REQUIRE(counter.count == 14);
+        }
+    }
+
+    GIVEN("a flood which has ended")
+    {
+        limit.reportInterval = std::chrono::milliseconds(100);
+        engine.setRateLimit("NET_TX*", limit);
+        for (int count = 0; count < 10; ++count)
+            engine.publish(tx, int(count));
+        REQUIRE(engine.numSuppressed() == 7);
+
+        WHEN("the suppressed diagnostics are flushed before the report is due")
+        {
+            engine.flushSuppressed();
+            THEN("nothing is reported")
+            {
+                REQUIRE(counter.numReports == 0);
+            }
+        }
+
+        WHEN("the suppressed diagnostics are flushed after the report interval")
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(150));
+            engine.flushSuppressed();
+            THEN("they are reported once")
+            {
+                REQUIRE(counter.numReports == 1);
+                REQUIRE(counter.numReported == 7);
+                REQUIRE(counter.lastPattern == "NET_TX*");
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(150));
+                engine.flushSuppressed();
+                REQUIRE(counter.numReports == 1);
+            }
+        }
+    }
+
+    GIVEN("a pattern with a due report")
+    {
+        limit.rate = 0;
+        limit.reportInterval = std::chrono::nanoseconds(0);
+        engine.setRateLimit("NET*", limit);
+        engine.setRateLimit("NET_RX*", limit);
+
+        for (int count = 0; count < 5; ++count)
+            engine.publish(rx, int(count));
+
+        THEN("the suppressed diagnostics are reported")
+        {
+            REQUIRE(counter.count == 0);
+            REQUIRE(engine.numSuppressed() == 5);
+            REQUIRE(counter.numReports == 5);
+            REQUIRE(counter.numReported == 5);
+            REQUIRE(counter.lastPattern == "NET*");
+        }
+    }
+
+    GIVEN("concurrent publishers")
+    {
+        limit.rate = 1;
+        limit.burst = 100;
+        engine.setRateLimit("NET_RX*", limit);
+
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < 4; ++thread)
+        {
+            threads.emplace_back([&] {
+                for (int count = 0; count < 1000; ++count)
+                    engine.publish(rx, int(count));
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        THEN("the burst is not exceeded")
+        {
+            REQUIRE(counter.count >= 100);
+            REQUIRE(counter.count <= 101);
+            REQUIRE(engine.numSuppressed() == 4000 - unsigned(counter.count));
+        }
+    }
+
+    GIVEN("a bucket per code")
+    {
+        limit.perCode = true;
+        limit.maxCodes = 1;
+        engine.setRateLimit("NET*", limit);
+
+        Descriptor<void(int)> error("NET_ERROR", "");
+        for (int count = 0; count < 10; ++count)
+        {
+            engine.publish(rx, int(count));
+            engine.publish(error, int(count));
+        }
+
+        THEN("every code has its own burst")
+        {
+            // The first code gets its own bucket, the second one takes
+            // the shared bucket.
+            REQUIRE(counter.count == 6);
+            REQUIRE(engine.numSuppressed() == 14);
+        }
+    }
+
+    GIVEN("a limit which is retuned")
+    {
+        limit.perCode = true;
+        limit.maxCodes = 4096;
+        for (unsigned burst = 1000; burst > 0; --burst)
+        {
+            limit.burst = burst;
+            engine.setRateLimit("NET_RX*", limit);
+            engine.clearRateLimits();
+            engine.setRateLimit("NET_RX*", limit);
+        }
+
+        for (int count = 0; count < 10; ++count)
+            engine.publish(rx, int(count));
+
+        THEN("the last parameters apply")
+        {
+            REQUIRE(counter.count == 1);
+            REQUIRE(engine.numSuppressed() == 9);
+        }
+    }
+}
+
+namespace
+{
+
+class Recorder : public Subscriber
+{
+public:
+    explicit
+    Recorder(Engine& engine)
+        : m_engine(engine)
+    {
+    }
+
+    ~Recorder()
+    {
+        for (Diagnostic* diagnostic : diagnostics)
+            m_engine.release(diagnostic);
+    }
+
+    virtual
+    Action process(Diagnostic* diagnostic) override
+    {
+        diagnostics.push_back(diagnostic);
+        return Action::KeepDiagnostic;
+    }
+
+    std::vector<Diagnostic*> diagnostics;
+
+private:
+    Engine& m_engine;
+};
+
+} // anonymous namespace
+
+SCENARIO("repeated diagnostics are coalesced", "[engine]")
+{
+    Descriptor<void(int, const char*)> desc("NET_ERROR", "");
+    Descriptor<void(int)> other("NET_OTHER", "");
+    std::string interface = "eth0";
+    std::string sameInterface = "eth0";
+
+    Engine engine;
+    Recorder recorder(engine);
+    engine.subscribe("*", &recorder);
+    engine.setCoalescingWindow(std::chrono::hours(1));
+
+    GIVEN("repeats within the window")
+    {
+        engine.publish(desc, 1, interface.c_str());
+        engine.publish(desc, 1, sameInterface.c_str());
+        engine.publish(desc, 2, interface.c_str());
+        engine.publish(desc, 1, interface.c_str());
+        engine.publish(other, 1);
+        engine.publish(desc, 1, interface.c_str());
+
+        THEN("only the first instances are dispatched")
+        {
+            REQUIRE(recorder.diagnostics.size() == 3);
+            REQUIRE(recorder.diagnostics[0]->numRepeats() == 0);
+            REQUIRE(recorder.diagnostics[1]->arguments()[0].toInteger().value() == 2);
+            REQUIRE(recorder.diagnostics[2]->code() == other.m_code);
+        }
+
+        WHEN("the repeats are flushed")
+        {
+            engine.flushRepeats();
+
+            THEN("a summary of the repeats is dispatched")
+            {
+                REQUIRE(recorder.diagnostics.size() == 4);
+                Diagnostic* first = recorder.diagnostics[0];
+                Diagnostic* summary = recorder.diagnostics[3];
+                REQUIRE(summary->numRepeats() == 3);
+                REQUIRE(summary->uniqueId() == first->uniqueId());
+                REQUIRE(summary->code() == first->code());
+                REQUIRE(summary->arguments()[0].toInteger().value() == 1);
+                REQUIRE(summary->timeStamp() > first->timeStamp());
+            }
+
+            THEN("the summary is encoded with the number of repeats")
+            {
+                Diagnostic* summary = recorder.diagnostics[3];
+                std::int64_t reference = toNanoseconds(summary->timeStamp());
+                std::vector<unsigned char> buffer(encodedSize(*summary, reference));
+                REQUIRE(encode(*summary, reference, buffer.data(), buffer.size())
+                        == buffer.size());
+
+                RecordReader reader(buffer.data(), buffer.size());
+                RecordView view;
+                REQUIRE(reader.next(view));
+                REQUIRE(view.numRepeats() == 3);
+                REQUIRE(view.uniqueId() == summary->uniqueId());
+                REQUIRE(view.argument(1).stringSize() == 4);
+            }
+
+            THEN("the summary is formatted with the number of repeats")
+            {
+                Diagnostic* summary = recorder.diagnostics[3];
+                std::vector<char> line(TextFormatter::maxLineSize(*summary));
+                TextFormatter formatter;
+                char* end = formatter.format(*summary, line.data());
+                REQUIRE(std::string(line.data() + 31, end)
+                        == "NET_ERROR 1 \"eth0\" (repeated 3 times)\n");
+            }
+
+            THEN("further repeats start a new window")
+            {
+                engine.publish(desc, 1, interface.c_str());
+                REQUIRE(recorder.diagnostics.size() == 5);
+                REQUIRE(recorder.diagnostics[4]->numRepeats() == 0);
+            }
+        }
+    }
+
+    GIVEN("no window")
+    {
+        engine.setCoalescingWindow(std::chrono::nanoseconds(0));
+        engine.publish(desc, 1, interface.c_str());
+        engine.publish(desc, 1, interface.c_str());
+        engine.flushRepeats();
+        REQUIRE(recorder.diagnostics.size() == 2);
+    }
+
+    GIVEN("non-droppable diagnostics")
+    {
+        engine.publish(non_droppable, desc, 1, interface.c_str());
+        engine.publish(non_droppable, desc, 1, interface.c_str());
+        REQUIRE(recorder.diagnostics.size() == 2);
+    }
+}
+
+SCENARIO("thresholds apply before sampling and rate limits", "[engine]")
+{
+    Descriptor<void(int)> info("NET_INFO", "", Severity::Info);
+    Descriptor<void(int)> error("NET_ERR", "", Severity::Error);
+
+    Engine engine;
+    Counter counter;
+    engine.subscribe("*", &counter);
+    engine.setThreshold("NET", Severity::Error);
+
+    GIVEN("a rate limit")
+    {
+        RateLimit limit;
+        limit.rate = 1;
+        limit.burst = 1;
+        limit.reportInterval = std::chrono::hours(1);
+        engine.setRateLimit("NET*", limit);
+
+        engine.publish(info, 0);
+        engine.publish(error, 1);
+
+        THEN("a filtered diagnostic takes no token")
+        {
+            REQUIRE(counter.count == 1);
+            REQUIRE(engine.numSuppressed() == 0);
+        }
+    }
+
+    GIVEN("a sampling rate")
+    {
+        Sampling sampling;
+        sampling.ratePerSecond = 1000;
+        engine.setSampling("NET*", sampling);
+
+        for (int count = 0; count < 5000; ++count)
+            engine.publish(info, int(count));
+        for (int count = 0; count < 1000; ++count)
+            engine.publish(error, int(count));
+
+        THEN("filtered diagnostics do not count towards the rate")
+        {
+            REQUIRE(counter.count == 1000);
+        }
+    }
+}
+
+SCENARIO("diagnostics are sampled", "[engine]")
+{
+    Descriptor<void(int)> info("NET_INFO", "");
+    Descriptor<void(int)> other("DISK_INFO", "");
+
+    Engine engine;
+    Recorder recorder(engine);
+    engine.subscribe("*", &recorder);
+
+    GIVEN("one in N diagnostics")
+    {
+        Sampling sampling;
+        sampling.oneIn = 10;
+        engine.setSampling("NET*", sampling);
+
+        for (int count = 0; count < 10000; ++count)
+            engine.publish(info, int(count));
+        engine.publish(other, 0);
+
+        THEN("about a tenth is published with its weight")
+        {
+            std::size_t numSampled = recorder.diagnostics.size() - 1;
+            REQUIRE(numSampled > 800);
+            REQUIRE(numSampled < 1200);
+            REQUIRE(recorder.diagnostics.front()->samplingWeight() == 10);
+            REQUIRE(recorder.diagnostics.back()->code() == other.m_code);
+            REQUIRE(recorder.diagnostics.back()->samplingWeight() == 1);
+        }
+
+        THEN("the weight is encoded")
+        {
+            Diagnostic* diagnostic = recorder.diagnostics.front();
+            std::int64_t reference = toNanoseconds(diagnostic->timeStamp());
+            std::vector<unsigned char> buffer(encodedSize(*diagnostic, reference));
+            REQUIRE(encode(*diagnostic, reference, buffer.data(), buffer.size())
+                    == buffer.size());
+
+            RecordReader reader(buffer.data(), buffer.size());
+            RecordView view;
+            REQUIRE(reader.next(view));
+            REQUIRE(view.samplingWeight() == 10);
+            REQUIRE(view.argument(0).toInteger().value()
+                    == diagnostic->arguments()[0].toInteger().value());
+        }
+
+        THEN("non-droppable diagnostics are not sampled")
+        {
+            std::size_t numBefore = recorder.diagnostics.size();
+            for (int count = 0; count < 10; ++count)
+                engine.publish(non_droppable, info, int(count));
+            REQUIRE(recorder.diagnostics.size() == numBefore + 10);
+        }
+
+        THEN("the sampling can be removed")
+        {
+            engine.clearSampling();
+            std::size_t numBefore = recorder.diagnostics.size();
+            engine.publish(info, 0);
+            REQUIRE(recorder.diagnostics.size() == numBefore + 1);
+            REQUIRE(recorder.diagnostics.back()->samplingWeight() == 1);
+        }
+    }
+
+    GIVEN("a sampling which is retuned")
+    {
+        Sampling sampling;
+        for (unsigned oneIn = 1000; oneIn > 0; --oneIn)
+        {
+            sampling.oneIn = oneIn;
+            engine.setSampling("NET*", sampling);
+            engine.clearSampling();
+            engine.setSampling("NET*", sampling);
+        }
+
+        THEN("the last parameters apply")
+        {
+            for (int count = 0; count < 100; ++count)
+                engine.publish(info, int(count));
+            REQUIRE(recorder.diagnostics.size() == 100);
+            REQUIRE(recorder.diagnostics.back()->samplingWeight() == 1);
+        }
+    }
+
+    GIVEN("a rate per second")
+    {
+        Sampling sampling;
+        sampling.ratePerSecond = 1000;
+        engine.setSampling("NET*", sampling);
+
+        // Without history, the first diagnostics of a second are published
+        // until the rate is exceeded.
+        for (int count = 0; count < 1000; ++count)
+            engine.publish(info, int(count));
+        REQUIRE(recorder.diagnostics.size() == 1000);
+
+        for (int count = 0; count < 9000; ++count)
+            engine.publish(info, int(count));
+        REQUIRE(recorder.diagnostics.size() < 4000);
+        REQUIRE(recorder.diagnostics.back()->samplingWeight() > 1);
+    }
+}
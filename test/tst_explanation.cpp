@@ -0,0 +1,127 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/descriptor.hpp"
+
+#include <string>
+
+using namespace dime;
+
+
+namespace
+{
+
+std::string text(const ExplanationSegment& segment)
+{
+    return std::string(segment.text, segment.length);
+}
+
+constexpr Descriptor<void(int, int, int)> rangeDesc("RANGE", "value {0} outside [{1}, {2}]");
+static_assert(rangeDesc.m_explanation.numSegments() == 7, "");
+static_assert(rangeDesc.m_explanation.segment(1).argument == 0, "");
+static_assert(rangeDesc.m_explanation.segment(6).length == 1, "");
+
+} // anonymous namespace
+
+
+SCENARIO("explanations are split into segments", "[explanation]")
+{
+    GIVEN("an explanation without placeholders")
+    {
+        Descriptor<void(int)> desc("PLAIN", "just text");
+        REQUIRE(desc.m_explanation.numSegments() == 1);
+        REQUIRE(text(desc.m_explanation.segment(0)) == "just text");
+        REQUIRE(desc.m_explanation.segment(0).argument == -1);
+    }
+
+    GIVEN("an empty explanation")
+    {
+        Descriptor<void(int)> desc("EMPTY", "");
+        REQUIRE(desc.m_explanation.numSegments() == 0);
+    }
+
+    GIVEN("an explanation with placeholders")
+    {
+        const Explanation& explanation = rangeDesc.m_explanation;
+        REQUIRE(text(explanation.segment(0)) == "value ");
+        REQUIRE(explanation.segment(1).argument == 0);
+        REQUIRE(text(explanation.segment(2)) == " outside [");
+        REQUIRE(explanation.segment(3).argument == 1);
+        REQUIRE(text(explanation.segment(4)) == ", ");
+        REQUIRE(explanation.segment(5).argument == 2);
+        REQUIRE(text(explanation.segment(6)) == "]");
+    }
+
+    GIVEN("typed placeholders, repeated arguments and escaped braces")
+    {
+        Descriptor<void(const char*, double, unsigned)> desc(
+                "TYPED", "{{{0:s}}} {1:f}/{1} {2:u}");
+        const Explanation& explanation = desc.m_explanation;
+        REQUIRE(explanation.numSegments() == 9);
+        REQUIRE(text(explanation.segment(0)) == "{");
+        REQUIRE(explanation.segment(1).argument == 0);
+        REQUIRE(text(explanation.segment(2)) == "}");
+        REQUIRE(text(explanation.segment(3)) == " ");
+        REQUIRE(explanation.segment(4).argument == 1);
+        REQUIRE(text(explanation.segment(5)) == "/");
+        REQUIRE(explanation.segment(6).argument == 1);
+        REQUIRE(text(explanation.segment(7)) == " ");
+        REQUIRE(explanation.segment(8).argument == 2);
+    }
+
+    GIVEN("arguments which are promoted to integers")
+    {
+        Descriptor<void(bool, unsigned char, short, unsigned short)> desc(
+                "FLAG", "flag {0:d} {1:d} {2:d} {3:d}");
+        REQUIRE(desc.m_explanation.numSegments() == 8);
+        static_assert(dime_detail::ArgumentKindOf<bool>::value
+                      == ArgumentKind::SignedInteger, "");
+        static_assert(dime_detail::ArgumentKindOf<unsigned char>::value
+                      == ArgumentKind::SignedInteger, "");
+        static_assert(dime_detail::ArgumentKindOf<unsigned>::value
+                      == ArgumentKind::UnsignedInteger, "");
+        REQUIRE_THROWS_AS(Descriptor<void(bool)>("FLAG", "{0:u}"), InvalidExplanationFormat);
+    }
+
+    GIVEN("invalid explanations")
+    {
+        using Desc = Descriptor<void(int, const char*)>;
+        REQUIRE_THROWS_AS(Desc("BAD", "{2}"), InvalidExplanationFormat);
+        REQUIRE_THROWS_AS(Desc("BAD", "{0:s}"), InvalidExplanationFormat);
+        REQUIRE_THROWS_AS(Desc("BAD", "{1:d}"), InvalidExplanationFormat);
+        REQUIRE_THROWS_AS(Desc("BAD", "{0:x}"), InvalidExplanationFormat);
+        REQUIRE_THROWS_AS(Desc("BAD", "{0"), InvalidExplanationFormat);
+        REQUIRE_THROWS_AS(Desc("BAD", "{}"), InvalidExplanationFormat);
+        REQUIRE_THROWS_AS(Desc("BAD", "a } b"), InvalidExplanationFormat);
+        REQUIRE_THROWS_AS(Desc("BAD", "{0}{0}{0}{0}{0}{0}{0}{0}{0}{0}{0}{0}{0}{0}{0}{0}{0}"),
+                          InvalidExplanationFormat);
+        REQUIRE_NOTHROW(Desc("GOOD", "{0:d} {1:s}"));
+    }
+}
@@ -0,0 +1,109 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/engine.hpp"
+#include "../src/filesink.hpp"
+#include "../src/segment.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+using namespace dime;
+
+
+SCENARIO("the file sink writes blocks of records", "[filesink]")
+{
+    const char* path = "tst_filesink.dime";
+    std::remove(path);
+
+    const int numThreads = 3;
+    const int numDiagnostics = 2000;
+    Descriptor<void(int, int)> desc("FILE", "");
+
+    {
+        FileSinkOptions options;
+        options.blockSize = 4096;
+        options.maxBlocks = 256;
+        FileSink sink(path, options);
+        Engine engine;
+        engine.subscribe("*", &sink);
+
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < numThreads; ++thread)
+        {
+            threads.emplace_back([&, thread] {
+                for (int count = 0; count < numDiagnostics; ++count)
+                    engine.publish(desc, int(thread), int(count));
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        sink.flush();
+        REQUIRE(sink.numDropped() == 0);
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    std::vector<int> expected(numThreads, 0);
+    SegmentReader segment(data.data(), data.size());
+    BlockHeader header;
+    const unsigned char* payload;
+    std::int64_t previous = 0;
+    while (segment.next(header, payload))
+    {
+        BlockRecordReader records(header, payload);
+        RecordView view;
+        std::int64_t timeStamp;
+        std::uint32_t numRecords = 0;
+        while (records.next(view, timeStamp))
+        {
+            int thread = view.argument(0).toInteger().value();
+            REQUIRE(view.argument(1).toInteger().value() == expected[thread]);
+            ++expected[thread];
+            ++numRecords;
+            if (numRecords > 1)
+                REQUIRE(timeStamp >= previous);
+            previous = timeStamp;
+        }
+        REQUIRE(records.status() == RecordReader::Status::Ok);
+        REQUIRE(numRecords == header.numRecords);
+    }
+    REQUIRE(segment.status() == SegmentReader::Status::Ok);
+    for (int thread = 0; thread < numThreads; ++thread)
+        REQUIRE(expected[thread] == numDiagnostics);
+
+    std::remove(path);
+}
@@ -0,0 +1,188 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/engine.hpp"
+#include "../src/flightrecorder.hpp"
+
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace dime;
+
+
+SCENARIO("the flight recorder keeps the newest records", "[flightrecorder]")
+{
+    const char* path = "tst_flightrecorder.dime";
+    std::remove(path);
+
+    Descriptor<void(int)> desc("FLIGHT", "");
+    const int numDiagnostics = 10000;
+
+    {
+        FlightRecorder recorder(path, 4096);
+        Engine engine;
+        engine.subscribe("*", &recorder);
+        for (int count = 0; count < numDiagnostics; ++count)
+            engine.publish(desc, int(count));
+    }
+
+    GIVEN("a reader")
+    {
+        FlightRecorderReader reader(path);
+        RecordView view;
+        std::int64_t timeStamp;
+        std::int64_t previousTimeStamp = 0;
+        int previous = -1;
+        int numRecords = 0;
+        while (reader.next(view, timeStamp))
+        {
+            int count = view.argument(0).toInteger().value();
+            if (previous >= 0)
+            {
+                REQUIRE(count == previous + 1);
+                REQUIRE(timeStamp >= previousTimeStamp);
+            }
+            previous = count;
+            previousTimeStamp = timeStamp;
+            ++numRecords;
+        }
+
+        THEN("the records up to the last one survive")
+        {
+            REQUIRE(previous == numDiagnostics - 1);
+            REQUIRE(numRecords > 100);
+            REQUIRE(numRecords < numDiagnostics);
+        }
+    }
+
+    WHEN("the recorder is opened again")
+    {
+        {
+            FlightRecorder recorder(path, 4096);
+            Engine engine;
+            engine.subscribe("*", &recorder);
+            engine.publish(desc, int(numDiagnostics));
+        }
+
+        THEN("it appends to the ring")
+        {
+            FlightRecorderReader reader(path);
+            RecordView view;
+            std::int64_t timeStamp;
+            int last = -1;
+            while (reader.next(view, timeStamp))
+                last = view.argument(0).toInteger().value();
+            REQUIRE(last == numDiagnostics);
+        }
+    }
+
+    std::remove(path);
+}
+
+SCENARIO("the flight recorder ignores reserved but unwritten space", "[flightrecorder]")
+{
+    const char* path = "tst_flightrecorder_reserved.dime";
+    std::remove(path);
+
+    Descriptor<void(int)> desc("FLIGHT", "");
+    const int numDiagnostics = 1000;
+    {
+        FlightRecorder recorder(path, 4096);
+        Engine engine;
+        engine.subscribe("*", &recorder);
+        for (int count = 0; count < numDiagnostics; ++count)
+            engine.publish(desc, int(count));
+    }
+
+    // Advance the cursor as a writer does before it dies. The reserved
+    // range still holds the valid records of the previous lap.
+    int fd = ::open(path, O_RDWR);
+    REQUIRE(fd >= 0);
+    std::uint64_t cursor;
+    off_t offset = off_t(offsetof(dime_detail::FlightRecorderHeader, cursor));
+    REQUIRE(::pread(fd, &cursor, sizeof(cursor), offset) == ssize_t(sizeof(cursor)));
+    cursor += 1024;
+    REQUIRE(::pwrite(fd, &cursor, sizeof(cursor), offset) == ssize_t(sizeof(cursor)));
+    ::close(fd);
+
+    FlightRecorderReader reader(path);
+    RecordView view;
+    std::int64_t timeStamp;
+    int previous = -1;
+    while (reader.next(view, timeStamp))
+    {
+        int count = view.argument(0).toInteger().value();
+        if (previous >= 0)
+            REQUIRE(count == previous + 1);
+        previous = count;
+    }
+    REQUIRE(previous == numDiagnostics - 1);
+    REQUIRE(reader.numSkippedBytes() >= 1024);
+
+    std::remove(path);
+}
+
+SCENARIO("the flight recorder survives a SIGKILL", "[flightrecorder]")
+{
+    const char* path = "tst_flightrecorder_kill.dime";
+    std::remove(path);
+
+    pid_t child = ::fork();
+    REQUIRE(child >= 0);
+    if (child == 0)
+    {
+        Descriptor<void(int)> desc("FLIGHT", "");
+        FlightRecorder recorder(path, 1 << 16);
+        Engine engine;
+        engine.subscribe("*", &recorder);
+        for (int count = 0; count < 100; ++count)
+            engine.publish(desc, int(count));
+        std::raise(SIGKILL);
+    }
+
+    int status;
+    REQUIRE(::waitpid(child, &status, 0) == child);
+    REQUIRE(WIFSIGNALED(status));
+
+    FlightRecorderReader reader(path);
+    RecordView view;
+    std::int64_t timeStamp;
+    int numRecords = 0;
+    while (reader.next(view, timeStamp))
+        REQUIRE(view.argument(0).toInteger().value() == numRecords++);
+    REQUIRE(numRecords == 100);
+
+    std::remove(path);
+}
@@ -0,0 +1,102 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/patternmatching.hpp"
+
+#include <random>
+#include <string>
+
+using namespace dime;
+
+
+SCENARIO("compiled patterns match like the reference matcher", "[patternmatching]")
+{
+    const char* patterns[] = {
+        "*", "N*", "NET*", "NET_TX*", "NET_TX----*", "NET_TX_QUEUE*",
+        "N?T*", "??????????X*", "NET*TX", "NET_TX", "NET_TX--------------",
+        "NET_TX_QUEUE_FULL---", "NET_TX_QUEUE_FULL----", "NE.T*", "NET?",
+        "0123456789*", "0123456789A*", "01234567890123456789", ""
+    };
+    const char* codes[] = {
+        "", "N", "NET", "NET_TX", "NET_RX", "NXT_TX", "NET_TX_QUEUE_FULL",
+        "0123456789", "0123456789A", "0123456789B", "01234567890123456789",
+        "ABCDEFGHIJX", "ABCDEFGHIJY"
+    };
+
+    for (const char* pattern : patterns)
+    {
+        auto matcher = dime_detail::compilePattern(pattern);
+        for (const char* text : codes)
+        {
+            Code code = makeCode(text);
+            INFO(pattern << " " << text);
+            REQUIRE(matcher->matches(code)
+                    == dime_detail::match(pattern, code.toString().c_str()));
+        }
+    }
+
+    GIVEN("random codes and patterns")
+    {
+        const char alphabet[] = "-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ_"
+                                "abcdefghijklmnopqrstuvwxyz";
+        std::mt19937 generator(1);
+        std::uniform_int_distribution<int> lengths(0, 20);
+        std::uniform_int_distribution<int> symbols(0, 3);
+        std::uniform_int_distribution<int> wildcards(0, 15);
+        int numMismatches = 0;
+        for (int count = 0; count < 10000; ++count)
+        {
+            // Use a small alphabet, so that patterns match from time to time.
+            char text[21] = {0};
+            int length = lengths(generator);
+            for (int idx = 0; idx < length; ++idx)
+                text[idx] = alphabet[symbols(generator)];
+
+            std::string pattern;
+            length = lengths(generator);
+            for (int idx = 0; idx < length; ++idx)
+            {
+                int wildcard = wildcards(generator);
+                pattern += wildcard == 0 ? '*'
+                                         : wildcard == 1 ? '?' : alphabet[symbols(generator)];
+            }
+            if (wildcards(generator) < 12)
+                pattern += '*';
+
+            Code code = makeCode(text);
+            if (dime_detail::compilePattern(pattern.c_str())->matches(code)
+                != dime_detail::match(pattern.c_str(), code.toString().c_str()))
+            {
+                ++numMismatches;
+            }
+        }
+        REQUIRE(numMismatches == 0);
+    }
+}
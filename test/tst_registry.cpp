@@ -0,0 +1,130 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/registry.hpp"
+
+#include <memory>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+using namespace dime;
+
+
+namespace
+{
+
+constexpr Descriptor<void(int, double)> overheat("OVERHEAT", "{0}: {1} degrees");
+constexpr Descriptor<void()> shutdown("SHUTDOWN", "shutting down", Severity::Critical);
+constexpr Descriptor<void(const char*)> restart("RESTART", "restarting {0}");
+
+constexpr auto registry = makeDescriptorRegistry(overheat, shutdown, restart);
+
+static_assert(registry.find(makeCode("OVERHEAT")) != nullptr, "");
+static_assert(registry.find(makeCode("OVERHEAT"))->numArguments == 2, "");
+static_assert(registry.find(makeCode("OVERHEAT"))->kinds[1] == ArgumentKind::Double, "");
+static_assert(registry.find(makeCode("SHUTDOWN"))->numArguments == 0, "");
+static_assert(registry.find(makeCode("SHUTDOWN"))->severity == Severity::Critical, "");
+static_assert(registry.find(makeCode("RESTART"))->explanation == &restart.m_explanation, "");
+static_assert(registry.find(makeCode("UNKNOWN")) == nullptr, "");
+
+constexpr auto emptyRegistry = makeDescriptorRegistry();
+static_assert(emptyRegistry.find(makeCode("OVERHEAT")) == nullptr, "");
+
+} // anonymous namespace
+
+
+SCENARIO("descriptors are found in a registry", "[registry]")
+{
+    GIVEN("a registry which has been built at compile-time")
+    {
+        DescriptorRegistryView view = registry.view();
+        const DescriptorInfo* info = view.find(overheat.m_code);
+        REQUIRE(info != nullptr);
+        REQUIRE(info->kinds[0] == ArgumentKind::SignedInteger);
+        REQUIRE(info->explanation->numSegments() == 4);
+        REQUIRE(info->severity == Severity::Info);
+        REQUIRE(view.find(shutdown.m_code)->severity == Severity::Critical);
+        REQUIRE(view.find(makeCode("OVERHEATED")) == nullptr);
+    }
+
+    GIVEN("many random codes")
+    {
+        const char alphabet[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ_"
+                                "abcdefghijklmnopqrstuvwxyz";
+        std::mt19937 generator(7);
+        std::uniform_int_distribution<int> lengths(1, 20);
+        std::uniform_int_distribution<int> symbols(0, 62);
+        auto randomCode = [&] {
+            char text[21] = {0};
+            int length = lengths(generator);
+            for (int idx = 0; idx < length; ++idx)
+                text[idx] = alphabet[symbols(generator)];
+            return makeCode(text);
+        };
+
+        constexpr std::size_t numCodes = 1000;
+        std::set<std::pair<std::uint64_t, std::uint64_t>> unique;
+        std::vector<DescriptorInfo> infos;
+        while (infos.size() < numCodes)
+        {
+            Code code = randomCode();
+            if (unique.insert(std::make_pair(code[0], code[1])).second)
+                infos.push_back(DescriptorInfo{code, 0, nullptr, &shutdown.m_explanation});
+        }
+
+        std::unique_ptr<DescriptorRegistry<numCodes>> many(
+                new DescriptorRegistry<numCodes>(infos.data()));
+
+        int numMisses = 0;
+        for (const DescriptorInfo& info : infos)
+            numMisses += many->find(info.code) == nullptr
+                         || many->find(info.code)->code[0] != info.code[0];
+        REQUIRE(numMisses == 0);
+
+        int numFalseHits = 0;
+        for (int count = 0; count < 10000; ++count)
+        {
+            Code code = randomCode();
+            if (unique.count(std::make_pair(code[0], code[1])) == 0)
+                numFalseHits += many->find(code) != nullptr;
+        }
+        REQUIRE(numFalseHits == 0);
+    }
+
+    GIVEN("duplicate codes")
+    {
+        Descriptor<void(int)> first("TWICE", "");
+        Descriptor<void(double)> second("TWICE", "");
+        REQUIRE_THROWS_AS(makeDescriptorRegistry(overheat, first, second),
+                          DuplicateDescriptorCode);
+    }
+}
@@ -0,0 +1,125 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/diagnostic.hpp"
+#include "../src/engine.hpp"
+#include "../src/ringallocator.hpp"
+
+#include <new>
+
+using namespace dime;
+
+
+SCENARIO("the ring allocator places blocks consecutively", "[ringallocator]")
+{
+    RingAllocator ring(4 * DIME_CACHE_LINE_SIZE);
+    REQUIRE(ring.capacity() == 4 * DIME_CACHE_LINE_SIZE);
+
+    char* b1 = static_cast<char*>(ring.allocate(DIME_CACHE_LINE_SIZE));
+    char* b2 = static_cast<char*>(ring.allocate(2 * DIME_CACHE_LINE_SIZE));
+    char* b3 = static_cast<char*>(ring.allocate(1));
+    REQUIRE(static_cast<void*>(b2) == static_cast<void*>(b1 + DIME_CACHE_LINE_SIZE));
+    REQUIRE(static_cast<void*>(b3) == static_cast<void*>(b2 + 2 * DIME_CACHE_LINE_SIZE));
+    REQUIRE(ring.used() == 4 * DIME_CACHE_LINE_SIZE);
+    REQUIRE_THROWS_AS(ring.allocate(1), const std::bad_alloc&);
+
+    WHEN("a block is released out of order")
+    {
+        ring.deallocate(b2);
+
+        THEN("its space is not reclaimed before the older blocks")
+        {
+            REQUIRE(ring.used() == 4 * DIME_CACHE_LINE_SIZE);
+            REQUIRE_THROWS_AS(ring.allocate(1), const std::bad_alloc&);
+
+            ring.deallocate(b1);
+            REQUIRE(ring.used() == DIME_CACHE_LINE_SIZE);
+        }
+    }
+
+    WHEN("the oldest block is released")
+    {
+        ring.deallocate(b1);
+
+        THEN("a block wraps around to the start")
+        {
+            REQUIRE(ring.allocate(1) == static_cast<void*>(b1));
+        }
+
+        THEN("the ring fills up to the oldest block")
+        {
+            ring.deallocate(b2);
+            REQUIRE(ring.used() == DIME_CACHE_LINE_SIZE);
+            char* b4 = static_cast<char*>(ring.allocate(2 * DIME_CACHE_LINE_SIZE));
+            char* b5 = static_cast<char*>(ring.allocate(1));
+            REQUIRE(static_cast<void*>(b4) == static_cast<void*>(b1));
+            REQUIRE(static_cast<void*>(b5) == static_cast<void*>(b1 + 2 * DIME_CACHE_LINE_SIZE));
+            REQUIRE_THROWS_AS(ring.allocate(1), const std::bad_alloc&);
+
+            ring.deallocate(b3);
+            ring.deallocate(b5);
+            ring.deallocate(b4);
+            REQUIRE(ring.used() == 0);
+        }
+    }
+}
+
+SCENARIO("a block does not wrap around the end of the ring", "[ringallocator]")
+{
+    RingAllocator ring(4 * DIME_CACHE_LINE_SIZE);
+
+    char* b1 = static_cast<char*>(ring.allocate(DIME_CACHE_LINE_SIZE));
+    char* b2 = static_cast<char*>(ring.allocate(2 * DIME_CACHE_LINE_SIZE));
+    ring.deallocate(b1);
+
+    // The last line would have to be padded, which leaves no room.
+    REQUIRE_THROWS_AS(ring.allocate(2 * DIME_CACHE_LINE_SIZE), const std::bad_alloc&);
+    char* b3 = static_cast<char*>(ring.allocate(DIME_CACHE_LINE_SIZE));
+    REQUIRE(static_cast<void*>(b3) == static_cast<void*>(b2 + 2 * DIME_CACHE_LINE_SIZE));
+
+    ring.deallocate(b2);
+    char* b4 = static_cast<char*>(ring.allocate(2 * DIME_CACHE_LINE_SIZE));
+    REQUIRE(static_cast<void*>(b4) == static_cast<void*>(b1));
+
+    ring.deallocate(b3);
+    ring.deallocate(b4);
+    REQUIRE(ring.used() == 0);
+}
+
+SCENARIO("an engine allocates from a ring", "[ringallocator]")
+{
+    Descriptor<void(int)> desc("RING", "");
+    RingAllocator ring(2 * DIME_CACHE_LINE_SIZE);
+    Engine engine(ring);
+
+    for (int count = 0; count < 10; ++count)
+        engine.publish(desc, int(count));
+    REQUIRE(ring.used() == 0);
+}
@@ -0,0 +1,156 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/diagnostic.hpp"
+#include "../src/segment.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace dime;
+
+namespace
+{
+
+//! Fills a block with diagnostics of two shapes.
+std::size_t fillBlock(std::vector<unsigned char>& buffer, unsigned numDiagnostics)
+{
+    Allocator a;
+    Descriptor<void(int, unsigned, double, const char*)> sensor("SENSOR", "");
+    Descriptor<void(float, long double)> control("CTRL", "");
+    const char* names[] = {"left", "right"};
+
+    BlockWriter writer(buffer.data(), buffer.size());
+    for (unsigned count = 0; count < numDiagnostics; ++count)
+    {
+        Diagnostic* diag;
+        if (count % 4 == 3)
+            diag = Diagnostic::create(a, control, 0.25f * float(count % 8), 1.0L);
+        else
+            diag = Diagnostic::create(a, sensor, int(count) - 100, 7u, 20.0 + count % 3,
+                                      static_cast<const char*>(names[(count / 16) % 2]));
+        REQUIRE(writer.append(*diag));
+        a.deallocate(diag);
+    }
+    return writer.finish();
+}
+
+//! Reads all records of a block into a printable form.
+std::vector<std::string> readBlock(const unsigned char* block)
+{
+    BlockHeader header;
+    REQUIRE(header.read(block));
+    BlockRecordReader reader(header, block + blockHeaderSize);
+    RecordView view;
+    std::int64_t timeStamp;
+    std::vector<std::string> records;
+    while (reader.next(view, timeStamp))
+    {
+        std::string record = view.code().toString() + " " + std::to_string(timeStamp)
+                             + " " + std::to_string(view.uniqueId())
+                             + (view.droppable() ? " D" : " N");
+        for (unsigned idx = 0; idx < view.numArguments(); ++idx)
+        {
+            ArgumentView argument = view.argument(idx);
+            record += " " + std::to_string(int(argument.kind())) + ":";
+            if (argument.kind() == ArgumentKind::String)
+                record.append(argument.stringData(), argument.stringSize());
+            else
+                record.append(reinterpret_cast<const char*>(argument.data()), argument.size());
+        }
+        records.push_back(record);
+    }
+    REQUIRE(reader.status() == RecordReader::Status::Ok);
+    REQUIRE(records.size() == header.numRecords);
+    return records;
+}
+
+} // anonymous namespace
+
+
+SCENARIO("blocks are compressed", "[segment]")
+{
+    std::vector<unsigned char> block(64 * 1024);
+    std::size_t size = fillBlock(block, 500);
+    std::vector<unsigned char> compressed(size);
+    std::size_t compressedSize = compressBlock(block.data(), size,
+                                               compressed.data(), compressed.size());
+
+    THEN("the compressed block is much smaller")
+    {
+        REQUIRE(compressedSize != 0);
+        REQUIRE(compressedSize * 4 < size);
+
+        BlockHeader header;
+        REQUIRE(header.read(compressed.data()));
+        REQUIRE((header.flags & BlockCompressed) != 0);
+        REQUIRE(header.numRecords == 500);
+    }
+
+    THEN("both blocks hold the same records")
+    {
+        REQUIRE(readBlock(compressed.data()) == readBlock(block.data()));
+    }
+
+    THEN("a segment reader returns the compressed block")
+    {
+        SegmentReader segment(compressed.data(), compressedSize);
+        BlockHeader header;
+        const unsigned char* payload;
+        REQUIRE(segment.next(header, payload));
+        REQUIRE(!segment.next(header, payload));
+        REQUIRE(segment.status() == SegmentReader::Status::Ok);
+    }
+
+    WHEN("the destination is too small")
+    {
+        THEN("the block is not compressed")
+        {
+            REQUIRE(compressBlock(block.data(), size, compressed.data(), compressedSize - 1) == 0);
+        }
+    }
+
+    WHEN("the compressed payload is corrupted")
+    {
+        compressed[compressedSize / 2] ^= 0x10;
+        BlockHeader header;
+        REQUIRE(header.read(compressed.data()));
+        BlockRecordReader reader(header, compressed.data() + blockHeaderSize);
+        RecordView view;
+        std::int64_t timeStamp;
+
+        THEN("the reader reports the corruption")
+        {
+            REQUIRE(!reader.next(view, timeStamp));
+            REQUIRE(reader.status() == RecordReader::Status::Corrupt);
+        }
+    }
+}
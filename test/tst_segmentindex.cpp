@@ -0,0 +1,319 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/engine.hpp"
+#include "../src/filesink.hpp"
+#include "../src/segmentindex.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using namespace dime;
+
+namespace
+{
+
+std::vector<char> readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<char>((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+}
+
+} // anonymous namespace
+
+
+SCENARIO("a code filter holds the prefixes of codes", "[segmentindex]")
+{
+    GIVEN("a filter with a code")
+    {
+        CodeFilter filter;
+        filter.insert(makeCode("NETRX"));
+
+        THEN("all prefixes of the code may be contained")
+        {
+            for (unsigned length = 0; length <= 5; ++length)
+                REQUIRE(filter.mayContain(codePrefix(makeCode("NETRX"), length), length));
+        }
+
+        THEN("a literal prefix of a pattern may be contained")
+        {
+            Code prefix;
+            REQUIRE(literalPrefix("NET*", prefix) == 3);
+            REQUIRE(filter.mayContain(prefix, 3));
+            REQUIRE(literalPrefix("NETR?", prefix) == 4);
+            REQUIRE(filter.mayContain(prefix, 4));
+        }
+
+        WHEN("it is merged into an empty filter")
+        {
+            CodeFilter other;
+            other.merge(filter);
+            THEN("the code may be contained in the other filter")
+            {
+                REQUIRE(other.mayContain(makeCode("NETRX"), 5));
+            }
+        }
+
+        WHEN("the filter is cleared")
+        {
+            filter.clear();
+            THEN("no prefix is contained")
+            {
+                REQUIRE(!filter.mayContain(makeCode("N"), 1));
+                REQUIRE(!filter.mayContain(makeCode("NETRX"), 5));
+            }
+        }
+    }
+
+    GIVEN("a filter with a few codes")
+    {
+        CodeFilter filter;
+        filter.insert(makeCode("NETRX"));
+        filter.insert(makeCode("DISKFULL"));
+
+        THEN("most other prefixes are rejected")
+        {
+            const char* others[] = {"A", "B", "C", "E", "F", "G", "H", "I", "J",
+                                    "K", "L", "M", "O", "P", "Q", "R", "S", "T"};
+            unsigned numFalsePositives = 0;
+            for (const char* other : others)
+                numFalsePositives += filter.mayContain(makeCode(other), 1);
+            REQUIRE(numFalsePositives <= 2);
+        }
+    }
+
+    GIVEN("a filter with a code containing a dash")
+    {
+        CodeFilter filter;
+        filter.insert(makeCode("NET-TX"));
+
+        THEN("all prefixes of the code may be contained")
+        {
+            for (unsigned length = 0; length <= 6; ++length)
+                REQUIRE(filter.mayContain(codePrefix(makeCode("NET-TX"), length), length));
+
+            Code prefix;
+            REQUIRE(literalPrefix("NET-*", prefix) == 4);
+            REQUIRE(filter.mayContain(prefix, 4));
+            REQUIRE(literalPrefix("NET-T*", prefix) == 5);
+            REQUIRE(filter.mayContain(prefix, 5));
+        }
+    }
+
+    GIVEN("a filter with many codes")
+    {
+        CodeFilter filter;
+        char name[16];
+        for (unsigned idx = 0; idx < 32; ++idx)
+        {
+            std::snprintf(name, sizeof(name), "DEV%02u_FAULT", idx);
+            filter.insert(makeCode(name));
+        }
+
+        THEN("the inserted codes may be contained")
+        {
+            for (unsigned idx = 0; idx < 32; ++idx)
+            {
+                std::snprintf(name, sizeof(name), "DEV%02u_FAULT", idx);
+                REQUIRE(filter.mayContain(makeCode(name), 11));
+            }
+        }
+
+        THEN("most other codes are rejected")
+        {
+            unsigned numFalsePositives = 0;
+            for (unsigned idx = 32; idx < 96; ++idx)
+            {
+                std::snprintf(name, sizeof(name), "DEV%02u_FAULT", idx);
+                numFalsePositives += filter.mayContain(makeCode(name), 11);
+            }
+            REQUIRE(numFalsePositives <= 8);
+        }
+    }
+
+    GIVEN("patterns without a usable prefix")
+    {
+        Code prefix;
+        THEN("the prefix is empty")
+        {
+            REQUIRE(literalPrefix("*", prefix) == 0);
+            REQUIRE(literalPrefix("?ABC", prefix) == 0);
+            REQUIRE(literalPrefix("A+B*", prefix) == 0);
+        }
+    }
+
+    GIVEN("a code")
+    {
+        Code code = makeCode("ABCDEFGHIJKLM");
+        THEN("its length and prefixes are computed")
+        {
+            REQUIRE(codeLength(code) == 13);
+            REQUIRE(codeLength(makeCode("")) == 0);
+            REQUIRE(codeLength(makeCode("NET-TX")) == 6);
+            REQUIRE(codeLength(makeCode("-A")) == 2);
+            Code prefix = codePrefix(code, 11);
+            REQUIRE(prefix[0] == makeCode("ABCDEFGHIJK")[0]);
+            REQUIRE(prefix[1] == makeCode("ABCDEFGHIJK")[1]);
+        }
+    }
+}
+
+SCENARIO("index entries are encoded and decoded", "[segmentindex]")
+{
+    IndexEntry entry;
+    entry.offset = 123456789;
+    entry.size = 4096;
+    entry.numRecords = 17;
+    entry.minTimeStamp = -5;
+    entry.maxTimeStamp = 1000;
+    entry.codes.insert(makeCode("IDX"));
+
+    std::vector<unsigned char> data(indexHeaderSize + 2 * IndexEntry::encodedSize);
+    writeIndexHeader(data.data());
+    entry.write(data.data() + indexHeaderSize);
+    entry.offset += entry.size;
+    entry.write(data.data() + indexHeaderSize + IndexEntry::encodedSize);
+
+    GIVEN("a valid index")
+    {
+        IndexReader reader(data.data(), data.size());
+        IndexEntry decoded;
+
+        THEN("all entries are read")
+        {
+            REQUIRE(reader.next(decoded));
+            REQUIRE(decoded.offset == 123456789);
+            REQUIRE(decoded.size == 4096);
+            REQUIRE(decoded.numRecords == 17);
+            REQUIRE(decoded.minTimeStamp == -5);
+            REQUIRE(decoded.maxTimeStamp == 1000);
+            REQUIRE(decoded.mayMatch(0, 1, makeCode("I"), 1));
+            REQUIRE(!decoded.mayMatch(1001, 2000, makeCode("I"), 1));
+            REQUIRE(!decoded.mayMatch(-100, -5, makeCode("I"), 1));
+            REQUIRE(reader.next(decoded));
+            REQUIRE(decoded.offset == 123456789 + 4096);
+            REQUIRE(!reader.next(decoded));
+            REQUIRE(reader.status() == IndexReader::Status::Ok);
+        }
+    }
+
+    GIVEN("an index whose last entry has been torn")
+    {
+        IndexReader reader(data.data(), data.size() - 10);
+        IndexEntry decoded;
+
+        THEN("the reader stops after the complete entry")
+        {
+            REQUIRE(reader.next(decoded));
+            REQUIRE(!reader.next(decoded));
+            REQUIRE(reader.status() == IndexReader::Status::Truncated);
+        }
+    }
+
+    GIVEN("an index with a corrupted entry")
+    {
+        data[indexHeaderSize + 3] ^= 0x40;
+        IndexReader reader(data.data(), data.size());
+        IndexEntry decoded;
+
+        THEN("the reader stops")
+        {
+            REQUIRE(!reader.next(decoded));
+            REQUIRE(reader.status() == IndexReader::Status::Corrupt);
+        }
+    }
+}
+
+SCENARIO("the file sink writes an index", "[segmentindex][filesink]")
+{
+    const char* path = "tst_segmentindex.dime";
+    std::remove(path);
+    std::remove(indexPath(path).c_str());
+
+    Descriptor<void(int)> net("NETRX", "");
+    Descriptor<void(int)> disk("DISKFULL", "");
+    const int numDiagnostics = 1000;
+
+    {
+        FileSinkOptions options;
+        options.blockSize = 1024;
+        options.maxBlocks = 256;
+        options.writeIndex = true;
+        FileSink sink(path, options);
+        Engine engine;
+        engine.subscribe("*", &sink);
+
+        for (int count = 0; count < numDiagnostics; ++count)
+        {
+            if (count < numDiagnostics / 2)
+                engine.publish(net, int(count));
+            else
+                engine.publish(disk, int(count));
+        }
+        sink.flush();
+        REQUIRE(sink.numDropped() == 0);
+    }
+
+    std::vector<char> segment = readFile(path);
+    std::vector<char> index = readFile(indexPath(path));
+
+    IndexReader reader(index.data(), index.size());
+    IndexEntry entry;
+    std::uint64_t offset = 0;
+    std::uint32_t numRecords = 0;
+    bool sawNet = false;
+    bool sawDisk = false;
+    while (reader.next(entry))
+    {
+        // The entries cover the segment without gaps.
+        REQUIRE(entry.offset == offset);
+        BlockHeader header;
+        REQUIRE(header.read(reinterpret_cast<const unsigned char*>(segment.data()) + offset));
+        REQUIRE(entry.size == blockHeaderSize + header.payloadSize);
+        REQUIRE(entry.numRecords == header.numRecords);
+        REQUIRE(entry.minTimeStamp <= entry.maxTimeStamp);
+
+        sawNet = sawNet || entry.codes.mayContain(makeCode("NET"), 3);
+        sawDisk = sawDisk || entry.codes.mayContain(makeCode("DISK"), 4);
+        offset += entry.size;
+        numRecords += entry.numRecords;
+    }
+    REQUIRE(reader.status() == IndexReader::Status::Ok);
+    REQUIRE(offset == segment.size());
+    REQUIRE(numRecords == numDiagnostics);
+    REQUIRE(sawNet);
+    REQUIRE(sawDisk);
+
+    std::remove(path);
+    std::remove(indexPath(path).c_str());
+}
@@ -0,0 +1,149 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/engine.hpp"
+#include "../src/shmtransport.hpp"
+
+#include <csignal>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace dime;
+
+
+SCENARIO("diagnostics are collected from shared memory", "[shmtransport]")
+{
+    // A prefix per test process keeps parallel test runs apart.
+    std::string prefix = "dimetest" + std::to_string(::getpid());
+    const int numThreads = 3;
+    const int numDiagnostics = 20000;
+    Descriptor<void(int, int)> desc("SHM", "");
+    ShmCollector collector(prefix.c_str());
+
+    GIVEN("a sink with a small ring")
+    {
+        ShmSinkOptions options;
+        options.prefix = prefix.c_str();
+        options.capacity = 4096;
+        std::vector<int> expected(numThreads, 0);
+        std::uint64_t numCollected = 0;
+        std::uint64_t numReordered = 0;
+        std::uint64_t numDropped;
+
+        {
+            ShmSink sink(options);
+            REQUIRE(collector.scan() == 1);
+            REQUIRE(collector.numRings() == 1);
+
+            Engine engine;
+            engine.subscribe("*", &sink);
+            DIME_STD::atomic<bool> done(false);
+            std::thread collectorThread([&] {
+                auto handler = [&](const RecordView& view, std::int64_t,
+                                   const ShmRingReader&) {
+                    // Diagnostics may be dropped but never reordered.
+                    int thread = view.argument(0).toInteger().value();
+                    int count = view.argument(1).toInteger().value();
+                    numReordered += count < expected[thread];
+                    expected[thread] = count + 1;
+                    ++numCollected;
+                };
+                while (!done)
+                    collector.drain(handler);
+                collector.drain(handler);
+            });
+
+            std::vector<std::thread> threads;
+            for (int thread = 0; thread < numThreads; ++thread)
+            {
+                threads.emplace_back([&, thread] {
+                    for (int count = 0; count < numDiagnostics; ++count)
+                        engine.publish(desc, int(thread), int(count));
+                });
+            }
+            for (auto& thread : threads)
+                thread.join();
+            done = true;
+            collectorThread.join();
+            numDropped = sink.numDropped();
+        }
+
+        THEN("every diagnostic has been collected or counted as dropped")
+        {
+            REQUIRE(numReordered == 0);
+            REQUIRE(numCollected > 0);
+            REQUIRE(numCollected + numDropped == std::uint64_t(numThreads) * numDiagnostics);
+        }
+
+        collector.drain([](const RecordView&, std::int64_t, const ShmRingReader&) {});
+        THEN("the ring is removed after the sink has been destroyed")
+        {
+            REQUIRE(collector.numRings() == 0);
+            REQUIRE(collector.scan() == 0);
+        }
+    }
+
+    GIVEN("a producer in another process")
+    {
+        pid_t child = ::fork();
+        REQUIRE(child >= 0);
+        if (child == 0)
+        {
+            ShmSinkOptions options;
+            options.prefix = prefix.c_str();
+            ShmSink sink(options);
+            Engine engine;
+            engine.subscribe("*", &sink);
+            for (int count = 0; count < 100; ++count)
+                engine.publish(desc, 0, int(count));
+            std::raise(SIGKILL);
+        }
+
+        int status;
+        REQUIRE(::waitpid(child, &status, 0) == child);
+        REQUIRE(collector.scan() == 1);
+
+        int numRecords = 0;
+        collector.drain([&](const RecordView& view, std::int64_t, const ShmRingReader& reader) {
+            REQUIRE(reader.pid() == child);
+            REQUIRE(view.argument(1).toInteger().value() == numRecords++);
+        });
+
+        THEN("all records are collected and the ring of the dead process is removed")
+        {
+            REQUIRE(numRecords == 100);
+            REQUIRE(collector.numRings() == 0);
+        }
+    }
+}
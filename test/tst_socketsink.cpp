@@ -0,0 +1,157 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/engine.hpp"
+#include "../src/socketsink.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace dime;
+
+
+SCENARIO("diagnostics are streamed over a Unix domain socket", "[socketsink]")
+{
+    const char* path = "tst_socketsink.sock";
+    SocketCollector collector(path);
+    Descriptor<void(int, int)> desc("SOCK", "");
+
+    GIVEN("a sink and a collector which keeps up")
+    {
+        const int numThreads = 3;
+        const int numDiagnostics = 20000;
+        std::vector<int> expected(numThreads, 0);
+        std::uint64_t numCollected = 0;
+        std::uint64_t numReordered = 0;
+        std::uint64_t numDropped;
+
+        DIME_STD::atomic<bool> done(false);
+        std::thread collectorThread([&] {
+            auto handler = [&](const RecordView& view, std::int64_t) {
+                int thread = view.argument(0).toInteger().value();
+                int count = view.argument(1).toInteger().value();
+                numReordered += count < expected[thread];
+                expected[thread] = count + 1;
+                ++numCollected;
+            };
+            while (!done)
+                collector.poll(std::chrono::milliseconds(1), handler);
+            while (collector.poll(std::chrono::milliseconds(50), handler) != 0)
+            {
+            }
+        });
+
+        {
+            SocketSink sink(path);
+            Engine engine;
+            engine.subscribe("*", &sink);
+
+            std::vector<std::thread> threads;
+            for (int thread = 0; thread < numThreads; ++thread)
+            {
+                threads.emplace_back([&, thread] {
+                    for (int count = 0; count < numDiagnostics; ++count)
+                        engine.publish(desc, int(thread), int(count));
+                });
+            }
+            for (auto& thread : threads)
+                thread.join();
+            sink.flush();
+            numDropped = sink.numDropped();
+        }
+        done = true;
+        collectorThread.join();
+
+        THEN("every diagnostic has been collected or counted as dropped")
+        {
+            REQUIRE(numReordered == 0);
+            REQUIRE(numCollected > 0);
+            REQUIRE(numCollected + numDropped == std::uint64_t(numThreads) * numDiagnostics);
+            REQUIRE(collector.numConnections() == 0);
+        }
+    }
+
+    GIVEN("a collector which does not read")
+    {
+        const int numDiagnostics = 100000;
+        SocketSinkOptions options;
+        options.chunkSize = 4096;
+        options.maxChunks = 2;
+        SocketSink sink(path, options);
+        collector.poll(std::chrono::milliseconds(10),
+                       [](const RecordView&, std::int64_t) {});
+        REQUIRE(collector.numConnections() == 1);
+
+        Allocator a;
+        DIME_STD::atomic<bool> producerDone(false);
+        std::thread producer([&] {
+            for (int count = 0; count < numDiagnostics; ++count)
+            {
+                Diagnostic* diag = Diagnostic::create(non_droppable, a, desc, 0, int(count));
+                sink.process(diag);
+                a.deallocate(diag);
+            }
+            producerDone = true;
+        });
+
+        // Wait until the socket and the staging buffers are full.
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        bool blocked = !producerDone;
+
+        Diagnostic* droppable = Diagnostic::create(a, desc, 1, 0);
+        sink.process(droppable);
+        a.deallocate(droppable);
+        std::uint64_t numDropped = sink.numDropped();
+
+        int numCollected = 0;
+        int numReordered = 0;
+        auto handler = [&](const RecordView& view, std::int64_t) {
+            if (view.argument(0).toInteger().value() == 0)
+                numReordered += view.argument(1).toInteger().value() != numCollected++;
+        };
+        while (!producerDone)
+            collector.poll(std::chrono::milliseconds(1), handler);
+        producer.join();
+        sink.flush();
+        while (collector.poll(std::chrono::milliseconds(50), handler) != 0)
+        {
+        }
+
+        THEN("non-droppable diagnostics wait and droppable ones are dropped")
+        {
+            REQUIRE(blocked);
+            REQUIRE(numDropped == 1);
+            REQUIRE(numCollected == numDiagnostics);
+            REQUIRE(numReordered == 0);
+        }
+    }
+}
@@ -0,0 +1,313 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/engine.hpp"
+#include "../src/registry.hpp"
+#include "../src/textformat.hpp"
+#include "../src/wireformat.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dime;
+using namespace dime::dime_detail;
+
+namespace
+{
+
+std::string formatted(double value, int precision)
+{
+    char buffer[maxFloatSize];
+    return std::string(buffer, formatFloat(buffer, value, precision));
+}
+
+std::string formatted(std::int64_t value)
+{
+    char buffer[20];
+    return std::string(buffer, formatInteger(buffer, value));
+}
+
+} // anonymous namespace
+
+
+SCENARIO("integers are formatted", "[textformat]")
+{
+    REQUIRE(formatted(0) == "0");
+    REQUIRE(formatted(7) == "7");
+    REQUIRE(formatted(42) == "42");
+    REQUIRE(formatted(-100) == "-100");
+    REQUIRE(formatted(1234567) == "1234567");
+    REQUIRE(formatted(std::numeric_limits<std::int64_t>::max()) == "9223372036854775807");
+    REQUIRE(formatted(std::numeric_limits<std::int64_t>::min()) == "-9223372036854775808");
+
+    char buffer[20];
+    REQUIRE(std::string(buffer, formatUnsigned(buffer, 18446744073709551615ull))
+            == "18446744073709551615");
+}
+
+SCENARIO("floating-point values are formatted", "[textformat]")
+{
+    GIVEN("special values")
+    {
+        REQUIRE(formatted(0.0, 15) == "0");
+        REQUIRE(formatted(-0.0, 15) == "-0");
+        REQUIRE(formatted(std::numeric_limits<double>::infinity(), 15) == "inf");
+        REQUIRE(formatted(-std::numeric_limits<double>::infinity(), 15) == "-inf");
+        REQUIRE(formatted(std::numeric_limits<double>::quiet_NaN(), 15) == "nan");
+    }
+
+    GIVEN("values in the fixed notation")
+    {
+        REQUIRE(formatted(1.0, 15) == "1");
+        REQUIRE(formatted(0.5, 15) == "0.5");
+        REQUIRE(formatted(-2.25, 15) == "-2.25");
+        REQUIRE(formatted(1000.0, 15) == "1000");
+        REQUIRE(formatted(0.1 + 0.2, 15) == "0.3");
+        REQUIRE(formatted(double(21.6f), 7) == "21.6");
+        REQUIRE(formatted(0.0001234, 15) == "0.0001234");
+        REQUIRE(formatted(9.9999999, 3) == "10");
+    }
+
+    GIVEN("values in the scientific notation")
+    {
+        REQUIRE(formatted(1e15, 15) == "1e+15");
+        REQUIRE(formatted(1.5e-7, 15) == "1.5e-07");
+        REQUIRE(formatted(-6.02214076e23, 15) == "-6.02214076e+23");
+        REQUIRE(formatted(std::numeric_limits<double>::max(), 15) == "1.79769313486232e+308");
+        REQUIRE(formatted(std::numeric_limits<double>::denorm_min(), 15) == "4.94065645841247e-324");
+    }
+
+    GIVEN("random values")
+    {
+        // Values which are very close to a tie may differ from printf() in
+        // the last digit.
+        std::mt19937_64 generator(1234);
+        std::uniform_real_distribution<double> mantissas(-10.0, 10.0);
+        std::uniform_int_distribution<int> exponents(-1000, 1000);
+        int numMismatches = 0;
+        int numOffByMore = 0;
+        for (int count = 0; count < 100000; ++count)
+        {
+            double value = std::ldexp(mantissas(generator), exponents(generator));
+            char expected[64];
+            std::snprintf(expected, sizeof(expected), "%.15g", value);
+            std::string actual = formatted(value, 15);
+            if (actual == expected)
+                continue;
+            ++numMismatches;
+            double difference = std::fabs(std::strtod(actual.c_str(), nullptr)
+                                          - std::strtod(expected, nullptr));
+            numOffByMore += difference > 1.01 * std::fabs(value) * 1e-14;
+        }
+        REQUIRE(numOffByMore == 0);
+        REQUIRE(numMismatches < 10);
+    }
+}
+
+SCENARIO("formatted arguments parse back to the same value", "[textformat]")
+{
+    GIVEN("values which differ in the last bit")
+    {
+        REQUIRE(formatted(double(1.0f), 9) != formatted(double(std::nextafter(1.0f, 2.0f)), 9));
+        REQUIRE(formatted(0.1, 17) != formatted(std::nextafter(0.1, 1.0), 17));
+    }
+
+    GIVEN("random values")
+    {
+        std::mt19937_64 generator(4321);
+        std::uniform_real_distribution<double> mantissas(-10.0, 10.0);
+        std::uniform_int_distribution<int> exponents(-1000, 1000);
+        std::uniform_int_distribution<int> floatExponents(-120, 120);
+        int numDoubleMismatches = 0;
+        int numFloatMismatches = 0;
+        for (int count = 0; count < 100000; ++count)
+        {
+            double value = std::ldexp(mantissas(generator), exponents(generator));
+            numDoubleMismatches += std::strtod(formatted(value, 17).c_str(), nullptr) != value;
+
+            float single = std::ldexp(float(mantissas(generator)), floatExponents(generator));
+            numFloatMismatches += std::strtof(formatted(single, 9).c_str(), nullptr) != single;
+        }
+        REQUIRE(numDoubleMismatches == 0);
+        REQUIRE(numFloatMismatches == 0);
+    }
+
+    GIVEN("a diagnostic")
+    {
+        Allocator a;
+        Descriptor<void(float, double)> desc("EXACT", "");
+        Diagnostic* diag = Diagnostic::create(a, desc, std::nextafter(1.0f, 2.0f),
+                                              0.10000000000000002);
+
+        TextFormatter formatter;
+        std::vector<char> buffer(TextFormatter::maxLineSize(*diag));
+        std::string line(buffer.data(), formatter.format(*diag, buffer.data()));
+        REQUIRE(line.substr(line.find(' ')) == " EXACT 1.00000012 0.10000000000000002\n");
+        a.deallocate(diag);
+    }
+}
+
+SCENARIO("diagnostics are formatted as lines", "[textformat]")
+{
+    Allocator a;
+    Descriptor<void(int, double, const char*)> desc("TEXT", "");
+    Diagnostic* diag = Diagnostic::create(a, desc, -3, 0.25,
+                                          static_cast<const char*>("a \"b\"\n"));
+
+    TextFormatter formatter;
+    std::vector<char> buffer(TextFormatter::maxLineSize(*diag));
+    std::string line(buffer.data(), formatter.format(*diag, buffer.data()));
+
+    std::int64_t timeStamp = toNanoseconds(diag->timeStamp());
+    std::time_t seconds = std::time_t(timeStamp / 1000000000);
+    std::tm utc;
+    ::gmtime_r(&seconds, &utc);
+    char expected[64];
+    std::size_t length = std::strftime(expected, sizeof(expected), "%Y-%m-%dT%H:%M:%S", &utc);
+    std::snprintf(expected + length, sizeof(expected) - length, ".%09dZ",
+                  int(timeStamp % 1000000000));
+
+    REQUIRE(line == std::string(expected) + " TEXT -3 0.25 \"a \\\"b\\\"\\x0a\"\n");
+    a.deallocate(diag);
+}
+
+SCENARIO("explanations are formatted", "[textformat]")
+{
+    Allocator a;
+    Descriptor<void(const char*, int, double)> desc(
+            "RANGE", "{0}: value {1} outside [0, {2}]");
+    Diagnostic* diag = Diagnostic::create(a, desc, static_cast<const char*>("pump"), 7, 2.5);
+
+    std::vector<char> buffer(TextFormatter::maxExplanationSize(desc.m_explanation, *diag));
+    std::string text(buffer.data(),
+                     TextFormatter::formatExplanation(desc.m_explanation, *diag, buffer.data()));
+    REQUIRE(text == "pump: value 7 outside [0, 2.5]");
+
+    Descriptor<void(int, int, int)> other("OTHER", "{0} {2}");
+    buffer.resize(TextFormatter::maxExplanationSize(other.m_explanation, *diag));
+    text.assign(buffer.data(),
+                TextFormatter::formatExplanation(other.m_explanation, *diag, buffer.data()));
+    REQUIRE(text == "pump 2.5");
+
+    a.deallocate(diag);
+}
+
+SCENARIO("a text sink appends explanations from a registry", "[textformat]")
+{
+    const char* path = "tst_textformat_registry.log";
+    std::remove(path);
+    static constexpr Descriptor<void(int)> level("LEVEL", "level {0} reached");
+    static constexpr Descriptor<void(int)> quiet("QUIET", "");
+    static constexpr auto registry = makeDescriptorRegistry(level, quiet);
+    DescriptorRegistryView view = registry.view();
+
+    {
+        TextSinkOptions options;
+        options.registry = &view;
+        TextSink sink(path, options);
+        Engine engine;
+        engine.subscribe("*", &sink);
+        engine.publish(level, 3);
+        engine.publish(quiet, 4);
+    }
+
+    std::ifstream file(path);
+    std::string line;
+    REQUIRE(std::getline(file, line));
+    REQUIRE(line.substr(30) == " LEVEL 3 -- level 3 reached");
+    REQUIRE(std::getline(file, line));
+    REQUIRE(line.substr(30) == " QUIET 4");
+    REQUIRE(!std::getline(file, line));
+    std::remove(path);
+}
+
+SCENARIO("a text sink writes the lines of all threads", "[textformat]")
+{
+    const char* path = "tst_textformat.log";
+    std::remove(path);
+    Descriptor<void(int, int)> desc("TEXT", "");
+
+    const int numThreads = 4;
+    const int numDiagnostics = 10000;
+    {
+        TextSinkOptions options;
+        options.bufferSize = 1024;
+        TextSink sink(path, options);
+        Engine engine;
+        engine.subscribe("*", &sink);
+
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < numThreads; ++thread)
+        {
+            threads.emplace_back([&, thread] {
+                for (int count = 0; count < numDiagnostics; ++count)
+                    engine.publish(desc, int(thread), int(count));
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    std::vector<int> expected(numThreads, 0);
+    int numLines = 0;
+    int numMismatches = 0;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        ++numLines;
+        std::size_t code = line.find(" TEXT ");
+        if (code != 30)
+        {
+            ++numMismatches;
+            continue;
+        }
+        int thread, count;
+        if (std::sscanf(line.c_str() + code, " TEXT %d %d", &thread, &count) != 2
+            || thread < 0 || thread >= numThreads || count != expected[thread])
+        {
+            ++numMismatches;
+            continue;
+        }
+        ++expected[thread];
+    }
+
+    REQUIRE(numMismatches == 0);
+    REQUIRE(numLines == numThreads * numDiagnostics);
+    std::remove(path);
+}
@@ -0,0 +1,175 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "catch.hpp"
+
+#include "../src/diagnostic.hpp"
+#include "../src/wireformat.hpp"
+
+#include <cstring>
+#include <vector>
+
+using namespace dime;
+
+
+SCENARIO("diagnostics are encoded into records", "[wireformat]")
+{
+    Allocator a;
+    Descriptor<void(int, unsigned, float, double, long double, const char*)>
+            desc("WIRE_42", "");
+    Diagnostic* diag = Diagnostic::create(a, desc, -7, 8u, 1.5f, -2.25, 3.5L,
+                                          static_cast<const char*>("text"));
+    std::int64_t reference = toNanoseconds(diag->timeStamp()) - 1000;
+
+    std::vector<unsigned char> buffer(encodedSize(*diag, reference));
+    REQUIRE(encode(*diag, reference, buffer.data(), buffer.size() - 1) == 0);
+    REQUIRE(encode(*diag, reference, buffer.data(), buffer.size()) == buffer.size());
+
+    GIVEN("a reader")
+    {
+        RecordReader reader(buffer.data(), buffer.size());
+        RecordView view;
+        REQUIRE(reader.next(view));
+
+        THEN("the record has the contents of the diagnostic")
+        {
+            REQUIRE(view.code()[0] == diag->code()[0]);
+            REQUIRE(view.code()[1] == diag->code()[1]);
+            REQUIRE(view.relativeTimeStamp() == 1000);
+            REQUIRE(view.timeStamp(reference) == toNanoseconds(diag->timeStamp()));
+            REQUIRE(view.uniqueId() == diag->uniqueId());
+            REQUIRE(view.droppable());
+            REQUIRE(view.numArguments() == 6);
+            REQUIRE(view.argument(0).toInteger().value() == -7);
+            REQUIRE(view.argument(1).toUnsigned().value() == 8u);
+            REQUIRE(view.argument(2).toFloat().value() == 1.5f);
+            REQUIRE(view.argument(3).toDouble().value() == -2.25);
+            REQUIRE(view.argument(4).toLongDouble().value() == 3.5L);
+            REQUIRE(!view.argument(4).toDouble());
+            REQUIRE(view.argument(5).stringSize() == 4);
+            REQUIRE(std::memcmp(view.argument(5).stringData(), "text", 4) == 0);
+        }
+
+        THEN("the reader is at the end")
+        {
+            REQUIRE(!reader.next(view));
+            REQUIRE(reader.status() == RecordReader::Status::Ok);
+            REQUIRE(reader.offset() == buffer.size());
+        }
+    }
+
+    WHEN("the record is truncated")
+    {
+        RecordReader reader(buffer.data(), buffer.size() - 1);
+        RecordView view;
+        REQUIRE(!reader.next(view));
+        REQUIRE(reader.status() == RecordReader::Status::Truncated);
+    }
+
+    WHEN("the record is corrupted")
+    {
+        buffer[10] ^= 0x01;
+        RecordReader reader(buffer.data(), buffer.size());
+        RecordView view;
+        REQUIRE(!reader.next(view));
+        REQUIRE(reader.status() == RecordReader::Status::Corrupt);
+        REQUIRE(reader.offset() == 0);
+    }
+
+    a.deallocate(diag);
+}
+
+SCENARIO("short codes are encoded with a single word", "[wireformat]")
+{
+    Allocator a;
+    Descriptor<void(int)> shortDesc("NET_TX", "");
+    Descriptor<void(int)> longDesc("NET_TX_QUEUE_FULL", "");
+    Diagnostic* shortDiag = Diagnostic::create(a, shortDesc, 1);
+    Diagnostic* longDiag = Diagnostic::create(a, longDesc, 2);
+    std::int64_t reference = toNanoseconds(shortDiag->timeStamp());
+
+    REQUIRE(shortDesc.hasShortCode());
+    REQUIRE(!longDesc.hasShortCode());
+    REQUIRE(encodedSize(*shortDiag, toNanoseconds(shortDiag->timeStamp())) + 8
+            == encodedSize(*longDiag, toNanoseconds(longDiag->timeStamp())));
+
+    std::vector<unsigned char> buffer(encodedSize(*shortDiag, reference)
+                                      + encodedSize(*longDiag, reference));
+    std::size_t shortSize = encode(*shortDiag, reference, buffer.data(), buffer.size());
+    REQUIRE(shortSize != 0);
+    REQUIRE(encode(*longDiag, reference, buffer.data() + shortSize,
+                   buffer.size() - shortSize) == buffer.size() - shortSize);
+
+    GIVEN("a reader")
+    {
+        RecordReader reader(buffer.data(), buffer.size());
+        RecordView view;
+
+        THEN("both codes are restored")
+        {
+            REQUIRE(reader.next(view));
+            REQUIRE((view.flags() & RecordShortCode) != 0);
+            REQUIRE(view.code() == shortDiag->code());
+            REQUIRE(view.argument(0).toInteger().value() == 1);
+
+            REQUIRE(reader.next(view));
+            REQUIRE((view.flags() & RecordShortCode) == 0);
+            REQUIRE(view.code() == longDiag->code());
+            REQUIRE(view.argument(0).toInteger().value() == 2);
+
+            REQUIRE(!reader.next(view));
+            REQUIRE(reader.status() == RecordReader::Status::Ok);
+        }
+    }
+
+    WHEN("a short code is stored with both words")
+    {
+        // Rewrite the long record with the code of the short one, as it was
+        // encoded before the short form existed.
+        unsigned char* begin = buffer.data() + shortSize;
+        unsigned char* body = begin + recordPrefixSize;
+        std::size_t bodySize = buffer.size() - shortSize - recordPrefixSize - recordSuffixSize;
+        dime_detail::writeLittleEndian(body + 1, shortDiag->code()[0], 8);
+        dime_detail::writeLittleEndian(body + 9, 0, 8);
+        dime_detail::writeLittleEndian(body + bodySize, crc32(body, bodySize), 4);
+
+        RecordReader reader(begin, buffer.size() - shortSize);
+        RecordView view;
+        REQUIRE(reader.next(view));
+        REQUIRE(view.code() == shortDiag->code());
+        REQUIRE(view.argument(0).toInteger().value() == 2);
+    }
+
+    a.deallocate(shortDiag);
+    a.deallocate(longDiag);
+}
+
+SCENARIO("the CRC-32 matches the IEEE polynomial", "[wireformat]")
+{
+    REQUIRE(crc32("123456789", 9) == 0xCBF43926u);
+}
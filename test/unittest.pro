@@ -34,22 +34,74 @@ CONFIG += DEBUG
 
 QMAKE_CXXFLAGS += -std=c++14 -Wall -Wextra
 QMAKE_LFLAGS += -pthread -Wl,--no-as-needed
+LIBS += -lrt
 
 INCLUDEPATH += ../src/
 
 SOURCES += \
+    ../src/activediagnostics.cpp \
+    ../src/arena.cpp \
+    ../src/catalog.cpp \
+    ../src/code.cpp \
+    ../src/codeinterner.cpp \
+    ../src/diagnosticpool.cpp \
     ../src/engine.cpp \
+    ../src/filesink.cpp \
+    ../src/flightrecorder.cpp \
     ../src/patternmatching.cpp \
+    ../src/ringallocator.cpp \
+    ../src/segment.cpp \
+    ../src/segmentindex.cpp \
+    ../src/shmtransport.cpp \
+    ../src/socketsink.cpp \
     ../src/subscriber.cpp \
+    ../src/textformat.cpp \
+    ../src/wireformat.cpp \
     main.cpp \
+    tst_activediagnostics.cpp \
+    tst_arena.cpp \
+    tst_catalog.cpp \
     tst_code.cpp \
-    tst_diagnostic.cpp
+    tst_codeinterner.cpp \
+    tst_diagnostic.cpp \
+    tst_diagnosticlist.cpp \
+    tst_diagnosticpool.cpp \
+    tst_engine.cpp \
+    tst_explanation.cpp \
+    tst_filesink.cpp \
+    tst_flightrecorder.cpp \
+    tst_patternmatching.cpp \
+    tst_registry.cpp \
+    tst_ringallocator.cpp \
+    tst_segment.cpp \
+    tst_segmentindex.cpp \
+    tst_shmtransport.cpp \
+    tst_socketsink.cpp \
+    tst_textformat.cpp \
+    tst_wireformat.cpp
 
 HEADERS += \
+    ../src/activediagnostics.hpp \
     ../src/allocator.hpp \
+    ../src/arena.hpp \
+    ../src/catalog.hpp \
     ../src/code.hpp \
+    ../src/codeinterner.hpp \
     ../src/diagnostic.hpp \
+    ../src/diagnosticlist.hpp \
+    ../src/diagnosticpool.hpp \
+    ../src/explanation.hpp \
+    ../src/filesink.hpp \
+    ../src/flightrecorder.hpp \
     ../src/patternmatching.hpp \
+    ../src/registry.hpp \
+    ../src/ringallocator.hpp \
+    ../src/segment.hpp \
+    ../src/segmentindex.hpp \
+    ../src/shmtransport.hpp \
+    ../src/socketsink.hpp \
     ../src/subscriber.hpp \
+    ../src/textformat.hpp \
+    ../src/wireformat.hpp \
 
 HEADERS += catch.hpp
@@ -0,0 +1,64 @@
+################################################################################
+#  Diagnostic messaging
+#
+#  Copyright (c) 2016, Manuel Freiberger
+#  All rights reserved.
+#
+#  Redistribution and use in source and binary forms, with or without
+#  modification, are permitted provided that the following conditions are met:
+#
+#  - Redistributions of source code must retain the above copyright notice, this
+#    list of conditions and the following disclaimer.
+#  - Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+#  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+#  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+#  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+#  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+#  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+#  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+#  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+#  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+#  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+#  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+#  POSSIBILITY OF SUCH DAMAGE.
+################################################################################
+
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+CONFIG += release
+
+TARGET = dimedump
+
+QMAKE_CXXFLAGS += -std=c++14 -Wall -Wextra
+QMAKE_CXXFLAGS_RELEASE += -O2
+# Codes are converted from and to text with SSSE3 instructions (see config.hpp).
+contains(QMAKE_HOST.arch, x86_64): QMAKE_CXXFLAGS += -mssse3
+QMAKE_LFLAGS += -pthread -Wl,--no-as-needed
+
+INCLUDEPATH += ../../src/
+
+SOURCES += \
+    ../../src/catalog.cpp \
+    ../../src/code.cpp \
+    ../../src/flightrecorder.cpp \
+    ../../src/patternmatching.cpp \
+    ../../src/segment.cpp \
+    ../../src/segmentindex.cpp \
+    ../../src/subscriber.cpp \
+    ../../src/wireformat.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../src/argument.hpp \
+    ../../src/catalog.hpp \
+    ../../src/code.hpp \
+    ../../src/flightrecorder.hpp \
+    ../../src/patternmatching.hpp \
+    ../../src/segment.hpp \
+    ../../src/segmentindex.hpp \
+    ../../src/wireformat.hpp
@@ -0,0 +1,626 @@
+/*******************************************************************************
+  Diagnostic messaging
+
+  Copyright (c) 2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+// dimedump - decodes and queries binary diagnostic logs
+//
+// Usage: dimedump [options] file...
+//
+// The files may be segments which have been written by a FileSink or
+// flight recorder files. The blocks of a segment are decoded in parallel.
+// If a segment has an index, only the blocks which may hold matching
+// records are read. With a catalog, which has been extracted from the
+// binary that wrote the log, every diagnostic is explained in plain text.
+
+#include "catalog.hpp"
+#include "flightrecorder.hpp"
+#include "patternmatching.hpp"
+#include "segment.hpp"
+#include "segmentindex.hpp"
+#include "wireformat.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace dime;
+
+namespace
+{
+
+//! The number of blocks which every thread decodes per round.
+constexpr std::size_t blocksPerThread = 16;
+
+struct Query
+{
+    std::unique_ptr<dime_detail::PatternMatcher> matcher;
+    std::int64_t from = std::numeric_limits<std::int64_t>::min();
+    std::int64_t to = std::numeric_limits<std::int64_t>::max();
+    //! The literal prefix of the pattern, which is used to skip blocks
+    //! with the help of an index.
+    Code prefix = Code{0, 0};
+    unsigned prefixLength = 0;
+    bool json = false;
+    //! The catalog to explain the diagnostics or a null-pointer.
+    const Catalog* catalog = nullptr;
+
+    bool matches(const RecordView& view, std::int64_t timeStamp) const
+    {
+        return timeStamp >= from && timeStamp < to
+               && (!matcher || matcher->matches(view.code()));
+    }
+};
+
+//! A read-only mapping of a whole file.
+class MappedFile
+{
+public:
+    explicit
+    MappedFile(const char* path)
+        : m_data(MAP_FAILED),
+          m_size(0)
+    {
+        int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+        struct stat status;
+        if (::fstat(fd, &status) == 0 && status.st_size > 0)
+        {
+            m_size = std::size_t(status.st_size);
+            m_data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m_data != MAP_FAILED)
+                ::madvise(m_data, m_size, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (m_data != MAP_FAILED)
+            ::munmap(m_data, m_size);
+    }
+
+    bool valid() const
+    {
+        return m_data != MAP_FAILED;
+    }
+
+    const unsigned char* data() const
+    {
+        return static_cast<const unsigned char*>(m_data);
+    }
+
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    void* m_data;
+    std::size_t m_size;
+};
+
+void appendCode(std::string& out, const Code& code)
+{
+    // Trailing padding symbols are not part of the code.
+    char text[20];
+    out.append(text, code.toChars(text));
+}
+
+void appendTimeStamp(std::string& out, std::int64_t timeStamp)
+{
+    std::int64_t seconds = timeStamp / 1000000000;
+    std::int64_t nanoseconds = timeStamp % 1000000000;
+    if (nanoseconds < 0)
+    {
+        nanoseconds += 1000000000;
+        --seconds;
+    }
+
+    std::time_t time = std::time_t(seconds);
+    std::tm utc;
+    ::gmtime_r(&time, &utc);
+    char buffer[64];
+    std::size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+    std::snprintf(buffer + length, sizeof(buffer) - length, ".%09" PRId64 "Z", nanoseconds);
+    out += buffer;
+}
+
+void appendString(std::string& out, const char* data, std::size_t size, bool json)
+{
+    out += '"';
+    for (std::size_t idx = 0; idx < size; ++idx)
+    {
+        unsigned char c = static_cast<unsigned char>(data[idx]);
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += char(c);
+        }
+        else if (c < 0x20)
+        {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), json ? "\\u%04x" : "\\x%02x", c);
+            out += buffer;
+        }
+        else
+        {
+            out += char(c);
+        }
+    }
+    out += '"';
+}
+
+void appendArgument(std::string& out, const ArgumentView& argument, bool json)
+{
+    char buffer[64];
+    // JSON has no literals for NaN and infinity, so they are quoted.
+    bool finite = true;
+    switch (argument.kind())
+    {
+    case ArgumentKind::SignedInteger:
+        std::snprintf(buffer, sizeof(buffer), "%d", argument.toInteger().value());
+        break;
+    case ArgumentKind::UnsignedInteger:
+        std::snprintf(buffer, sizeof(buffer), "%u", argument.toUnsigned().value());
+        break;
+    case ArgumentKind::Float:
+    {
+        float value = argument.toFloat().value();
+        finite = std::isfinite(value);
+        std::snprintf(buffer, sizeof(buffer), "%.9g", double(value));
+        break;
+    }
+    case ArgumentKind::Double:
+    {
+        double value = argument.toDouble().value();
+        finite = std::isfinite(value);
+        std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+        break;
+    }
+    case ArgumentKind::LongDouble:
+    {
+        auto value = argument.toLongDouble();
+        if (value)
+        {
+            finite = std::isfinite(value.value());
+            std::snprintf(buffer, sizeof(buffer), "%.21Lg", value.value());
+        }
+        else
+        {
+            std::snprintf(buffer, sizeof(buffer), json ? "null" : "?");
+        }
+        break;
+    }
+    case ArgumentKind::String:
+        appendString(out, argument.stringData(), argument.stringSize(), json);
+        return;
+    }
+
+    if (json && !finite)
+        appendString(out, buffer, std::strlen(buffer), json);
+    else
+        out += buffer;
+}
+
+//! Writes the explanation of a record, if the catalog has an entry whose
+//! arguments match the record. Returns false otherwise.
+bool appendExplanation(std::string& out, const RecordView& view, const Catalog& catalog)
+{
+    const CatalogEntry* entry = catalog.find(view.code());
+    if (!entry || entry->kinds.size() != view.numArguments())
+        return false;
+    for (unsigned idx = 0; idx < view.numArguments(); ++idx)
+        if (entry->kinds[idx] != view.argument(idx).kind())
+            return false;
+
+    for (std::size_t idx = 0; idx < entry->explanation.numSegments(); ++idx)
+    {
+        const ExplanationSegment& segment = entry->explanation.segment(idx);
+        if (segment.argument < 0)
+        {
+            out.append(segment.text, segment.length);
+            continue;
+        }
+        ArgumentView argument = view.argument(unsigned(segment.argument));
+        if (argument.kind() == ArgumentKind::String)
+            out.append(argument.stringData(), argument.stringSize());
+        else
+            appendArgument(out, argument, false);
+    }
+    return true;
+}
+
+void appendRecord(std::string& out, const RecordView& view, std::int64_t timeStamp,
+                  const Query& query)
+{
+    std::string explanation;
+    bool explained = query.catalog && appendExplanation(explanation, view, *query.catalog);
+
+    if (query.json)
+    {
+        out += "{\"time\":";
+        out += std::to_string(timeStamp);
+        out += ",\"code\":\"";
+        appendCode(out, view.code());
+        out += "\",\"uniqueId\":";
+        out += std::to_string(view.uniqueId());
+        out += ",\"droppable\":";
+        out += view.droppable() ? "true" : "false";
+        if (view.numRepeats() != 0)
+        {
+            out += ",\"repeats\":";
+            out += std::to_string(view.numRepeats());
+        }
+        if (view.samplingWeight() != 1)
+        {
+            out += ",\"weight\":";
+            out += std::to_string(view.samplingWeight());
+        }
+        out += ",\"arguments\":[";
+        for (unsigned idx = 0; idx < view.numArguments(); ++idx)
+        {
+            if (idx)
+                out += ',';
+            appendArgument(out, view.argument(idx), true);
+        }
+        out += ']';
+        if (explained)
+        {
+            out += ",\"explanation\":";
+            appendString(out, explanation.data(), explanation.size(), true);
+        }
+        out += "}\n";
+    }
+    else
+    {
+        appendTimeStamp(out, timeStamp);
+        out += ' ';
+        appendCode(out, view.code());
+        for (unsigned idx = 0; idx < view.numArguments(); ++idx)
+        {
+            out += ' ';
+            appendArgument(out, view.argument(idx), false);
+        }
+        if (view.numRepeats() != 0)
+        {
+            out += " (repeated ";
+            out += std::to_string(view.numRepeats());
+            out += " times)";
+        }
+        if (view.samplingWeight() != 1)
+        {
+            out += " (weight ";
+            out += std::to_string(view.samplingWeight());
+            out += ')';
+        }
+        if (explained)
+        {
+            out += " -- ";
+            out += explanation;
+        }
+        out += '\n';
+    }
+}
+
+struct Block
+{
+    BlockHeader header;
+    const unsigned char* payload;
+};
+
+//! Decodes the matching records of a \p block into \p out.
+void decodeBlock(const Block& block, const Query& query, std::string& out)
+{
+    BlockRecordReader reader(block.header, block.payload);
+    RecordView view;
+    std::int64_t timeStamp;
+    while (reader.next(view, timeStamp))
+        if (query.matches(view, timeStamp))
+            appendRecord(out, view, timeStamp, query);
+    if (reader.status() != RecordReader::Status::Ok)
+        std::fprintf(stderr, "corrupt record in block at time %" PRId64 "\n",
+                     block.header.baseTimeStamp);
+}
+
+bool dumpSegment(const char* path, const MappedFile& file, const Query& query,
+                 unsigned numThreads)
+{
+    std::vector<Block> blocks;
+    bool valid = true;
+    std::size_t cursor = 0;
+
+    // Collects the blocks from the cursor up to the given offset. This only
+    // touches the block headers.
+    auto scan = [&](std::size_t end) {
+        SegmentReader segment(file.data() + cursor, end - cursor);
+        Block block;
+        while (segment.next(block.header, block.payload))
+            blocks.push_back(block);
+        if (segment.status() != SegmentReader::Status::Ok)
+        {
+            std::fprintf(stderr, "%s: invalid block at offset %zu\n",
+                         path, cursor + segment.offset());
+            valid = false;
+        }
+        cursor = end;
+    };
+
+    // Blocks with an index entry are only read if they may hold matching
+    // records. The gaps between the indexed blocks are scanned.
+    MappedFile index(indexPath(path).c_str());
+    if (index.valid())
+    {
+        IndexReader reader(index.data(), index.size());
+        IndexEntry entry;
+        while (reader.next(entry))
+        {
+            if (entry.offset < cursor || entry.size < blockHeaderSize
+                || entry.offset + entry.size > file.size())
+            {
+                continue;
+            }
+            if (entry.offset > cursor)
+                scan(entry.offset);
+            cursor = entry.offset + entry.size;
+            if (!entry.mayMatch(query.from, query.to, query.prefix, query.prefixLength))
+                continue;
+
+            Block block;
+            if (!block.header.read(file.data() + entry.offset)
+                || blockHeaderSize + block.header.payloadSize != entry.size)
+            {
+                std::fprintf(stderr, "%s: invalid block at offset %zu\n",
+                             path, std::size_t(entry.offset));
+                valid = false;
+                continue;
+            }
+            block.payload = file.data() + entry.offset + blockHeaderSize;
+            blocks.push_back(block);
+        }
+    }
+    scan(file.size());
+
+    // Decode the blocks in rounds. Within a round, every thread decodes
+    // every n-th block into its own buffer. The buffers are printed in the
+    // order of the blocks.
+    std::size_t roundSize = numThreads * blocksPerThread;
+    std::vector<std::string> outputs(roundSize);
+    for (std::size_t first = 0; first < blocks.size(); first += roundSize)
+    {
+        std::size_t last = std::min(first + roundSize, blocks.size());
+        std::vector<std::thread> threads;
+        for (unsigned thread = 0; thread < numThreads; ++thread)
+        {
+            threads.emplace_back([&, thread] {
+                for (std::size_t idx = first + thread; idx < last; idx += numThreads)
+                {
+                    outputs[idx - first].clear();
+                    decodeBlock(blocks[idx], query, outputs[idx - first]);
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        for (std::size_t idx = first; idx < last; ++idx)
+            std::fwrite(outputs[idx - first].data(), 1, outputs[idx - first].size(), stdout);
+    }
+    return valid;
+}
+
+bool dumpFlightRecorder(const char* path, const Query& query)
+{
+    try
+    {
+        FlightRecorderReader reader(path);
+        RecordView view;
+        std::int64_t timeStamp;
+        std::string out;
+        while (reader.next(view, timeStamp))
+        {
+            if (query.matches(view, timeStamp))
+                appendRecord(out, view, timeStamp, query);
+            if (out.size() > 65536)
+            {
+                std::fwrite(out.data(), 1, out.size(), stdout);
+                out.clear();
+            }
+        }
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        return true;
+    }
+    catch (std::exception& e)
+    {
+        std::fprintf(stderr, "%s: %s\n", path, e.what());
+        return false;
+    }
+}
+
+//! Parses a time given in nanoseconds since the epoch or as an ISO 8601
+//! date and time in UTC (e.g. 2016-03-01T10:00:00.5).
+bool parseTime(const char* text, std::int64_t& timeStamp)
+{
+    char* end;
+    errno = 0;
+    long long value = std::strtoll(text, &end, 10);
+    if (*end == 0 && errno == 0)
+    {
+        timeStamp = value;
+        return true;
+    }
+
+    std::tm utc = std::tm();
+    int consumed = 0;
+    if (std::sscanf(text, "%d-%d-%dT%d:%d:%d%n", &utc.tm_year, &utc.tm_mon,
+                    &utc.tm_mday, &utc.tm_hour, &utc.tm_min, &utc.tm_sec,
+                    &consumed) != 6)
+    {
+        return false;
+    }
+    utc.tm_year -= 1900;
+    utc.tm_mon -= 1;
+    std::int64_t nanoseconds = 0;
+    const char* fraction = text + consumed;
+    if (*fraction == '.')
+    {
+        std::int64_t scale = 100000000;
+        for (++fraction; *fraction >= '0' && *fraction <= '9'; ++fraction, scale /= 10)
+            nanoseconds += (*fraction - '0') * scale;
+    }
+    if (*fraction == 'Z')
+        ++fraction;
+    if (*fraction != 0)
+        return false;
+
+    timeStamp = std::int64_t(::timegm(&utc)) * 1000000000 + nanoseconds;
+    return true;
+}
+
+void printUsage()
+{
+    std::fprintf(stderr,
+                 "Usage: dimedump [options] file...\n"
+                 "\n"
+                 "Options:\n"
+                 "  -p, --pattern PATTERN  only show diagnostics whose code matches\n"
+                 "  -f, --from TIME        only show diagnostics at or after TIME\n"
+                 "  -t, --to TIME          only show diagnostics before TIME\n"
+                 "  -j, --json             print one JSON object per diagnostic\n"
+                 "  -c, --catalog FILE     explain the diagnostics with the catalog in FILE\n"
+                 "  -n, --threads N        decode with N threads\n"
+                 "\n"
+                 "TIME is given in nanoseconds since the epoch or as\n"
+                 "YYYY-MM-DDTHH:MM:SS[.fraction] in UTC. A catalog is extracted from a\n"
+                 "binary with: objcopy -O binary --only-section=dime_catalog BINARY FILE\n");
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    Query query;
+    Catalog catalog;
+    unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<const char*> paths;
+
+    for (int idx = 1; idx < argc; ++idx)
+    {
+        std::string arg = argv[idx];
+        bool hasValue = idx + 1 < argc;
+        if ((arg == "-p" || arg == "--pattern") && hasValue)
+        {
+            query.matcher = dime_detail::compilePattern(argv[++idx]);
+            query.prefixLength = literalPrefix(argv[idx], query.prefix);
+        }
+        else if ((arg == "-f" || arg == "--from") && hasValue)
+        {
+            if (!parseTime(argv[++idx], query.from))
+            {
+                std::fprintf(stderr, "Invalid time: %s\n", argv[idx]);
+                return 2;
+            }
+        }
+        else if ((arg == "-t" || arg == "--to") && hasValue)
+        {
+            if (!parseTime(argv[++idx], query.to))
+            {
+                std::fprintf(stderr, "Invalid time: %s\n", argv[idx]);
+                return 2;
+            }
+        }
+        else if (arg == "-j" || arg == "--json")
+        {
+            query.json = true;
+        }
+        else if ((arg == "-c" || arg == "--catalog") && hasValue)
+        {
+            if (!catalog.loadFile(argv[++idx]))
+            {
+                std::fprintf(stderr, "Invalid catalog: %s\n", argv[idx]);
+                return 2;
+            }
+            query.catalog = &catalog;
+        }
+        else if ((arg == "-n" || arg == "--threads") && hasValue)
+        {
+            numThreads = std::max(1, std::atoi(argv[++idx]));
+        }
+        else if (arg == "-h" || arg == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            printUsage();
+            return 2;
+        }
+        else
+        {
+            paths.push_back(argv[idx]);
+        }
+    }
+
+    if (paths.empty())
+    {
+        printUsage();
+        return 2;
+    }
+
+    bool success = true;
+    for (const char* path : paths)
+    {
+        MappedFile file(path);
+        if (!file.valid())
+        {
+            std::fprintf(stderr, "%s: cannot map file\n", path);
+            success = false;
+            continue;
+        }
+
+        if (file.size() >= 4 && dime_detail::readLittleEndian(file.data(), 4) == blockMagic)
+            success &= dumpSegment(path, file, query, numThreads);
+        else
+            success &= dumpFlightRecorder(path, query);
+    }
+    return success ? 0 : 1;
+}